@@ -9,6 +9,8 @@
 #include <linux/slab.h>
 #include <linux/highmem.h>
 #include <linux/bio.h>
+#include <linux/cache.h>
+#include <linux/sched/clock.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/zram.h>
@@ -106,31 +108,90 @@ static void zcomp_fill_page(void *ptr, unsigned long len,
 					unsigned long value)
 {
 	WARN_ON_ONCE(!IS_ALIGNED(len, sizeof(unsigned long)));
+	/* clear_page is much faster than memset_l(e.g., DC ZVA on arm64) */
+	if (!value && len == PAGE_SIZE) {
+		clear_page(ptr);
+		return;
+	}
 	memset_l(ptr, value, len / sizeof(unsigned long));
 }
 
-static bool zcomp_page_same_pattern(struct page *page, unsigned long *element)
+#define ZCOMP_PAGE_WORDS	(PAGE_SIZE / sizeof(unsigned long))
+#define ZCOMP_LINE_WORDS	(L1_CACHE_BYTES / sizeof(unsigned long))
+
+/*
+ * Compare @nr words against @val, four at a time with no branch inside
+ * a group. @nr must be a multiple of four.
+ */
+static inline bool zcomp_words_same(const unsigned long *mem,
+				    unsigned long val, unsigned int nr)
 {
 	unsigned int pos;
+
+	for (pos = 0; pos < nr; pos += 4) {
+		if ((mem[pos] ^ val) | (mem[pos + 1] ^ val) |
+		    (mem[pos + 2] ^ val) | (mem[pos + 3] ^ val))
+			return false;
+	}
+
+	return true;
+}
+
+static bool zcomp_page_same_pattern(struct page *page, unsigned long *element)
+{
 	unsigned long *mem;
 	unsigned long val;
-	bool ret = true;
+	bool ret = false;
 
 	mem = kmap_atomic(page);
 	val = mem[0];
-	for (pos = 1; pos < PAGE_SIZE / sizeof(*mem); pos++) {
-		if (val != mem[pos]) {
-			ret = false;
-			goto out;
-		}
-	}
+	/*
+	 * Most pages are not same-filled and differ already within their
+	 * first or last cache line, so check both ends before the rest.
+	 */
+	if (!zcomp_words_same(mem, val, ZCOMP_LINE_WORDS) ||
+	    !zcomp_words_same(mem + ZCOMP_PAGE_WORDS - ZCOMP_LINE_WORDS,
+			      val, ZCOMP_LINE_WORDS))
+		goto out;
+
+	if (!zcomp_words_same(mem + ZCOMP_LINE_WORDS, val,
+			      ZCOMP_PAGE_WORDS - 2 * ZCOMP_LINE_WORDS))
+		goto out;
 
 	*element = val;
+	ret = true;
 out:
 	kunmap_atomic(mem);
 	return ret;
 }
 
+/* only one check in this many is timed, the others count as its cost */
+#define ZCOMP_SAME_SAMPLE_SHIFT	6
+
+/* zcomp_page_same_pattern with accounting of its cost and hit rate */
+static bool zcomp_same_page_check(struct zcomp *comp, struct page *page,
+				  unsigned long *element)
+{
+	struct zram *zram = comp->zram;
+	long nr = this_cpu_inc_return(zram->pcp_stats->items[NR_SAME_CHECK]);
+	bool timed = !(nr & ((1 << ZCOMP_SAME_SAMPLE_SHIFT) - 1));
+	u64 start = 0;
+	bool ret;
+
+	if (timed)
+		start = local_clock();
+
+	ret = zcomp_page_same_pattern(page, element);
+
+	if (timed)
+		this_cpu_add(zram->pcp_stats->items[SAME_CHECK_NS],
+			     (local_clock() - start) << ZCOMP_SAME_SAMPLE_SHIFT);
+	if (ret)
+		this_cpu_inc(zram->pcp_stats->items[NR_SAME_HIT]);
+
+	return ret;
+}
+
 bool zcomp_available_algorithm(const char *algo_name)
 {
 	bool found;
@@ -142,6 +203,20 @@ bool zcomp_available_algorithm(const char *algo_name)
 	return found;
 }
 
+/* true if @algo_name is registered and compresses synchronously */
+bool zcomp_sync_algorithm(const char *algo_name)
+{
+	struct zcomp *zcomp;
+	bool sync;
+
+	down_read(&zcomp_rwsem);
+	zcomp = find_zcomp(algo_name);
+	sync = zcomp && !zcomp->op->compress_async;
+	up_read(&zcomp_rwsem);
+
+	return sync;
+}
+
 /* show available compressors */
 ssize_t zcomp_available_show(const char *comp, char *buf)
 {
@@ -175,6 +250,11 @@ static inline bool zcomp_async(struct zcomp *comp)
 	return comp->op->compress_async ? true : false;
 }
 
+bool zcomp_batch(struct zcomp *comp)
+{
+	return zcomp_async(comp) && comp->op->compress_batch;
+}
+
 /*
  * The caller needs to hold cookie_pool.lock
  */
@@ -267,7 +347,7 @@ int zcomp_compress(struct zcomp *comp, u32 index, struct page *page,
 	int ret;
 	unsigned long element;
 
-	if (zcomp_page_same_pattern(page, &element)) {
+	if (zcomp_same_page_check(comp, page, &element)) {
 		zram_slot_update(comp->zram, index, element, 0);
 		return 0;
 	}
@@ -282,6 +362,7 @@ int zcomp_compress(struct zcomp *comp, u32 index, struct page *page,
 		cookie->index = index;
 		cookie->page = page;
 		cookie->bio = bio;
+		cookie->recomp_len = 0;
 		/*
 		 * Since __zram_make_request has bio_endio, zcomp_async needs
 		 * to hold the bio completion until the IO request is done if
@@ -310,6 +391,7 @@ int zcomp_compress(struct zcomp *comp, u32 index, struct page *page,
 		cookie.index = index;
 		cookie.page = page;
 		cookie.bio = bio;
+		cookie.recomp_len = 0;
 
 		ret = comp->op->compress(comp, page, &cookie);
 	}
@@ -317,6 +399,108 @@ int zcomp_compress(struct zcomp *comp, u32 index, struct page *page,
 	return ret;
 }
 
+/*
+ * Compress @nr pages backing consecutive zram slots starting at @index.
+ * Same-filled pages are stored directly; the rest are handed to the
+ * backend in one compress_batch call. Falls back to per-page submission
+ * if the backend has no batch support.
+ *
+ * Returns the number of pages from the start of @pages that were stored
+ * or submitted, which is less than @nr if the cookies ran out midway, or
+ * errno if none was. Pages already submitted are never reported as
+ * failed, since their completion is still in flight.
+ */
+int zcomp_compress_batch(struct zcomp *comp, u32 index, struct page **pages,
+			unsigned int nr, struct bio *bio)
+{
+	struct page *batch_pages[ZCOMP_BATCH_PAGES];
+	struct zcomp_cookie *cookies[ZCOMP_BATCH_PAGES];
+	unsigned long element;
+	unsigned int i, j, count = 0;
+	int err;
+
+	if (!zcomp_batch(comp) || nr > ZCOMP_BATCH_PAGES) {
+		for (i = 0; i < nr; i++) {
+			err = zcomp_compress(comp, index + i, pages[i], bio);
+			if (err < 0)
+				return i ? i : err;
+		}
+		return nr;
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct zcomp_cookie *cookie;
+
+		if (zcomp_same_page_check(comp, pages[i], &element)) {
+			zram_slot_update(comp->zram, index + i, element, 0);
+			continue;
+		}
+
+		cookie = alloc_zcomp_cookie(comp);
+		if (!cookie)
+			break;
+
+		cookie->zram = comp->zram;
+		cookie->index = index + i;
+		cookie->page = pages[i];
+		cookie->bio = bio;
+		cookie->recomp_len = 0;
+		/* See the comment in zcomp_compress */
+		if (bio)
+			bio_inc_remaining(bio);
+
+		batch_pages[count] = pages[i];
+		cookies[count++] = cookie;
+	}
+
+	/* i is the first page which did not get a cookie, if any */
+	if (!count)
+		return i ? i : -ENOMEM;
+
+	err = comp->op->compress_batch(comp, batch_pages, cookies, count);
+	if (err) {
+		for (j = 0; j < count; j++) {
+			free_zcomp_cookie(comp, cookies[j]);
+			if (bio)
+				bio_io_error(bio);
+		}
+		return err;
+	}
+
+	return i;
+}
+
+/*
+ * Compress @page of the stored slot @index again with @comp. The result
+ * replaces the stored object only if it is smaller than @old_len.
+ * Only synchronous backends are supported.
+ *
+ * Returns 0 if the slot was updated, -ENOSPC if the result was not
+ * smaller, or other errno.
+ */
+int zcomp_recompress(struct zcomp *comp, u32 index, struct page *page,
+			unsigned int old_len)
+{
+	struct zcomp_cookie cookie;
+
+	if (zcomp_async(comp))
+		return -EINVAL;
+
+	cookie.zram = comp->zram;
+	cookie.index = index;
+	cookie.page = page;
+	cookie.bio = NULL;
+	cookie.recomp_len = old_len;
+
+	return comp->op->compress(comp, page, &cookie);
+}
+
+/*
+ * Called with the slot lock of @index held, which is released before the
+ * return. An async backend decompresses from a private copy of the object
+ * after the lock and the zsmalloc mapping are dropped, so it may sleep
+ * while its H/W works instead of spinning with preemption disabled.
+ */
 int zcomp_decompress(struct zcomp *comp, u32 index, struct page *page)
 {
 	int ret = 0;
@@ -324,6 +508,7 @@ int zcomp_decompress(struct zcomp *comp, u32 index, struct page *page)
 	unsigned int src_len;
 	unsigned long handle;
 	struct zram *zram = comp->zram;
+	struct page *copy = NULL;
 
 	handle = zram_get_handle(zram, index);
 	if (!handle || zram_test_flag(zram, index, ZRAM_SAME)) {
@@ -345,15 +530,41 @@ int zcomp_decompress(struct zcomp *comp, u32 index, struct page *page)
 		goto out;
 	}
 
+	/* fall back to decompressing in place if no copy can be had */
+	if (comp->op->compress_async)
+		copy = alloc_page(GFP_NOWAIT | __GFP_NOWARN);
+
 	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
+	if (copy) {
+		memcpy(page_address(copy), src, src_len);
+		zs_unmap_object(zram->mem_pool, handle);
+		zram_slot_unlock(zram, index);
+
+		trace_zcomp_decompress_start(page, index);
+		ret = comp->op->decompress(comp, page_address(copy), src_len,
+					   page, true);
+		trace_zcomp_decompress_end(page, index);
+		__free_page(copy);
+		return ret;
+	}
+
 	trace_zcomp_decompress_start(page, index);
-	ret = comp->op->decompress(comp, src, src_len, page);
+	ret = comp->op->decompress(comp, src, src_len, page, false);
 	trace_zcomp_decompress_end(page, index);
 	zs_unmap_object(zram->mem_pool, handle);
 out:
+	zram_slot_unlock(zram, index);
 	return ret;
 }
 
+/* decompress an object which is not stored in zram's memory pool */
+int zcomp_decompress_buffer(struct zcomp *comp, void *src,
+			unsigned int src_len, struct page *page)
+{
+	might_sleep();
+	return comp->op->decompress(comp, src, src_len, page, true);
+}
+
 void zcomp_destroy(struct zcomp *comp)
 {
 	comp->op->destroy(comp);
@@ -423,6 +634,11 @@ int zcomp_copy_buffer(int err, void *buffer, int comp_len,
 	if (comp_len >= zs_huge_class_size(zram->mem_pool))
 		comp_len = PAGE_SIZE;
 
+	if (cookie->recomp_len && comp_len >= cookie->recomp_len) {
+		err = -ENOSPC;
+		goto out;
+	}
+
 	handle = zs_malloc(zram->mem_pool, comp_len,
 			__GFP_KSWAPD_RECLAIM |
 			__GFP_NOWARN |
@@ -444,8 +660,16 @@ int zcomp_copy_buffer(int err, void *buffer, int comp_len,
 		memcpy(dst_addr, buffer, comp_len);
 	}
 	zs_unmap_object(zram->mem_pool, handle);
+	if (cookie->recomp_len) {
+		if (!zram_slot_recompressed(zram, index, handle, comp_len))
+			zs_free(zram->mem_pool, handle);
+		return 0;
+	}
 	zram_slot_update(zram, index, handle, comp_len);
 out:
+	if (cookie->recomp_len)
+		return err;
+
 	if (zcomp_async(zram->comp)) {
 		if (!bio) { /* rw_page case */
 			zram_page_write_endio(zram, page, err);
@@ -13,6 +13,8 @@ struct zcomp;
 struct bio;
 
 #define BATCH_ZCOMP_REQUEST (128)
+/* max number of pages handed to zcomp_operation.compress_batch at once */
+#define ZCOMP_BATCH_PAGES (16)
 
 /*
  * For compression request, zcomp generates a cookie and pass it to
@@ -24,6 +26,8 @@ struct zcomp_cookie {
 	u32 index; /* requested page-sized block index in zram block */
 	struct page *page; /* requested page for compression */
 	struct bio *bio;
+	/* size of the stored object if this is a recompression, otherwise 0 */
+	unsigned int recomp_len;
 	struct list_head list;
 };
 
@@ -36,7 +40,15 @@ struct zcomp_cookie_pool {
 struct zcomp_operation {
 	int (*compress)(struct zcomp *comp, struct page *page, struct zcomp_cookie *cookie);
 	int (*compress_async)(struct zcomp *comp, struct page *page, struct zcomp_cookie *cookie);
-	int (*decompress)(struct zcomp *comp, void *src, unsigned int src_len, struct page *page);
+	/*
+	 * Optional. Submit @nr pages for async compression at once. Requires
+	 * compress_async. On error, none of the cookies are consumed.
+	 */
+	int (*compress_batch)(struct zcomp *comp, struct page **pages,
+			      struct zcomp_cookie **cookies, unsigned int nr);
+	/* @can_sleep is false when called under the slot lock or an object mapping */
+	int (*decompress)(struct zcomp *comp, void *src, unsigned int src_len,
+			  struct page *page, bool can_sleep);
 
 	int (*create)(struct zcomp *comp, const char *name);
 	void (*destroy)(struct zcomp *comp);
@@ -56,13 +68,21 @@ struct zcomp {
 
 ssize_t zcomp_available_show(const char *comp, char *buf);
 bool zcomp_available_algorithm(const char *comp);
+bool zcomp_sync_algorithm(const char *comp);
 
 struct zcomp *zcomp_create(const char *comp, struct zram *zram);
 void zcomp_destroy(struct zcomp *comp);
 
 int zcomp_compress(struct zcomp *comp, u32 index, struct page *page,
 			struct bio *bio);
+int zcomp_compress_batch(struct zcomp *comp, u32 index, struct page **pages,
+			unsigned int nr, struct bio *bio);
+bool zcomp_batch(struct zcomp *comp);
+int zcomp_recompress(struct zcomp *comp, u32 index, struct page *page,
+			unsigned int old_len);
 int zcomp_decompress(struct zcomp *comp, u32 index, struct page *page);
+int zcomp_decompress_buffer(struct zcomp *comp, void *src,
+			unsigned int src_len, struct page *page);
 
 int zcomp_register(const char *algo_name, const struct zcomp_operation *operation);
 int zcomp_unregister(const char *algo_name);
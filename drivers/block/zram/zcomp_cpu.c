@@ -90,7 +90,7 @@ int zcomp_cpu_compress(struct zcomp *comp, struct page *page,
 }
 
 int zcomp_cpu_decompress(struct zcomp *comp, void *src,
-			unsigned int src_len, struct page *page)
+			unsigned int src_len, struct page *page, bool can_sleep)
 {
 	void *dst;
 	unsigned int dst_len;
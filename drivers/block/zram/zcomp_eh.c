@@ -17,10 +17,17 @@ static int zcomp_eh_compress(struct zcomp *comp, struct page *page,
 	return eh_compress_page(comp->private, page, cookie);
 }
 
+static int zcomp_eh_compress_batch(struct zcomp *comp, struct page **pages,
+				   struct zcomp_cookie **cookies,
+				   unsigned int nr)
+{
+	return eh_compress_pages(comp->private, pages, (void **)cookies, nr);
+}
+
 static int zcomp_eh_decompress(struct zcomp *comp, void *src,
-			unsigned int src_len, struct page *page)
+			unsigned int src_len, struct page *page, bool can_sleep)
 {
-	return eh_decompress_page(comp->private, src, src_len, page);
+	return eh_decompress_page(comp->private, src, src_len, page, can_sleep);
 }
 
 static void zcomp_eh_destroy(struct zcomp *comp)
@@ -46,6 +53,7 @@ const struct zcomp_operation zcomp_eh_op = {
 	.create = zcomp_eh_create,
 	.destroy = zcomp_eh_destroy,
 	.compress_async = zcomp_eh_compress,
+	.compress_batch = zcomp_eh_compress_batch,
 	.decompress = zcomp_eh_decompress,
 };
 
@@ -34,6 +34,10 @@
 #include <linux/debugfs.h>
 #include <linux/cpuhotplug.h>
 #include <linux/part_stat.h>
+#include <linux/kthread.h>
+#include <linux/topology.h>
+#include <linux/sched/clock.h>
+#include <linux/wait_bit.h>
 
 #include "zram_drv.h"
 #include "zcomp.h"
@@ -48,6 +52,10 @@ static const char *default_compressor = "lzo-rle";
 /* Module params (documentation at end) */
 static unsigned int num_devices = 1;
 
+/* CPUs of each cluster, indexed by topology_physical_package_id */
+static struct cpumask zram_cluster_cpus[ZRAM_MAX_CLUSTERS];
+static unsigned long zram_present_clusters;
+
 static const struct block_device_operations zram_devops;
 static const struct block_device_operations zram_wb_devops;
 
@@ -141,6 +149,13 @@ static inline bool zram_allocated(struct zram *zram, u32 index)
 			zram_test_flag(zram, index, ZRAM_WB);
 }
 
+/* compressor the slot's object was compressed with */
+static inline struct zcomp *zram_slot_comp(struct zram *zram, u32 index)
+{
+	return zram_test_flag(zram, index, ZRAM_RECOMP) ?
+		zram->recomp : zram->comp;
+}
+
 #if PAGE_SIZE != 4096
 static inline bool is_partial_io(struct bio_vec *bvec)
 {
@@ -286,12 +301,13 @@ static ssize_t idle_store(struct device *dev,
 
 	for (index = 0; index < nr_pages; index++) {
 		/*
-		 * Do not mark ZRAM_UNDER_WB slot as ZRAM_IDLE to close race.
-		 * See the comment in writeback_store.
+		 * Do not mark ZRAM_UNDER_WB or ZRAM_UNDER_RECOMP slot as
+		 * ZRAM_IDLE to close race. See the comment in writeback_store.
 		 */
 		zram_slot_lock(zram, index);
 		if (zram_allocated(zram, index) &&
-				!zram_test_flag(zram, index, ZRAM_UNDER_WB))
+				!zram_test_flag(zram, index, ZRAM_UNDER_WB) &&
+				!zram_test_flag(zram, index, ZRAM_UNDER_RECOMP))
 			zram_set_flag(zram, index, ZRAM_IDLE);
 		zram_slot_unlock(zram, index);
 	}
@@ -372,6 +388,35 @@ static ssize_t writeback_limit_show(struct device *dev,
 	return scnprintf(buf, PAGE_SIZE, "%llu\n", val);
 }
 
+static ssize_t writeback_pack_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	zram->wb_pack = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t writeback_pack_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->wb_pack;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+}
+
 static void reset_bdev(struct zram *zram)
 {
 	struct block_device *bdev;
@@ -391,6 +436,8 @@ static void reset_bdev(struct zram *zram)
 	zram->disk->fops = &zram_devops;
 	kvfree(zram->bitmap);
 	zram->bitmap = NULL;
+	kvfree(zram->bd_refcount);
+	zram->bd_refcount = NULL;
 }
 
 static ssize_t backing_dev_show(struct device *dev,
@@ -433,6 +480,7 @@ static ssize_t backing_dev_store(struct device *dev,
 	struct address_space *mapping;
 	unsigned int bitmap_sz, old_block_size = 0;
 	unsigned long nr_pages, *bitmap = NULL;
+	atomic_t *bd_refcount = NULL;
 	struct block_device *bdev = NULL;
 	int err;
 	struct zram *zram = dev_to_zram(dev);
@@ -486,6 +534,12 @@ static ssize_t backing_dev_store(struct device *dev,
 		goto out;
 	}
 
+	bd_refcount = kvcalloc(nr_pages, sizeof(atomic_t), GFP_KERNEL);
+	if (!bd_refcount) {
+		err = -ENOMEM;
+		goto out;
+	}
+
 	old_block_size = block_size(bdev);
 	err = set_blocksize(bdev, PAGE_SIZE);
 	if (err)
@@ -497,6 +551,7 @@ static ssize_t backing_dev_store(struct device *dev,
 	zram->bdev = bdev;
 	zram->backing_dev = backing_dev;
 	zram->bitmap = bitmap;
+	zram->bd_refcount = bd_refcount;
 	zram->nr_pages = nr_pages;
 	/*
 	 * With writeback feature, zram does asynchronous IO so it's no longer
@@ -519,6 +574,9 @@ out:
 	if (bitmap)
 		kvfree(bitmap);
 
+	if (bd_refcount)
+		kvfree(bd_refcount);
+
 	if (bdev)
 		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
 
@@ -557,6 +615,13 @@ static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
 	this_cpu_dec(zram->pcp_stats->items[NR_BD_COUNT]);
 }
 
+/* drop a reference of a backing block shared by packed objects */
+static void zram_put_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	if (atomic_dec_and_test(&zram->bd_refcount[blk_idx]))
+		free_block_bdev(zram, blk_idx);
+}
+
 static void zram_page_end_io(struct bio *bio)
 {
 	struct page *page = bio_first_page_all(bio);
@@ -604,6 +669,259 @@ static int read_from_bdev_async(struct zram *zram, struct bio_vec *bvec,
 #define IDLE_WRITEBACK 2
 
 
+/*
+ * Packed writeback copies compressed objects of idle slots back to back into
+ * page sized buffers, so that several of them share one backing block, and
+ * writes up to ZRAM_PACK_PAGES buffers at once with chained bios.
+ *
+ * A packed slot keeps ZRAM_WB with ZRAM_PACKED, the object size in the
+ * obj_size bits and (blk_idx << PAGE_SHIFT | offset) as its element. Each
+ * backing block is refcounted by the objects stored in it.
+ */
+#define ZRAM_PACK_PAGES		32
+#define ZRAM_PACK_MAX_ENTRIES	(ZRAM_PACK_PAGES * 32)
+
+struct zram_pack_entry {
+	u32 index;
+	u16 page;
+	u16 offset;
+	u16 size;
+	bool recomp;
+};
+
+struct zram_pack {
+	struct page *pages[ZRAM_PACK_PAGES];
+	unsigned long blk_idx[ZRAM_PACK_PAGES];
+	unsigned int nr_pages;
+	/* fill offset in pages[nr_pages - 1] */
+	unsigned int offset;
+	struct zram_pack_entry *entries;
+	unsigned int nr_entries;
+};
+
+static void zram_pack_free(struct zram_pack *pack)
+{
+	int i;
+
+	for (i = 0; i < ZRAM_PACK_PAGES; i++) {
+		if (pack->pages[i])
+			__free_page(pack->pages[i]);
+	}
+	kvfree(pack->entries);
+	kfree(pack);
+}
+
+static struct zram_pack *zram_pack_alloc(void)
+{
+	struct zram_pack *pack;
+	int i;
+
+	pack = kzalloc(sizeof(*pack), GFP_KERNEL);
+	if (!pack)
+		return NULL;
+
+	pack->entries = kvmalloc_array(ZRAM_PACK_MAX_ENTRIES,
+				sizeof(struct zram_pack_entry), GFP_KERNEL);
+	if (!pack->entries)
+		goto err;
+
+	for (i = 0; i < ZRAM_PACK_PAGES; i++) {
+		pack->pages[i] = alloc_page(GFP_KERNEL);
+		if (!pack->pages[i])
+			goto err;
+	}
+
+	return pack;
+err:
+	zram_pack_free(pack);
+	return NULL;
+}
+
+static struct bio *zram_pack_next_bio(struct zram *zram, struct bio *prev,
+				unsigned long blk_idx, unsigned int nr_pages)
+{
+	struct bio *bio = bio_alloc(GFP_NOIO, min_t(unsigned int, nr_pages,
+						    BIO_MAX_PAGES));
+
+	bio_set_dev(bio, zram->bdev);
+	bio->bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
+	bio->bi_opf = REQ_OP_WRITE | REQ_SYNC;
+	if (prev) {
+		bio_chain(prev, bio);
+		submit_bio(prev);
+	}
+
+	return bio;
+}
+
+/*
+ * Write out the buffered packed blocks and commit their objects to the
+ * slots which are still idle. Returns the IO error, if any.
+ */
+static int zram_pack_submit(struct zram *zram, struct zram_pack *pack)
+{
+	struct blk_plug plug;
+	struct bio *bio = NULL;
+	unsigned int i;
+	int err;
+
+	if (!pack->nr_pages)
+		return 0;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < pack->nr_pages; i++) {
+		if (bio && pack->blk_idx[i] == pack->blk_idx[i - 1] + 1 &&
+		    bio_add_page(bio, pack->pages[i], PAGE_SIZE, 0))
+			continue;
+
+		bio = zram_pack_next_bio(zram, bio, pack->blk_idx[i],
+					 pack->nr_pages - i);
+		bio_add_page(bio, pack->pages[i], PAGE_SIZE, 0);
+	}
+	err = submit_bio_wait(bio);
+	bio_put(bio);
+	blk_finish_plug(&plug);
+
+	for (i = 0; i < pack->nr_entries; i++) {
+		struct zram_pack_entry *entry = &pack->entries[i];
+		unsigned long blk_idx = pack->blk_idx[entry->page];
+		u32 index = entry->index;
+
+		/* See the comment in writeback_store about the race */
+		zram_slot_lock(zram, index);
+		if (err || !zram_allocated(zram, index) ||
+			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_clear_flag(zram, index, ZRAM_IDLE);
+			zram_slot_unlock(zram, index);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_set_flag(zram, index, ZRAM_PACKED);
+		if (entry->recomp)
+			zram_set_flag(zram, index, ZRAM_RECOMP);
+		zram_set_element(zram, index,
+				 blk_idx << PAGE_SHIFT | entry->offset);
+		zram_set_obj_size(zram, index, entry->size);
+		atomic_inc(&zram->bd_refcount[blk_idx]);
+		this_cpu_inc(zram->pcp_stats->items[NR_PAGE_STORED]);
+		zram_slot_unlock(zram, index);
+	}
+
+	for (i = 0; i < pack->nr_pages; i++) {
+		if (!err) {
+			this_cpu_inc(zram->pcp_stats->items[NR_BD_WRITE]);
+			spin_lock(&zram->wb_limit_lock);
+			if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
+				zram->bd_wb_limit -= 1UL << (PAGE_SHIFT - 12);
+			spin_unlock(&zram->wb_limit_lock);
+		}
+		/* drop the writer's reference taken at block allocation */
+		zram_put_block_bdev(zram, pack->blk_idx[i]);
+	}
+
+	pack->nr_pages = 0;
+	pack->offset = 0;
+	pack->nr_entries = 0;
+
+	return err;
+}
+
+static ssize_t writeback_packed(struct zram *zram, unsigned long nr_pages,
+				ssize_t len)
+{
+	struct zram_pack *pack;
+	unsigned long index;
+	ssize_t ret = len;
+	int err;
+
+	pack = zram_pack_alloc();
+	if (!pack)
+		return -ENOMEM;
+
+	for (index = 0; index < nr_pages; index++) {
+		struct zram_pack_entry *entry;
+		unsigned int size;
+		void *src, *dst;
+
+retry:
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index))
+			goto next;
+
+		if (zram_test_flag(zram, index, ZRAM_WB) ||
+				zram_test_flag(zram, index, ZRAM_SAME) ||
+				zram_test_flag(zram, index, ZRAM_HUGE) ||
+				zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+				zram_test_flag(zram, index, ZRAM_UNDER_RECOMP) ||
+				!zram_test_flag(zram, index, ZRAM_IDLE))
+			goto next;
+
+		size = zram_get_obj_size(zram, index);
+		if (pack->nr_entries == ZRAM_PACK_MAX_ENTRIES ||
+		    (pack->nr_pages == ZRAM_PACK_PAGES &&
+		     pack->offset + size > PAGE_SIZE)) {
+			zram_slot_unlock(zram, index);
+			err = zram_pack_submit(zram, pack);
+			if (err)
+				ret = err;
+			goto retry;
+		}
+
+		if (!pack->nr_pages || pack->offset + size > PAGE_SIZE) {
+			unsigned long blk_idx;
+
+			spin_lock(&zram->wb_limit_lock);
+			if (zram->wb_limit_enable && !zram->bd_wb_limit) {
+				spin_unlock(&zram->wb_limit_lock);
+				zram_slot_unlock(zram, index);
+				ret = -EIO;
+				break;
+			}
+			spin_unlock(&zram->wb_limit_lock);
+
+			blk_idx = alloc_block_bdev(zram);
+			if (!blk_idx) {
+				zram_slot_unlock(zram, index);
+				ret = -ENOSPC;
+				break;
+			}
+			atomic_set(&zram->bd_refcount[blk_idx], 1);
+			pack->blk_idx[pack->nr_pages++] = blk_idx;
+			pack->offset = 0;
+		}
+
+		dst = page_address(pack->pages[pack->nr_pages - 1]);
+		src = zs_map_object(zram->mem_pool,
+				    zram_get_handle(zram, index), ZS_MM_RO);
+		memcpy(dst + pack->offset, src, size);
+		zs_unmap_object(zram->mem_pool, zram_get_handle(zram, index));
+
+		entry = &pack->entries[pack->nr_entries++];
+		entry->index = index;
+		entry->page = pack->nr_pages - 1;
+		entry->offset = pack->offset;
+		entry->size = size;
+		entry->recomp = zram_test_flag(zram, index, ZRAM_RECOMP);
+		pack->offset += size;
+
+		/* Clearing ZRAM_UNDER_WB is duty of zram_pack_submit */
+		zram_set_flag(zram, index, ZRAM_UNDER_WB);
+next:
+		zram_slot_unlock(zram, index);
+	}
+
+	err = zram_pack_submit(zram, pack);
+	if (err)
+		ret = err;
+	zram_pack_free(pack);
+
+	return ret;
+}
+
 static ssize_t writeback_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -644,6 +962,11 @@ static ssize_t writeback_store(struct device *dev,
 		goto release_init_lock;
 	}
 
+	if (mode == IDLE_WRITEBACK && zram->wb_pack) {
+		ret = writeback_packed(zram, nr_pages, len);
+		goto release_init_lock;
+	}
+
 	page = alloc_page(GFP_KERNEL);
 	if (!page) {
 		ret = -ENOMEM;
@@ -679,7 +1002,8 @@ static ssize_t writeback_store(struct device *dev,
 
 		if (zram_test_flag(zram, index, ZRAM_WB) ||
 				zram_test_flag(zram, index, ZRAM_SAME) ||
-				zram_test_flag(zram, index, ZRAM_UNDER_WB))
+				zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+				zram_test_flag(zram, index, ZRAM_UNDER_RECOMP))
 			goto next;
 
 		if (mode == IDLE_WRITEBACK &&
@@ -830,6 +1154,79 @@ static int read_from_bdev_sync(struct zram *zram, struct bio_vec *bvec,
 }
 #endif
 
+struct zram_packed_work {
+	struct work_struct work;
+	struct zram *zram;
+	unsigned long blk_idx;
+	struct page *page;
+	int err;
+};
+
+static int zram_read_packed_block(struct zram *zram, unsigned long blk_idx,
+				  struct page *page)
+{
+	struct bio bio;
+	struct bio_vec bio_vec;
+
+	bio_init(&bio, &bio_vec, 1);
+	bio_set_dev(&bio, zram->bdev);
+	bio.bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
+	bio.bi_opf = REQ_OP_READ;
+	bio_add_page(&bio, page, PAGE_SIZE, 0);
+
+	return submit_bio_wait(&bio);
+}
+
+static void zram_packed_read(struct work_struct *work)
+{
+	struct zram_packed_work *zw = container_of(work,
+					struct zram_packed_work, work);
+
+	zw->err = zram_read_packed_block(zw->zram, zw->blk_idx, zw->page);
+}
+
+/*
+ * A packed object has to be decompressed once the backing block is read so
+ * the read is synchronous. It is issued inline unless we are inside a
+ * ->submit_bio (e.g. the bio path rather than ->rw_page), where, as in
+ * read_from_bdev_sync, a worker avoids the deadlock with the current
+ * ->submit_bio.
+ */
+static int read_packed_from_bdev(struct zram *zram, struct zcomp *comp,
+				struct page *page, unsigned long element,
+				unsigned int size)
+{
+	struct zram_packed_work work;
+	int ret;
+
+	work.page = alloc_page(GFP_NOIO);
+	if (!work.page)
+		return -ENOMEM;
+
+	work.zram = zram;
+	work.blk_idx = element >> PAGE_SHIFT;
+	this_cpu_inc(zram->pcp_stats->items[NR_BD_READ]);
+
+	if (!current->bio_list) {
+		work.err = zram_read_packed_block(zram, work.blk_idx,
+						  work.page);
+	} else {
+		INIT_WORK_ONSTACK(&work.work, zram_packed_read);
+		queue_work(system_unbound_wq, &work.work);
+		flush_work(&work.work);
+		destroy_work_on_stack(&work.work);
+	}
+
+	ret = work.err;
+	if (!ret)
+		ret = zcomp_decompress_buffer(comp,
+				page_address(work.page) + (element & ~PAGE_MASK),
+				size, page);
+	__free_page(work.page);
+
+	return ret;
+}
+
 static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 			unsigned long entry, struct bio *parent, bool sync)
 {
@@ -848,6 +1245,13 @@ static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 }
 
 static void free_block_bdev(struct zram *zram, unsigned long blk_idx) {};
+static void zram_put_block_bdev(struct zram *zram, unsigned long blk_idx) {};
+static int read_packed_from_bdev(struct zram *zram, struct zcomp *comp,
+				struct page *page, unsigned long element,
+				unsigned int size)
+{
+	return -EIO;
+}
 #endif
 
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
@@ -1020,6 +1424,138 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recompressor, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->recompressor)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	/* recompression waits for the result inline, async backends can't */
+	if (!strcmp(compressor, "none"))
+		compressor[0] = 0x00;
+	else if (!zcomp_sync_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	/* each zcomp backend instance can serve one role only */
+	if (!strcmp(compressor, zram->compressor)) {
+		up_write(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	strcpy(zram->recompressor, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
+/*
+ * Recompress idle pages whose compressed size is at least the given number
+ * of bytes with the secondary algorithm. The new object is kept only if it
+ * is smaller.
+ */
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index;
+	unsigned int threshold;
+	struct page *page;
+	ssize_t ret = len;
+
+	if (kstrtouint(buf, 10, &threshold) || threshold >= PAGE_SIZE)
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->recomp) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	for (index = 0; index < nr_pages; index++) {
+		struct bio_vec bvec;
+		unsigned int size;
+		int err;
+
+		bvec.bv_page = page;
+		bvec.bv_len = PAGE_SIZE;
+		bvec.bv_offset = 0;
+
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index) ||
+				zram_test_flag(zram, index, ZRAM_WB) ||
+				zram_test_flag(zram, index, ZRAM_SAME) ||
+				zram_test_flag(zram, index, ZRAM_RECOMP) ||
+				zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+				zram_test_flag(zram, index, ZRAM_UNDER_RECOMP) ||
+				!zram_test_flag(zram, index, ZRAM_IDLE)) {
+			zram_slot_unlock(zram, index);
+			goto next;
+		}
+
+		size = zram_get_obj_size(zram, index);
+		if (size < threshold) {
+			zram_slot_unlock(zram, index);
+			goto next;
+		}
+
+		/* Clearing ZRAM_UNDER_RECOMP is duty of caller. */
+		zram_set_flag(zram, index, ZRAM_UNDER_RECOMP);
+		zram_slot_unlock(zram, index);
+
+		err = zram_bvec_read(zram, &bvec, index, 0, NULL, false);
+		if (!err)
+			err = zcomp_recompress(zram->recomp, index, page, size);
+
+		zram_slot_lock(zram, index);
+		zram_clear_flag(zram, index, ZRAM_UNDER_RECOMP);
+		zram_slot_unlock(zram, index);
+
+		if (err && err != -ENOSPC)
+			ret = err;
+next:
+		cond_resched();
+	}
+
+	__free_page(page);
+release_init_lock:
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
 static ssize_t compact_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
@@ -1037,12 +1573,45 @@ static ssize_t compact_store(struct device *dev,
 	return len;
 }
 
+static ssize_t comp_cluster_mask_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "0x%lx\n",
+			 READ_ONCE(zram->offload_clusters));
+}
+
+static ssize_t comp_cluster_mask_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long mask;
+	int cluster;
+
+	if (kstrtoul(buf, 0, &mask))
+		return -EINVAL;
+
+	if (mask & ~zram_present_clusters)
+		return -EINVAL;
+
+	for_each_set_bit(cluster, &mask, ZRAM_MAX_CLUSTERS) {
+		if (!zram->workers[cluster].task)
+			return -ENODEV;
+	}
+
+	WRITE_ONCE(zram->offload_clusters, mask);
+
+	return len;
+}
+
 static ssize_t io_stat_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
 	struct zram *zram = dev_to_zram(dev);
 	ssize_t ret;
 	unsigned long failed_reads, failed_writes, invalid_io, notify_free;
+	int cluster;
 
 	down_read(&zram->init_lock);
 
@@ -1052,8 +1621,19 @@ static ssize_t io_stat_show(struct device *dev,
 	notify_free = zram_stat_read(zram, NR_NOTIFY_FREE);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8llu\n",
+			"%8llu %8llu %8llu %8llu",
 			failed_reads, failed_writes, invalid_io, notify_free);
+
+	for_each_set_bit(cluster, &zram_present_clusters, ZRAM_MAX_CLUSTERS) {
+		struct zram_offload_worker *worker = &zram->workers[cluster];
+		u64 nr = atomic64_read(&worker->nr_drained);
+		u64 wait_us = nr ? div64_u64(atomic64_read(&worker->wait_ns),
+					     nr * NSEC_PER_USEC) : 0;
+
+		ret += scnprintf(buf + ret, PAGE_SIZE - ret, " %8d %8llu",
+				 atomic_read(&worker->depth), wait_us);
+	}
+	ret += scnprintf(buf + ret, PAGE_SIZE - ret, "\n");
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1097,6 +1677,25 @@ static ssize_t mm_stat_show(struct device *dev,
 	return ret;
 }
 
+static ssize_t same_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+	unsigned long checks, hits, check_ns;
+
+	down_read(&zram->init_lock);
+	checks = zram_stat_read(zram, NR_SAME_CHECK);
+	hits = zram_stat_read(zram, NR_SAME_HIT);
+	check_ns = zram_stat_read(zram, SAME_CHECK_NS);
+
+	ret = scnprintf(buf, PAGE_SIZE, "%8lu %8lu %8lu\n",
+			checks, hits, check_ns);
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
 #ifdef CONFIG_ZRAM_WRITEBACK
 #define FOUR_K(x) ((x) * (1 << (PAGE_SHIFT - 12)))
 static ssize_t bd_stat_show(struct device *dev,
@@ -1122,14 +1721,16 @@ static ssize_t bd_stat_show(struct device *dev,
 static ssize_t debug_stat_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
-	int version = 2;
+	int version = 3;
 	struct zram *zram = dev_to_zram(dev);
 	ssize_t ret;
-	unsigned long miss_free;
+	unsigned long miss_free, recomp;
 
 	down_read(&zram->init_lock);
 	miss_free = zram_stat_read(zram, NR_MISS_FREE);
-	ret = scnprintf(buf, PAGE_SIZE, "version: %d\n%8llu\n", version, miss_free);
+	recomp = zram_stat_read(zram, NR_RECOMP);
+	ret = scnprintf(buf, PAGE_SIZE, "version: %d\n%8llu\n%8lu\n",
+			version, miss_free, recomp);
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1137,6 +1738,7 @@ static ssize_t debug_stat_show(struct device *dev,
 
 static DEVICE_ATTR_RO(io_stat);
 static DEVICE_ATTR_RO(mm_stat);
+static DEVICE_ATTR_RO(same_stat);
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RO(bd_stat);
 #endif
@@ -1209,6 +1811,43 @@ void zram_slot_update(struct zram *zram, u32 index,
 	}
 }
 
+/*
+ * Replace the object of a slot under recompression with @handle. Returns
+ * false if the slot was changed since recompression started, in which case
+ * the caller still owns @handle.
+ */
+bool zram_slot_recompressed(struct zram *zram, u32 index,
+		unsigned long handle, unsigned int comp_len)
+{
+	bool ret = false;
+
+	zram_slot_lock(zram, index);
+	/* See the comment in writeback_store about ZRAM_IDLE */
+	if (!zram_allocated(zram, index) ||
+			zram_test_flag(zram, index, ZRAM_WB) ||
+			!zram_test_flag(zram, index, ZRAM_UNDER_RECOMP) ||
+			!zram_test_flag(zram, index, ZRAM_IDLE))
+		goto out;
+
+	zram_free_page(zram, index);
+	__this_cpu_inc(zram->pcp_stats->items[NR_PAGE_STORED]);
+	__this_cpu_inc(zram->pcp_stats->items[NR_RECOMP]);
+	zram_set_handle(zram, index, handle);
+	zram_set_obj_size(zram, index, comp_len);
+	zram_set_flag(zram, index, ZRAM_RECOMP);
+	/* the page was not accessed so keep it idle */
+	zram_set_flag(zram, index, ZRAM_IDLE);
+	ret = true;
+out:
+	zram_slot_unlock(zram, index);
+	if (ret) {
+		this_cpu_add(zram->pcp_stats->items[COMPRESSED_SIZE], comp_len);
+		update_max_used_page(zram);
+	}
+
+	return ret;
+}
+
 /*
  * To protect concurrent access to the same index entry,
  * caller should hold this table index entry's bit_spinlock to
@@ -1229,9 +1868,18 @@ static void zram_free_page(struct zram *zram, size_t index)
 		__this_cpu_dec(zram->pcp_stats->items[NR_HUGE_PAGE]);
 	}
 
+	if (zram_test_flag(zram, index, ZRAM_RECOMP))
+		zram_clear_flag(zram, index, ZRAM_RECOMP);
+
 	if (zram_test_flag(zram, index, ZRAM_WB)) {
 		zram_clear_flag(zram, index, ZRAM_WB);
-		free_block_bdev(zram, zram_get_element(zram, index));
+		if (zram_test_flag(zram, index, ZRAM_PACKED)) {
+			zram_clear_flag(zram, index, ZRAM_PACKED);
+			zram_put_block_bdev(zram,
+				zram_get_element(zram, index) >> PAGE_SHIFT);
+		} else {
+			free_block_bdev(zram, zram_get_element(zram, index));
+		}
 		goto out;
 	}
 
@@ -1257,7 +1905,8 @@ out:
 	zram_set_handle(zram, index, 0);
 	zram_set_obj_size(zram, index, 0);
 	WARN_ON_ONCE(zram->table[index].flags &
-		~(1UL << ZRAM_LOCK | 1UL << ZRAM_UNDER_WB));
+		~(1UL << ZRAM_LOCK | 1UL << ZRAM_UNDER_WB |
+		  1UL << ZRAM_UNDER_RECOMP));
 }
 
 static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
@@ -1271,6 +1920,16 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 	if (zram_test_flag(zram, index, ZRAM_WB)) {
 		struct bio_vec bvec;
 
+		if (zram_test_flag(zram, index, ZRAM_PACKED)) {
+			struct zcomp *comp = zram_slot_comp(zram, index);
+			unsigned long element = zram_get_element(zram, index);
+			unsigned int size = zram_get_obj_size(zram, index);
+
+			zram_slot_unlock(zram, index);
+			return read_packed_from_bdev(zram, comp, page, element,
+						     size);
+		}
+
 		zram_slot_unlock(zram, index);
 
 		bvec.bv_page = page;
@@ -1281,10 +1940,8 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 				bio, partial_io);
 	}
 
-	ret = zcomp_decompress(zram->comp, index, page);
-	zram_slot_unlock(zram, index);
-
-	return ret;
+	/* drops the slot lock */
+	return zcomp_decompress(zram_slot_comp(zram, index), index, page);
 }
 
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
@@ -1373,6 +2030,33 @@ out:
 	return ret;
 }
 
+static int zram_bvec_write_batch(struct zram *zram, struct page **pages,
+				u32 index, unsigned int nr, struct bio *bio)
+{
+	struct bio_vec bvec;
+	int ret, err;
+
+	if (zram->limit_pages &&
+			zs_get_total_pages(zram->mem_pool) > zram->limit_pages)
+		return -ENOMEM;
+
+	ret = zcomp_compress_batch(zram->comp, index, pages, nr, bio);
+	if (ret < 0)
+		return ret;
+
+	/* the pages the batch could not take go one at a time */
+	bvec.bv_len = PAGE_SIZE;
+	bvec.bv_offset = 0;
+	for (; ret < nr; ret++) {
+		bvec.bv_page = pages[ret];
+		err = __zram_bvec_write(zram, &bvec, index + ret, bio);
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
 /*
  * zram_bio_discard - handler on discard request
  * @index: physical block index in PAGE_SIZE units
@@ -1471,6 +2155,10 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 	unsigned long start_time;
 	int ret = 0;
 	const int op = bio_op(bio);
+	struct page *batch_pages[ZCOMP_BATCH_PAGES];
+	unsigned int nr_batch = 0;
+	u32 batch_index = 0;
+	bool batch;
 
 	index = bio->bi_iter.bi_sector >> SECTORS_PER_PAGE_SHIFT;
 	offset = (bio->bi_iter.bi_sector &
@@ -1486,11 +2174,43 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 		break;
 	}
 
+	/*
+	 * Multi-page write bios are handed to the compressor in batches of
+	 * full pages when the backend supports it so that HW compressors
+	 * can queue them with a single doorbell.
+	 */
+	batch = op_is_write(op) && zcomp_batch(zram->comp) &&
+		bio->bi_iter.bi_size > PAGE_SIZE;
+
 	start_time = bio_start_io_acct(bio);
 	bio_for_each_segment(bvec, bio, iter) {
 		struct bio_vec bv = bvec;
 		unsigned int unwritten = bvec.bv_len;
 
+		if (batch && !offset && bvec.bv_len == PAGE_SIZE) {
+			if (!nr_batch)
+				batch_index = index;
+			batch_pages[nr_batch++] = bvec.bv_page;
+			this_cpu_inc(zram->pcp_stats->items[NR_WRITE]);
+			index++;
+			if (nr_batch == ZCOMP_BATCH_PAGES) {
+				ret = zram_bvec_write_batch(zram, batch_pages,
+						batch_index, nr_batch, bio);
+				if (ret < 0)
+					bio->bi_status = BLK_STS_IOERR;
+				nr_batch = 0;
+			}
+			continue;
+		}
+
+		if (nr_batch) {
+			ret = zram_bvec_write_batch(zram, batch_pages,
+						batch_index, nr_batch, bio);
+			if (ret < 0)
+				bio->bi_status = BLK_STS_IOERR;
+			nr_batch = 0;
+		}
+
 		do {
 			bv.bv_len = min_t(unsigned int, PAGE_SIZE - offset,
 							unwritten);
@@ -1506,10 +2226,216 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 			update_position(&index, &offset, &bv);
 		} while (unwritten);
 	}
+
+	if (nr_batch) {
+		ret = zram_bvec_write_batch(zram, batch_pages, batch_index,
+					    nr_batch, bio);
+		if (ret < 0)
+			bio->bi_status = BLK_STS_IOERR;
+	}
 	bio_end_io_acct(bio, start_time);
 	zram_bio_endio(zram, bio, op_is_write(op), ret);
 }
 
+static int zram_cpu_cluster(int cpu)
+{
+	int cluster = topology_physical_package_id(cpu);
+
+	if (cluster < 0 || cluster >= ZRAM_MAX_CLUSTERS)
+		return 0;
+	return cluster;
+}
+
+/* true if a write of @op issued on this CPU would go to an offload worker */
+static bool zram_offload_wanted(struct zram *zram, unsigned int op)
+{
+	unsigned long mask = READ_ONCE(zram->offload_clusters);
+
+	if (!mask || !op_is_write(op) ||
+	    op == REQ_OP_DISCARD || op == REQ_OP_WRITE_ZEROES)
+		return false;
+
+	return !test_bit(zram_cpu_cluster(raw_smp_processor_id()), &mask);
+}
+
+/*
+ * Queue a write bio on this CPU's submission ring for the offload workers.
+ * Returns false if the bio should be handled inline: offload is disabled,
+ * this CPU already belongs to a selected cluster or the ring is full.
+ */
+static bool zram_offload_bio(struct zram *zram, struct bio *bio)
+{
+	unsigned long mask = READ_ONCE(zram->offload_clusters);
+	struct zram_sq_entry *entry;
+	struct zram_sq *sq;
+	int cpu, cluster, nth;
+	bool queued = false;
+
+	if (!mask || !op_is_write(bio_op(bio)) ||
+	    bio_op(bio) == REQ_OP_DISCARD || bio_op(bio) == REQ_OP_WRITE_ZEROES)
+		return false;
+
+	cpu = get_cpu();
+	if (test_bit(zram_cpu_cluster(cpu), &mask))
+		goto out;
+
+	/* spread submitting CPUs over the selected clusters */
+	nth = cpu % hweight_long(mask);
+	for_each_set_bit(cluster, &mask, ZRAM_MAX_CLUSTERS) {
+		if (!nth--)
+			break;
+	}
+
+	sq = this_cpu_ptr(zram->sq);
+	spin_lock(&sq->lock);
+	if (sq->tail - sq->head < ZRAM_SQ_DEPTH) {
+		entry = &sq->entries[sq->tail % ZRAM_SQ_DEPTH];
+		entry->bio = bio;
+		entry->queued = local_clock();
+		entry->cluster = cluster;
+		sq->tail++;
+		atomic_inc(&zram->nr_offload);
+		atomic_inc(&zram->nr_queued);
+		atomic_inc(&zram->workers[cluster].depth);
+		queued = true;
+	}
+	spin_unlock(&sq->lock);
+
+	if (queued)
+		wake_up(&zram->workers[cluster].wq);
+out:
+	put_cpu();
+	return queued;
+}
+
+/*
+ * Drain the entries queued for this worker's cluster from the submission
+ * rings of all CPUs, as one plugged batch. A ring whose head entry is for
+ * another cluster (after a comp_cluster_mask change) is left to that
+ * cluster's worker, which was woken for it. Returns the number of bios
+ * handled.
+ */
+static unsigned int zram_offload_drain(struct zram_offload_worker *worker)
+{
+	struct zram *zram = worker->zram;
+	int cluster = worker - zram->workers;
+	struct blk_plug plug;
+	unsigned int nr = 0;
+	int cpu;
+
+	blk_start_plug(&plug);
+	for_each_possible_cpu(cpu) {
+		struct zram_sq *sq = per_cpu_ptr(zram->sq, cpu);
+
+		spin_lock(&sq->lock);
+		while (sq->head != sq->tail &&
+		       sq->entries[sq->head % ZRAM_SQ_DEPTH].cluster == cluster) {
+			struct zram_sq_entry entry;
+
+			entry = sq->entries[sq->head % ZRAM_SQ_DEPTH];
+			sq->head++;
+			atomic_dec(&zram->nr_queued);
+			spin_unlock(&sq->lock);
+
+			atomic_dec(&worker->depth);
+			atomic64_add(local_clock() - entry.queued,
+				     &worker->wait_ns);
+			atomic64_inc(&worker->nr_drained);
+
+			__zram_make_request(zram, entry.bio);
+			if (atomic_dec_and_test(&zram->nr_offload))
+				wake_up_var(&zram->nr_offload);
+			nr++;
+
+			spin_lock(&sq->lock);
+		}
+		spin_unlock(&sq->lock);
+	}
+	blk_finish_plug(&plug);
+
+	return nr;
+}
+
+static int zram_offload_thread(void *data)
+{
+	struct zram_offload_worker *worker = data;
+
+	current->flags |= PF_MEMALLOC;
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(worker->wq,
+				atomic_read(&worker->depth) > 0 ||
+				kthread_should_stop());
+		zram_offload_drain(worker);
+	}
+
+	return 0;
+}
+
+static void zram_offload_wait(struct zram *zram)
+{
+	wait_var_event(&zram->nr_offload, !atomic_read(&zram->nr_offload));
+}
+
+static void zram_offload_destroy(struct zram *zram)
+{
+	int cluster;
+
+	WRITE_ONCE(zram->offload_clusters, 0);
+	zram_offload_wait(zram);
+
+	for (cluster = 0; cluster < ZRAM_MAX_CLUSTERS; cluster++) {
+		if (zram->workers[cluster].task) {
+			kthread_stop(zram->workers[cluster].task);
+			zram->workers[cluster].task = NULL;
+		}
+	}
+	free_percpu(zram->sq);
+	zram->sq = NULL;
+}
+
+/*
+ * Set up submission rings and one worker per CPU cluster. A cluster whose
+ * worker could not be created can't be selected in comp_cluster_mask.
+ */
+static int zram_offload_init(struct zram *zram, int device_id)
+{
+	int cpu, cluster;
+
+	zram->sq = alloc_percpu(struct zram_sq);
+	if (!zram->sq)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct zram_sq *sq = per_cpu_ptr(zram->sq, cpu);
+
+		spin_lock_init(&sq->lock);
+		sq->head = sq->tail = 0;
+	}
+
+	atomic_set(&zram->nr_queued, 0);
+	atomic_set(&zram->nr_offload, 0);
+	for_each_set_bit(cluster, &zram_present_clusters, ZRAM_MAX_CLUSTERS) {
+		struct zram_offload_worker *worker = &zram->workers[cluster];
+		struct task_struct *task;
+
+		worker->zram = zram;
+		init_waitqueue_head(&worker->wq);
+		task = kthread_create(zram_offload_thread, worker,
+				      "zram%d_c%d", device_id, cluster);
+		if (IS_ERR(task)) {
+			pr_err("Error creating offload worker for cluster %d\n",
+				cluster);
+			continue;
+		}
+		set_cpus_allowed_ptr(task, &zram_cluster_cpus[cluster]);
+		worker->task = task;
+		wake_up_process(task);
+	}
+
+	return 0;
+}
+
 /*
  * Handler function for all zram I/O requests.
  */
@@ -1523,6 +2449,9 @@ static blk_qc_t zram_submit_bio(struct bio *bio)
 		goto error;
 	}
 
+	if (zram_offload_bio(zram, bio))
+		return BLK_QC_T_NONE;
+
 	__zram_make_request(zram, bio);
 	return BLK_QC_T_NONE;
 
@@ -1561,6 +2490,10 @@ static int zram_rw_page(struct block_device *bdev, sector_t sector,
 		return -ENOTSUPP;
 	zram = bdev->bd_disk->private_data;
 
+	/* let the caller fall back to a bio, which can be offloaded */
+	if (zram_offload_wanted(zram, op))
+		return -EOPNOTSUPP;
+
 	if (!valid_io_request(zram, sector, PAGE_SIZE)) {
 		this_cpu_inc(zram->pcp_stats->items[NR_INVALID_IO]);
 		ret = -EINVAL;
@@ -1616,6 +2549,9 @@ static void zram_reset_device(struct zram *zram)
 		return;
 	}
 
+	/* offloaded writes may still be using the device */
+	zram_offload_wait(zram);
+
 	comp = zram->comp;
 	disksize = zram->disksize;
 	zram->disksize = 0;
@@ -1628,6 +2564,10 @@ static void zram_reset_device(struct zram *zram)
 	zram_meta_free(zram, disksize);
 	init_zram_stat(zram);
 	zcomp_destroy(comp);
+	if (zram->recomp) {
+		zcomp_destroy(zram->recomp);
+		zram->recomp = NULL;
+	}
 	reset_bdev(zram);
 }
 
@@ -1664,6 +2604,19 @@ static ssize_t disksize_store(struct device *dev,
 		goto out_free_meta;
 	}
 
+	if (zram->recompressor[0]) {
+		struct zcomp *recomp = zcomp_create(zram->recompressor, zram);
+
+		if (IS_ERR(recomp)) {
+			pr_err("Cannot initialise %s recompressing backend\n",
+					zram->recompressor);
+			zcomp_destroy(comp);
+			err = PTR_ERR(recomp);
+			goto out_free_meta;
+		}
+		zram->recomp = recomp;
+	}
+
 	zram->comp = comp;
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
@@ -1764,11 +2717,15 @@ static DEVICE_ATTR_WO(mem_used_max);
 static DEVICE_ATTR_WO(idle);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+static DEVICE_ATTR_RW(comp_cluster_mask);
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_WO(recompress);
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
 static DEVICE_ATTR_WO(writeback);
 static DEVICE_ATTR_RW(writeback_limit);
 static DEVICE_ATTR_RW(writeback_limit_enable);
+static DEVICE_ATTR_RW(writeback_pack);
 #endif
 
 static struct attribute *zram_disk_attrs[] = {
@@ -1781,14 +2738,19 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_idle.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_comp_cluster_mask.attr,
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recompress.attr,
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
 	&dev_attr_writeback.attr,
 	&dev_attr_writeback_limit.attr,
 	&dev_attr_writeback_limit_enable.attr,
+	&dev_attr_writeback_pack.attr,
 #endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
+	&dev_attr_same_stat.attr,
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_bd_stat.attr,
 #endif
@@ -1831,6 +2793,9 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+	ret = zram_offload_init(zram, device_id);
+	if (ret)
+		goto out_free_idr;
 #ifdef CONFIG_ZRAM_WRITEBACK
 	spin_lock_init(&zram->wb_limit_lock);
 #endif
@@ -1839,7 +2804,7 @@ static int zram_add(void)
 		pr_err("Error allocating disk queue for device %d\n",
 			device_id);
 		ret = -ENOMEM;
-		goto out_free_idr;
+		goto out_free_offload;
 	}
 
 	/* gendisk structure */
@@ -1899,6 +2864,8 @@ static int zram_add(void)
 
 out_free_queue:
 	blk_cleanup_queue(queue);
+out_free_offload:
+	zram_offload_destroy(zram);
 out_free_idr:
 	idr_remove(&zram_index_idr, device_id);
 out_free_stat:
@@ -1938,6 +2905,7 @@ static int zram_remove(struct zram *zram)
 	del_gendisk(zram->disk);
 	blk_cleanup_queue(zram->disk->queue);
 	put_disk(zram->disk);
+	zram_offload_destroy(zram);
 	free_percpu(zram->pcp_stats);
 	kfree(zram);
 	return 0;
@@ -2027,10 +2995,23 @@ static void destroy_devices(void)
 	unregister_blkdev(zram_major, "zram");
 }
 
+static void zram_init_clusters(void)
+{
+	int cpu, cluster;
+
+	for_each_possible_cpu(cpu) {
+		cluster = zram_cpu_cluster(cpu);
+		cpumask_set_cpu(cpu, &zram_cluster_cpus[cluster]);
+		__set_bit(cluster, &zram_present_clusters);
+	}
+}
+
 static int __init zram_init(void)
 {
 	int ret;
 
+	zram_init_clusters();
+
 	ret = class_register(&zram_control_class);
 	if (ret) {
 		pr_err("Unable to register zram-control class\n");
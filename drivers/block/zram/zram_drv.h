@@ -48,6 +48,9 @@ enum zram_pageflags {
 	ZRAM_UNDER_WB,	/* page is under writeback */
 	ZRAM_HUGE,	/* Incompressible page */
 	ZRAM_IDLE,	/* not accessed page since last idle marking */
+	ZRAM_PACKED,	/* page is stored compressed in a shared backing block */
+	ZRAM_RECOMP,	/* page is compressed by the secondary algorithm */
+	ZRAM_UNDER_RECOMP,	/* page is under recompression */
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -83,6 +86,10 @@ enum zram_stat_item {
 	NR_BD_COUNT,		/* no. of pages in backing device */
 	NR_BD_READ,		/* no. of reads from backing device */
 	NR_BD_WRITE,		/* no. of writes from backing device */
+	NR_SAME_CHECK,		/* no. of same element filled page checks */
+	NR_SAME_HIT,		/* no. of checks finding a same filled page */
+	SAME_CHECK_NS,		/* time spent in same filled page checks */
+	NR_RECOMP,		/* no. of pages recompressed */
 	NR_ZRAM_STAT_ITEM,
 };
 
@@ -90,10 +97,42 @@ struct zram_stats {
 	long items[NR_ZRAM_STAT_ITEM];
 };
 
+/*
+ * Write offload: bios submitted on CPUs outside of the clusters selected in
+ * zram->offload_clusters are queued on a per-CPU submission ring and
+ * compressed by per-cluster workers instead of inline.
+ */
+#define ZRAM_MAX_CLUSTERS	4
+#define ZRAM_SQ_DEPTH		128
+
+struct zram_sq_entry {
+	struct bio *bio;
+	u64 queued;	/* local_clock() at enqueue */
+	int cluster;	/* cluster woken for this entry */
+};
+
+struct zram_sq {
+	spinlock_t lock;
+	unsigned int head;
+	unsigned int tail;
+	struct zram_sq_entry entries[ZRAM_SQ_DEPTH];
+};
+
+struct zram_offload_worker {
+	struct zram *zram;
+	struct task_struct *task;
+	wait_queue_head_t wq;
+	atomic_t depth;		/* bios queued for this cluster */
+	atomic64_t wait_ns;	/* total queue latency of drained bios */
+	atomic64_t nr_drained;
+};
+
 struct zram {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
 	struct zcomp *comp;
+	/* optional stronger algorithm for recompression of idle pages */
+	struct zcomp *recomp;
 	struct gendisk *disk;
 	/* Prevent concurrent execution of device init */
 	struct rw_semaphore init_lock;
@@ -111,6 +150,7 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[CRYPTO_MAX_ALG_NAME];
+	char recompressor[CRYPTO_MAX_ALG_NAME];
 	/*
 	 * zram is claimed so open request will be failed
 	 */
@@ -124,10 +164,21 @@ struct zram {
 	unsigned int old_block_size;
 	unsigned long *bitmap;
 	unsigned long nr_pages;
+	/* no. of packed objects referencing each backing block */
+	atomic_t *bd_refcount;
+	bool wb_pack;
 #endif
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
 #endif
+	/* bitmask of clusters doing compression for offloaded writes */
+	unsigned long offload_clusters;
+	struct zram_sq __percpu *sq;
+	struct zram_offload_worker workers[ZRAM_MAX_CLUSTERS];
+	/* no. of bios in submission rings */
+	atomic_t nr_queued;
+	/* no. of bios queued or being processed by offload workers */
+	atomic_t nr_offload;
 };
 
 
@@ -135,6 +186,8 @@ void zram_slot_lock(struct zram *zram, u32 index);
 void zram_slot_unlock(struct zram *zram, u32 index);
 void zram_slot_update(struct zram *zram, u32 index, unsigned long handle,
 			unsigned int comp_len);
+bool zram_slot_recompressed(struct zram *zram, u32 index, unsigned long handle,
+			unsigned int comp_len);
 
 unsigned long zram_get_handle(struct zram *zram, u32 index);
 size_t zram_get_obj_size(struct zram *zram, u32 index);
@@ -71,6 +71,10 @@ struct cpu_data {
  *				perf event. Will be 0 for compute.
  * @miss_ev:			The cache miss perf event exclusive to this
  *				mon. Will be NULL for compute.
+ * @wb_ev_id:			The event code corresponding to the @wb_ev
+ *				perf event. 0 if not provided.
+ * @wb_ev:			The cache writeback perf event exclusive to
+ *				this mon. NULL if @wb_ev_id is not provided.
  * @requested_update_ms:	The mon's desired polling rate. The lowest
  *				@requested_update_ms of all mons determines
  *				@cpu_grp's update_ms.
@@ -84,6 +88,8 @@ struct memlat_mon {
 	unsigned int		miss_ev_id;
 	unsigned int		requested_update_ms;
 	struct event_data	*miss_ev;
+	unsigned int		wb_ev_id;
+	struct event_data	*wb_ev;
 	struct memlat_hwmon	hw;
 
 	struct memlat_cpu_grp	*cpu_grp;
@@ -208,6 +214,8 @@ static void update_counts_idle_core(struct memlat_cpu_grp *cpu_grp, int cpu)
 
 		mon_idx = cpu - cpumask_first(&mon->cpus);
 		read_event_local(&mon->miss_ev[mon_idx]);
+		if (mon->wb_ev)
+			read_event_local(&mon->wb_ev[mon_idx]);
 	}
 
 }
@@ -277,6 +285,8 @@ static void update_counts(struct memlat_cpu_grp *cpu_grp)
 		for_each_cpu(cpu, &mon->cpus) {
 			mon_idx = cpu - cpumask_first(&mon->cpus);
 			read_event(&mon->miss_ev[mon_idx]);
+			if (mon->wb_ev)
+				read_event(&mon->wb_ev[mon_idx]);
 		}
 	}
 }
@@ -305,6 +315,9 @@ static unsigned long get_cnt(struct memlat_hwmon *hw)
 			devstats->inst_count = 0;
 			devstats->mem_count = 1;
 		}
+
+		if (mon->wb_ev)
+			devstats->wb_count = mon->wb_ev[mon_idx].last_delta;
 	}
 
 	return 0;
@@ -411,6 +424,17 @@ static int memlat_cpuhp_up(unsigned int cpu)
 			  cpu, ret);
 			goto unlock_out;
 		}
+
+		if (!mon->wb_ev)
+			continue;
+
+		ret = set_event(&mon->wb_ev[mon_idx], cpu,
+					mon->wb_ev_id, attr);
+		if (ret) {
+			pr_err("set event %d on CPU %d fail: %d",
+			  mon->wb_ev_id, cpu, ret);
+			goto unlock_out;
+		}
 	}
 
 	per_cpu(is_on, cpu) = true;
@@ -456,6 +480,8 @@ static int memlat_cpuhp_down(unsigned int cpu)
 
 		mon_idx = cpu - cpumask_first(&mon->cpus);
 		delete_event(&mon->miss_ev[mon_idx]);
+		if (mon->wb_ev)
+			delete_event(&mon->wb_ev[mon_idx]);
 	}
 	per_cpu(is_on, cpu) = false;
 
@@ -591,6 +617,17 @@ static int start_hwmon(struct memlat_hwmon *hw)
 		}
 	}
 
+	if (mon->wb_ev) {
+		for_each_cpu(cpu, &mon->cpus) {
+			unsigned int idx = cpu - cpumask_first(&mon->cpus);
+
+			ret = set_event(&mon->wb_ev[idx], cpu,
+					mon->wb_ev_id, attr);
+			if (ret)
+				goto unlock_out;
+		}
+	}
+
 	mon->is_active = true;
 
 	if (should_init_cpu_grp)
@@ -620,8 +657,11 @@ static void stop_hwmon(struct memlat_hwmon *hw)
 
 		if (mon->miss_ev)
 			delete_event(&mon->miss_ev[idx]);
+		if (mon->wb_ev)
+			delete_event(&mon->wb_ev[idx]);
 		devstats->inst_count = 0;
 		devstats->mem_count = 0;
+		devstats->wb_count = 0;
 		devstats->freq = 0;
 		devstats->stall_pct = 0;
 	}
@@ -864,6 +904,19 @@ static int memlat_mon_probe(struct platform_device *pdev)
 	}
 	mon->miss_ev_id = event_id;
 
+	/* optional writeback event, used by the memlat model mode */
+	if (!of_property_read_u32(dev->of_node, "writeback-ev", &event_id)) {
+		mon->wb_ev = devm_kzalloc(dev,
+					  num_cpus * sizeof(*mon->wb_ev),
+					  GFP_KERNEL);
+		if (!mon->wb_ev) {
+			ret = -ENOMEM;
+			goto unlock_out;
+		}
+		mon->wb_ev_id = event_id;
+		hw->wb_supported = true;
+	}
+
 	ret = register_memlat(dev, hw);
 
 	if (!ret)
@@ -27,9 +27,33 @@
 #define CREATE_TRACE_POINTS
 #include "governor_memlat_trace.h"
 
+/**
+ * struct memlat_core_model - per-core state of the model mode
+ * @score:	demand score of the last sample, 100 being the threshold
+ * @avg:	exponentially weighted average of @score
+ * @bound:	whether the core is treated as memory latency bound
+ */
+struct memlat_core_model {
+	unsigned int score;
+	unsigned int avg;
+	bool bound;
+};
+
+#define MEMLAT_MODEL_THRESHOLD	100U
+#define MEMLAT_MODEL_FEAT_MAX	400U
+
 struct memlat_node {
 	unsigned int ratio_ceil;
 	unsigned int stall_floor;
+	unsigned int model_mode;
+	unsigned int miss_weight;
+	unsigned int stall_weight;
+	unsigned int wb_weight;
+	unsigned int wb_ratio_ceil;
+	unsigned int history_shift;
+	unsigned int ramp_lead;
+	unsigned int hyst_pct;
+	struct memlat_core_model *model;
 	bool mon_started;
 	bool already_zero;
 	struct list_head list;
@@ -169,6 +193,13 @@ static void stop_monitor(struct devfreq *df)
 	hw->stop_hwmon(hw);
 }
 
+static void memlat_model_reset(struct memlat_node *node)
+{
+	if (node->model)
+		memset(node->model, 0,
+		       node->hw->num_cores * sizeof(*node->model));
+}
+
 static int gov_start(struct devfreq *df)
 {
 	int ret = 0;
@@ -186,6 +217,7 @@ static int gov_start(struct devfreq *df)
 	hw->df = df;
 	node->orig_data = df->data;
 	df->data = node;
+	memlat_model_reset(node);
 
 	ret = start_monitor(df);
 	if (ret)
@@ -233,6 +265,7 @@ static int gov_resume(struct devfreq *df)
 	mutex_unlock(&df->lock);
 
 	node->resume_freq = 0;
+	memlat_model_reset(node);
 
 	if (!node->hw->should_ignore_df_monitor)
 		devfreq_monitor_resume(df);
@@ -253,6 +286,87 @@ static void gov_stop(struct devfreq *df)
 	hw->df = NULL;
 }
 
+/* @num is @den times of the threshold in percent, capped */
+static unsigned int memlat_model_feat(u64 num, u64 den)
+{
+	if (!den)
+		return num ? MEMLAT_MODEL_FEAT_MAX : 0;
+	return min_t(u64, div64_u64(num * 100, den), MEMLAT_MODEL_FEAT_MAX);
+}
+
+/*
+ * Combine cache miss rate, stall fraction and writeback rate into one
+ * demand score. Each feature is scaled so that its own threshold reads
+ * as MEMLAT_MODEL_THRESHOLD, then they are weighted together.
+ */
+static unsigned int memlat_model_score(struct memlat_node *node,
+				       struct dev_stats *stats)
+{
+	u64 sum = 0;
+	unsigned int weights = 0;
+
+	if (!stats->inst_count || !stats->freq)
+		return 0;
+
+	if (node->miss_weight) {
+		sum += (u64)node->miss_weight *
+			memlat_model_feat((u64)stats->mem_count *
+					  node->ratio_ceil, stats->inst_count);
+		weights += node->miss_weight;
+	}
+
+	if (node->stall_weight && node->stall_floor) {
+		sum += (u64)node->stall_weight *
+			memlat_model_feat(stats->stall_pct, node->stall_floor);
+		weights += node->stall_weight;
+	}
+
+	if (node->wb_weight && node->wb_ratio_ceil && node->hw->wb_supported) {
+		sum += (u64)node->wb_weight *
+			memlat_model_feat((u64)stats->wb_count *
+					  node->wb_ratio_ceil,
+					  stats->inst_count);
+		weights += node->wb_weight;
+	}
+
+	return weights ? div_u64(sum, weights) : 0;
+}
+
+/*
+ * Predict the demand of a core from a short history: a rising score is
+ * extrapolated @ramp_lead samples ahead so the vote ramps early, and a
+ * falling one follows the average so the vote decays smoothly. The core
+ * stays bound until the prediction drops @hyst_pct below the threshold.
+ */
+static bool memlat_model_update(struct devfreq *df, struct memlat_node *node,
+				unsigned int idx)
+{
+	struct dev_stats *stats = &node->hw->core_stats[idx];
+	struct memlat_core_model *m = &node->model[idx];
+	unsigned int score = memlat_model_score(node, stats);
+	unsigned int shift = node->history_shift;
+	unsigned int pred;
+
+	m->avg = m->avg - (m->avg >> shift) + (score >> shift);
+
+	if (score > m->score)
+		pred = score + node->ramp_lead * (score - m->score);
+	else
+		pred = max(score, m->avg);
+	m->score = score;
+
+	if (!m->bound && pred >= MEMLAT_MODEL_THRESHOLD)
+		m->bound = true;
+	else if (m->bound && pred * 100 <
+		 MEMLAT_MODEL_THRESHOLD * (100 - node->hyst_pct))
+		m->bound = false;
+
+	trace_memlat_dev_model(dev_name(df->dev.parent), stats->id, score,
+			       m->avg, pred, m->bound);
+
+	return m->bound;
+}
+
 static int devfreq_memlat_get_freq(struct devfreq *df,
 					unsigned long *freq)
 {
@@ -261,6 +375,7 @@ static int devfreq_memlat_get_freq(struct devfreq *df,
 	struct memlat_hwmon *hw = node->hw;
 	unsigned long max_freq = 0;
 	unsigned int ratio;
+	bool bound;
 
 	/*
 	 * node->resume_freq is set to 0 at the end of resume (after the update)
@@ -282,6 +397,14 @@ static int devfreq_memlat_get_freq(struct devfreq *df,
 		if (hw->core_stats[i].mem_count)
 			ratio /= hw->core_stats[i].mem_count;
 
+		/* keep the history of idle cores decaying as well */
+		if (node->model_mode && node->model)
+			bound = memlat_model_update(df, node, i);
+		else
+			bound = ratio <= node->ratio_ceil &&
+				hw->core_stats[i].stall_pct >=
+				node->stall_floor;
+
 		if (!hw->core_stats[i].freq)
 			continue;
 
@@ -292,9 +415,7 @@ static int devfreq_memlat_get_freq(struct devfreq *df,
 					hw->core_stats[i].freq,
 					hw->core_stats[i].stall_pct, ratio);
 
-		if (ratio <= node->ratio_ceil
-		    && hw->core_stats[i].stall_pct >= node->stall_floor
-		    && hw->core_stats[i].freq > max_freq) {
+		if (bound && hw->core_stats[i].freq > max_freq) {
 			lat_dev = i;
 			max_freq = hw->core_stats[i].freq;
 		}
@@ -326,9 +447,51 @@ show_attr(stall_floor)
 store_attr(stall_floor, 0U, 100U)
 static DEVICE_ATTR(stall_floor, 0644, show_stall_floor, store_stall_floor);
 
+show_attr(model_mode)
+store_attr(model_mode, 0U, 1U)
+static DEVICE_ATTR(model_mode, 0644, show_model_mode, store_model_mode);
+
+show_attr(miss_weight)
+store_attr(miss_weight, 0U, 100U)
+static DEVICE_ATTR(miss_weight, 0644, show_miss_weight, store_miss_weight);
+
+show_attr(stall_weight)
+store_attr(stall_weight, 0U, 100U)
+static DEVICE_ATTR(stall_weight, 0644, show_stall_weight, store_stall_weight);
+
+show_attr(wb_weight)
+store_attr(wb_weight, 0U, 100U)
+static DEVICE_ATTR(wb_weight, 0644, show_wb_weight, store_wb_weight);
+
+show_attr(wb_ratio_ceil)
+store_attr(wb_ratio_ceil, 0U, 20000U)
+static DEVICE_ATTR(wb_ratio_ceil, 0644, show_wb_ratio_ceil,
+		   store_wb_ratio_ceil);
+
+show_attr(history_shift)
+store_attr(history_shift, 0U, 4U)
+static DEVICE_ATTR(history_shift, 0644, show_history_shift,
+		   store_history_shift);
+
+show_attr(ramp_lead)
+store_attr(ramp_lead, 0U, 4U)
+static DEVICE_ATTR(ramp_lead, 0644, show_ramp_lead, store_ramp_lead);
+
+show_attr(hyst_pct)
+store_attr(hyst_pct, 0U, 90U)
+static DEVICE_ATTR(hyst_pct, 0644, show_hyst_pct, store_hyst_pct);
+
 static struct attribute *memlat_dev_attr[] = {
 	&dev_attr_ratio_ceil.attr,
 	&dev_attr_stall_floor.attr,
+	&dev_attr_model_mode.attr,
+	&dev_attr_miss_weight.attr,
+	&dev_attr_stall_weight.attr,
+	&dev_attr_wb_weight.attr,
+	&dev_attr_wb_ratio_ceil.attr,
+	&dev_attr_history_shift.attr,
+	&dev_attr_ramp_lead.attr,
+	&dev_attr_hyst_pct.attr,
 	&dev_attr_freq_map.attr,
 	NULL,
 };
@@ -492,8 +655,20 @@ static struct memlat_node *register_common(struct device *dev,
 		return ERR_PTR(-ENOMEM);
 
 	node->ratio_ceil = 400;
+	node->miss_weight = 50;
+	node->stall_weight = 40;
+	node->wb_weight = 10;
+	node->wb_ratio_ceil = 1000;
+	node->history_shift = 2;
+	node->ramp_lead = 1;
+	node->hyst_pct = 20;
 	node->hw = hw;
 
+	node->model = devm_kcalloc(dev, hw->num_cores, sizeof(*node->model),
+				   GFP_KERNEL);
+	if (!node->model)
+		return ERR_PTR(-ENOMEM);
+
 	if (hw->get_child_of_node) {
 		of_child = hw->get_child_of_node(dev);
 		hw->freq_map = init_core_dev_map(dev, of_child,
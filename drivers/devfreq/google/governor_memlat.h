@@ -13,6 +13,7 @@
  * struct dev_stats - Device stats
  * @inst_count:			Number of instructions executed.
  * @mem_count:			Number of memory accesses made.
+ * @wb_count:			Number of cache writebacks made.
  * @freq:			Effective frequency of the device in the
  *				last interval.
  */
@@ -20,6 +21,7 @@ struct dev_stats {
 	int id;
 	unsigned long inst_count;
 	unsigned long mem_count;
+	unsigned long wb_count;
 	unsigned long freq;
 	unsigned long stall_pct;
 };
@@ -46,6 +48,7 @@ struct core_dev_map {
  *				hardware monitor.
  * @core_stats:			Array containing instruction count, memory
  *				accesses and effective frequency for each core.
+ * @wb_supported:		Whether @core_stats carry writeback counts.
  *
  * One of dev or of_node needs to be specified for a successful registration.
  *
@@ -62,6 +65,7 @@ struct memlat_hwmon {
 
 	unsigned int num_cores;
 	struct dev_stats *core_stats;
+	bool wb_supported;
 
 	struct devfreq *df;
 	struct core_dev_map *freq_map;
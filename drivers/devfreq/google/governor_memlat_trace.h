@@ -84,6 +84,40 @@ TRACE_EVENT(memlat_dev_update,
 		__entry->vote)
 );
 
+TRACE_EVENT(memlat_dev_model,
+
+	TP_PROTO(const char *name, unsigned int dev_id, unsigned int score,
+		 unsigned int avg, unsigned int pred, bool bound),
+
+	TP_ARGS(name, dev_id, score, avg, pred, bound),
+
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(unsigned int, dev_id)
+		__field(unsigned int, score)
+		__field(unsigned int, avg)
+		__field(unsigned int, pred)
+		__field(bool, bound)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->dev_id = dev_id;
+		__entry->score = score;
+		__entry->avg = avg;
+		__entry->pred = pred;
+		__entry->bound = bound;
+	),
+
+	TP_printk("dev: %s, id=%u, score=%u, avg=%u, pred=%u, bound=%d",
+		__get_str(name),
+		__entry->dev_id,
+		__entry->score,
+		__entry->avg,
+		__entry->pred,
+		__entry->bound)
+);
+
 #endif /* _TRACE_MEMLAT_TRACE_H */
 
 /* This part must be outside protection */
@@ -18,6 +18,7 @@
 #include <linux/time.h>
 #include <linux/timer.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/pm_opp.h>
 #include "governor.h"
 
@@ -42,114 +43,6 @@ static int devfreq_simple_interactive_notifier(struct notifier_block *nb, unsign
 }
 
 #if IS_ENABLED(CONFIG_EXYNOS_ALT_DVFS)
-#define NEXTBUF(x, b)	do { if (++(x) > &(b)[LOAD_BUFFER_MAX - 1]) (x) = (b); } while (0)
-#define POSTBUF(x, b)	((x) = ((--(x) < (b)) ?				\
-			&(b)[LOAD_BUFFER_MAX - 1] : (x)))
-static unsigned long calculate_freq(struct devfreq_simple_interactive_data *data,
-				    struct devfreq_alt_track *track,
-				    unsigned long current_frequency,
-				    unsigned int targetload,
-				    unsigned long long delta_time,
-				    unsigned long long total_time,
-				    unsigned long long busy_time)
-{
-	struct devfreq_alt_dvfs_data *alt_data = &(data->alt_data);
-	struct devfreq_alt_load *ptr;
-	unsigned long freq;
-
-	/* if frequency is changed then reset the load */
-	if (!current_frequency || current_frequency != data->prev_freq) {
-		track->rear = track->front;
-		track->front->delta = 0;
-		track->total = 0;
-		track->busy = 0;
-		if (track->max_load >= targetload)
-			track->max_load = targetload;
-		else
-			track->max_load = 0;
-
-		track->max_spent = 0;
-		track->min_load = targetload;
-	}
-
-	/* skip when no event recorded */
-	if (!total_time)
-		goto out;
-
-	ptr = track->front;
-	ptr->delta += delta_time;
-	track->max_spent += delta_time;
-	track->total += total_time;
-	track->busy += busy_time;
-
-	/* if too short time, then not counting */
-	if (ptr->delta > alt_data->min_sample_time * NSEC_PER_MSEC) {
-		NEXTBUF(track->front, track->buffer);
-		track->front->delta = 0;
-
-		if (track->front == track->rear)
-			NEXTBUF(track->rear, track->buffer);
-		ptr->load = track->total ?
-				    track->busy * 1000 / track->total :
-				    0;
-		track->busy = 0;
-		track->total = 0;
-
-		/* if ptr load is higher than pervious or too small load */
-		if (track->max_load <= ptr->load) {
-			track->min_load = ptr->load;
-			track->max_spent = 0;
-			track->max_load = ptr->load;
-			goto out;
-		} else if (ptr->load < track->min_load) {
-			track->min_load = ptr->load;
-			if (ptr->load < alt_data->tolerance) {
-				track->max_load = ptr->load;
-				track->max_spent = 0;
-				return 0;
-			}
-		}
-	}
-
-	/* new max load */
-	if (track->max_spent > alt_data->hold_sample_time * NSEC_PER_MSEC) {
-		unsigned long long spent = 0;
-		/* if not valid data, then skip */
-		if (track->front == ptr) {
-			spent += ptr->delta;
-			POSTBUF(ptr, track->buffer);
-		}
-		track->max_load = ptr->load;
-		track->max_spent = spent;
-		/* if there is downtrend, then reflect current load */
-		if (ptr->load > track->min_load + alt_data->tolerance) {
-			track->min_load = ptr->load;
-			spent += ptr->delta;
-			POSTBUF(ptr, track->buffer);
-			for (; spent < alt_data->hold_sample_time *
-			     NSEC_PER_MSEC && ptr != track->rear;
-			     POSTBUF(ptr, track->buffer)) {
-				if (track->max_load < ptr->load) {
-					track->max_load = ptr->load;
-					track->max_spent = spent;
-				} else if (track->min_load > ptr->load) {
-					track->min_load = ptr->load;
-				}
-				spent += ptr->delta;
-			}
-		} else {
-			track->min_load = ptr->load;
-		}
-	}
-out:
-	if (track->max_load == targetload || track->total)
-		freq = data->governor_freq;
-	else
-		freq = track->max_load * current_frequency / targetload;
-
-	return freq;
-}
-
 static unsigned int mif_to_int_freq(struct devfreq_alt_dvfs_data *alt_data,
 				    unsigned long freq)
 {
@@ -176,17 +69,21 @@ static unsigned long update_load(struct devfreq_dev_status *stat,
 	struct exynos_devfreq_data *exynos_df =
 		container_of(data, struct exynos_devfreq_data, simple_interactive_data);
 	unsigned long freq, cal_freq, bus2_freq = 0;
-	unsigned int int_freq = 0;
+	unsigned int int_freq = 0, targetload;
 	int i, idx = 0;
 
 	freq = 0;
 	for (i = 0; i < alt_data->track_group; i++) {
-		cal_freq = calculate_freq(data, &(alt_data->track[i]),
-					  stat->current_frequency,
-					  alt_data->target_load[i],
-					  profile_data->delta_time,
-					  profile_data->ppc_val[i].ccnt,
-					  profile_data->ppc_val[i].pmcnt1);
+		targetload = devfreq_alt_target_load(alt_data, i,
+						     stat->current_frequency);
+		cal_freq = devfreq_alt_calc_freq(alt_data, &(alt_data->track[i]),
+						 stat->current_frequency,
+						 data->prev_freq,
+						 data->governor_freq,
+						 targetload,
+						 profile_data->delta_time,
+						 profile_data->ppc_val[i].ccnt,
+						 profile_data->ppc_val[i].pmcnt1);
 		if (i == PPC_BUS2_ID) {
 			bus2_freq = cal_freq;
 			bus2_freq = min(bus2_freq, stat->current_frequency << 1);
@@ -198,13 +95,10 @@ static unsigned long update_load(struct devfreq_dev_status *stat,
 		}
 	}
 
-	/* Limit the change to 50% ~ 200% */
-	freq = min(freq, stat->current_frequency << 1);
-	freq = max(freq, stat->current_frequency >> 1);
-
-	if (alt_data->track[idx].max_load > alt_data->hispeed_load &&
-	    alt_data->hispeed_freq > freq)
-		freq = alt_data->hispeed_freq;
+	freq = devfreq_alt_next_freq(alt_data, stat->current_frequency,
+				     data->prev_freq, freq,
+				     alt_data->track[idx].max_load,
+				     ktime_get_ns());
 
 	/* Only vote for INT freq from PPC BUS2 */
 	if (exynos_pm_qos_request_active(&exynos_df->bus_pm_qos_min)) {
@@ -315,11 +209,12 @@ out:
 			msecs_to_jiffies(data->alt_data.min_sample_time * 2);
 		add_timer_on(&data->freq_timer, BOUND_CPU_NUM);
 
-		if (*freq > exynos_df->min_freq) {
+		if (*freq > exynos_df->min_freq &&
+		    data->alt_data.timer_slack >= 0) {
 			/* timer is bound to cpu0 */
 			del_timer(&data->freq_slack_timer);
 			data->freq_slack_timer.expires = expires +
-				  msecs_to_jiffies(data->alt_data.hold_sample_time);
+				  msecs_to_jiffies(data->alt_data.timer_slack);
 			add_timer_on(&data->freq_slack_timer, BOUND_CPU_NUM);
 		} else if (timer_pending(&data->freq_slack_timer)) {
 			del_timer(&data->freq_slack_timer);
@@ -357,6 +252,31 @@ static int devfreq_change_freq_task(void *data)
 static void alt_dvfs_nop_timer(struct timer_list *timer)
 {
 }
+
+/*
+ * Raise the governor vote to boost_freq for @duration msec (0 selects
+ * boostpulse_duration). Safe to call from input and display event paths:
+ * it only moves the end time and kicks the governor thread.
+ */
+void devfreq_simple_interactive_boost_pulse(struct devfreq_simple_interactive_data *data,
+					    unsigned int duration)
+{
+	struct devfreq_alt_dvfs_data *alt_data = &data->alt_data;
+	struct task_struct *task;
+
+	if (!duration)
+		duration = alt_data->boostpulse_duration;
+
+	WRITE_ONCE(alt_data->boostpulse_endtime,
+		   ktime_get_ns() + duration * NSEC_PER_MSEC);
+
+	/* the governor thread is stopped only after an RCU grace period */
+	rcu_read_lock();
+	task = READ_ONCE(data->change_freq_task);
+	if (!IS_ERR_OR_NULL(task))
+		wake_up_process(task);
+	rcu_read_unlock();
+}
 #endif
 
 /*timer callback function send a signal */
@@ -412,7 +332,11 @@ static int devfreq_simple_interactive_register_notifier(struct devfreq *df)
 
 	ret = sched_setscheduler_nocheck(data->change_freq_task, SCHED_FIFO, &param);
 	if (ret) {
-		kthread_stop(data->change_freq_task);
+		struct task_struct *task = data->change_freq_task;
+
+		WRITE_ONCE(data->change_freq_task, NULL);
+		synchronize_rcu();
+		kthread_stop(task);
 		pr_err("%s: failed to set SCHED_FIFO\n", __func__);
 		goto err3;
 	}
@@ -422,9 +346,11 @@ static int devfreq_simple_interactive_register_notifier(struct devfreq *df)
 		data->freq_timer.expires = jiffies +
 			msecs_to_jiffies(data->alt_data.min_sample_time * 2);
 		add_timer_on(&data->freq_timer, BOUND_CPU_NUM);
-		data->freq_slack_timer.expires = jiffies +
-			msecs_to_jiffies(data->alt_data.hold_sample_time);
-		add_timer_on(&data->freq_slack_timer, BOUND_CPU_NUM);
+		if (data->alt_data.timer_slack >= 0) {
+			data->freq_slack_timer.expires = jiffies +
+				msecs_to_jiffies(data->alt_data.timer_slack);
+			add_timer_on(&data->freq_slack_timer, BOUND_CPU_NUM);
+		}
 	}
 
 #else
@@ -457,6 +383,7 @@ static int devfreq_simple_interactive_unregister_notifier(struct devfreq *df)
 {
 	int ret;
 	struct devfreq_simple_interactive_data *data = df->data;
+	struct task_struct *task;
 
 	if (!data)
 		return -EINVAL;
@@ -470,7 +397,12 @@ static int devfreq_simple_interactive_unregister_notifier(struct devfreq *df)
 	ret = exynos_pm_qos_remove_notifier(data->pm_qos_class, &data->nb.nb);
 
 	destroy_timer_on_stack(&data->freq_timer);
-	kthread_stop(data->change_freq_task);
+
+	/* let boost pulses that saw the task finish waking it before it goes */
+	task = data->change_freq_task;
+	WRITE_ONCE(data->change_freq_task, NULL);
+	synchronize_rcu();
+	kthread_stop(task);
 
 err:
 	return ret;
@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * ALT-DVFS load tracking and frequency policy for the simpleinteractive
+ * devfreq governor.
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd.
+ *		http://www.samsung.com
+ * Copyright 2021 Google LLC
+ *
+ * This file must stay free of kernel services: it only sees the samples
+ * and the clock handed in by governor_simpleinteractive.c, so it can be
+ * built in userspace and replayed against recorded devfreq status.
+ */
+
+#include <soc/google/exynos-devfreq-interactive.h>
+
+#define NEXTBUF(x, b)	do { if (++(x) > &(b)[LOAD_BUFFER_MAX - 1]) (x) = (b); } while (0)
+#define POSTBUF(x, b)	((x) = ((--(x) < (b)) ?				\
+			&(b)[LOAD_BUFFER_MAX - 1] : (x)))
+
+void devfreq_alt_init_track(struct devfreq_alt_track *track)
+{
+	track->front = track->buffer;
+	track->rear = track->buffer;
+	track->min_load = 100;
+}
+
+/* look up a "value freq:value ..." list, same walk as delay_time */
+unsigned int devfreq_alt_freq_param(const unsigned int *list, int nlist,
+				    unsigned long freq)
+{
+	int i;
+
+	if (!list || nlist <= 0)
+		return 0;
+
+	for (i = 0; i < nlist - 1 && freq >= list[i + 1]; i += 2)
+		;
+
+	return list[i];
+}
+
+unsigned int devfreq_alt_target_load(struct devfreq_alt_dvfs_data *alt_data,
+				     unsigned int group,
+				     unsigned long current_frequency)
+{
+	unsigned int targetload;
+
+	if (alt_data->nfreq_target_load > 0) {
+		targetload = devfreq_alt_freq_param(alt_data->freq_target_load,
+						    alt_data->nfreq_target_load,
+						    current_frequency);
+		/* a zero load would divide by zero, use the group one */
+		if (targetload)
+			return targetload;
+	}
+
+	if (group >= alt_data->num_target_load)
+		group = alt_data->num_target_load - 1;
+
+	return alt_data->target_load[group];
+}
+
+unsigned long devfreq_alt_calc_freq(struct devfreq_alt_dvfs_data *alt_data,
+				    struct devfreq_alt_track *track,
+				    unsigned long current_frequency,
+				    unsigned long prev_freq,
+				    unsigned long governor_freq,
+				    unsigned int targetload,
+				    unsigned long long delta_time,
+				    unsigned long long total_time,
+				    unsigned long long busy_time)
+{
+	struct devfreq_alt_load *ptr;
+	unsigned long freq;
+
+	/* if frequency is changed then reset the load */
+	if (!current_frequency || current_frequency != prev_freq) {
+		track->rear = track->front;
+		track->front->delta = 0;
+		track->total = 0;
+		track->busy = 0;
+		if (track->max_load >= targetload)
+			track->max_load = targetload;
+		else
+			track->max_load = 0;
+
+		track->max_spent = 0;
+		track->min_load = targetload;
+	}
+
+	/* skip when no event recorded */
+	if (!total_time)
+		goto out;
+
+	ptr = track->front;
+	ptr->delta += delta_time;
+	track->max_spent += delta_time;
+	track->total += total_time;
+	track->busy += busy_time;
+
+	/* if too short time, then not counting */
+	if (ptr->delta > alt_data->min_sample_time * ALTDVFS_NSEC_PER_MSEC) {
+		NEXTBUF(track->front, track->buffer);
+		track->front->delta = 0;
+
+		if (track->front == track->rear)
+			NEXTBUF(track->rear, track->buffer);
+		ptr->load = track->total ?
+				    track->busy * 1000 / track->total :
+				    0;
+		track->busy = 0;
+		track->total = 0;
+
+		/* if ptr load is higher than pervious or too small load */
+		if (track->max_load <= ptr->load) {
+			track->min_load = ptr->load;
+			track->max_spent = 0;
+			track->max_load = ptr->load;
+			goto out;
+		} else if (ptr->load < track->min_load) {
+			track->min_load = ptr->load;
+			if (ptr->load < alt_data->tolerance) {
+				track->max_load = ptr->load;
+				track->max_spent = 0;
+				return 0;
+			}
+		}
+	}
+
+	/* new max load */
+	if (track->max_spent > alt_data->hold_sample_time *
+	    ALTDVFS_NSEC_PER_MSEC) {
+		unsigned long long spent = 0;
+		/* if not valid data, then skip */
+		if (track->front == ptr) {
+			spent += ptr->delta;
+			POSTBUF(ptr, track->buffer);
+		}
+		track->max_load = ptr->load;
+		track->max_spent = spent;
+		/* if there is downtrend, then reflect current load */
+		if (ptr->load > track->min_load + alt_data->tolerance) {
+			track->min_load = ptr->load;
+			spent += ptr->delta;
+			POSTBUF(ptr, track->buffer);
+			for (; spent < alt_data->hold_sample_time *
+			     ALTDVFS_NSEC_PER_MSEC && ptr != track->rear;
+			     POSTBUF(ptr, track->buffer)) {
+				if (track->max_load < ptr->load) {
+					track->max_load = ptr->load;
+					track->max_spent = spent;
+				} else if (track->min_load > ptr->load) {
+					track->min_load = ptr->load;
+				}
+				spent += ptr->delta;
+			}
+		} else {
+			track->min_load = ptr->load;
+		}
+	}
+out:
+	if (track->max_load == targetload || track->total)
+		freq = governor_freq;
+	else
+		freq = track->max_load * current_frequency / targetload;
+
+	return freq;
+}
+
+/*
+ * Turn the highest per-track request into the frequency to vote for:
+ * limit the step, apply hispeed, hold above hispeed_freq for
+ * above_hispeed_delay and finally honour an active boost pulse.
+ */
+unsigned long devfreq_alt_next_freq(struct devfreq_alt_dvfs_data *alt_data,
+				    unsigned long current_frequency,
+				    unsigned long prev_freq,
+				    unsigned long freq, unsigned int max_load,
+				    unsigned long long now)
+{
+	unsigned long long boost_end = alt_data->boostpulse_endtime;
+	unsigned int delay;
+
+	/* Limit the change to 50% ~ 200% */
+	if (freq > current_frequency << 1)
+		freq = current_frequency << 1;
+	if (freq < current_frequency >> 1)
+		freq = current_frequency >> 1;
+
+	if (max_load > alt_data->hispeed_load && alt_data->hispeed_freq > freq)
+		freq = alt_data->hispeed_freq;
+
+	/* time spent at the current frequency starts when it changes */
+	if (current_frequency != prev_freq)
+		alt_data->hispeed_validate_time = now;
+
+	delay = devfreq_alt_freq_param(alt_data->above_hispeed_delay,
+				       alt_data->nabove_hispeed_delay,
+				       current_frequency);
+	if (delay) {
+		if (current_frequency < alt_data->hispeed_freq &&
+		    freq > alt_data->hispeed_freq)
+			freq = alt_data->hispeed_freq;
+		else if (current_frequency >= alt_data->hispeed_freq &&
+			 freq > current_frequency &&
+			 now - alt_data->hispeed_validate_time <
+			 delay * ALTDVFS_NSEC_PER_MSEC)
+			freq = current_frequency;
+	}
+
+	if (now < boost_end && alt_data->boost_freq > freq)
+		freq = alt_data->boost_freq;
+
+	return freq;
+}
@@ -442,6 +442,34 @@ int exynos_devfreq_lock_freq(unsigned int devfreq_type, unsigned int target_freq
 }
 EXPORT_SYMBOL(exynos_devfreq_lock_freq);
 
+int exynos_devfreq_boost_pulse(unsigned int devfreq_type, unsigned int duration)
+{
+#if IS_ENABLED(CONFIG_EXYNOS_ALT_DVFS)
+	struct exynos_devfreq_data *data = NULL;
+
+	if ((devfreq_type >= DEVFREQ_MIF) && (devfreq_type < DEVFREQ_TYPE_END)) {
+		data = devfreq_data[devfreq_type];
+	} else
+		return -EINVAL;
+
+	if (!data) {
+		pr_err("%s, Fail to get exynos_devfreq_data\n", __func__);
+		return -ENOMEM;
+	}
+
+	if (data->gov_type != SIMPLE_INTERACTIVE || !data->use_get_dev)
+		return -EOPNOTSUPP;
+
+	devfreq_simple_interactive_boost_pulse(&data->simple_interactive_data,
+					       duration);
+
+	return 0;
+#else
+	return -EOPNOTSUPP;
+#endif
+}
+EXPORT_SYMBOL(exynos_devfreq_boost_pulse);
+
 static int exynos_devfreq_set_freq(struct device *dev, u32 new_freq,
 				   struct clk *clk,
 				   struct exynos_devfreq_data *data)
@@ -812,6 +840,10 @@ static ssize_t show_alt_dvfs_info(struct device *dev,
 			  data->simple_interactive_data.alt_data.hispeed_load);
 	count += snprintf(buf + count, PAGE_SIZE, "HISPEED FREQ: %u\n",
 			  data->simple_interactive_data.alt_data.hispeed_freq);
+	count += snprintf(buf + count, PAGE_SIZE, "TIMER SLACK: %d\n",
+			  data->simple_interactive_data.alt_data.timer_slack);
+	count += snprintf(buf + count, PAGE_SIZE, "BOOST FREQ: %u\n",
+			  data->simple_interactive_data.alt_data.boost_freq);
 
 	mutex_unlock(&data->devfreq->lock);
 
@@ -1146,6 +1178,232 @@ static ssize_t store_hold_sample_time(struct device *dev,
 	return count;
 }
 
+static ssize_t freq_target_load_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+	struct devfreq_alt_dvfs_data *alt_data =
+		&data->simple_interactive_data.alt_data;
+	ssize_t count = 0;
+	int i;
+
+	mutex_lock(&data->devfreq->lock);
+	for (i = 0; i < alt_data->nfreq_target_load; i++) {
+		count += snprintf(buf + count, PAGE_SIZE, "%u%s",
+				  alt_data->freq_target_load[i],
+				  (i == alt_data->nfreq_target_load - 1) ?
+				  "" : (i % 2) ? ":" : " ");
+	}
+	count += snprintf(buf + count, PAGE_SIZE, "\n");
+	mutex_unlock(&data->devfreq->lock);
+	return count;
+}
+
+static ssize_t freq_target_load_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+	struct devfreq_alt_dvfs_data *alt_data =
+		&data->simple_interactive_data.alt_data;
+	unsigned int *new_target_load = NULL;
+	int ntokens = 0;
+
+	/* "0" goes back to the per group target_load */
+	if (!sysfs_streq(buf, "0")) {
+		new_target_load = get_tokenized_data(buf, &ntokens);
+		if (IS_ERR(new_target_load))
+			return PTR_ERR(new_target_load);
+	}
+
+	mutex_lock(&data->devfreq->lock);
+	kfree(alt_data->freq_target_load);
+	alt_data->freq_target_load = new_target_load;
+	alt_data->nfreq_target_load = ntokens;
+	mutex_unlock(&data->devfreq->lock);
+
+	return count;
+}
+
+static ssize_t above_hispeed_delay_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+	struct devfreq_alt_dvfs_data *alt_data =
+		&data->simple_interactive_data.alt_data;
+	ssize_t count = 0;
+	int i;
+
+	mutex_lock(&data->devfreq->lock);
+	for (i = 0; i < alt_data->nabove_hispeed_delay; i++) {
+		count += snprintf(buf + count, PAGE_SIZE, "%u%s",
+				  alt_data->above_hispeed_delay[i],
+				  (i == alt_data->nabove_hispeed_delay - 1) ?
+				  "" : (i % 2) ? ":" : " ");
+	}
+	if (!alt_data->nabove_hispeed_delay)
+		count += snprintf(buf + count, PAGE_SIZE, "0");
+	count += snprintf(buf + count, PAGE_SIZE, "\n");
+	mutex_unlock(&data->devfreq->lock);
+	return count;
+}
+
+static ssize_t above_hispeed_delay_store(struct device *dev,
+					 struct device_attribute *attr,
+					 const char *buf, size_t count)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+	struct devfreq_alt_dvfs_data *alt_data =
+		&data->simple_interactive_data.alt_data;
+	unsigned int *new_delay;
+	int ntokens;
+
+	new_delay = get_tokenized_data(buf, &ntokens);
+	if (IS_ERR(new_delay))
+		return PTR_ERR(new_delay);
+
+	mutex_lock(&data->devfreq->lock);
+	kfree(alt_data->above_hispeed_delay);
+	alt_data->above_hispeed_delay = new_delay;
+	alt_data->nabove_hispeed_delay = ntokens;
+	mutex_unlock(&data->devfreq->lock);
+
+	return count;
+}
+
+static ssize_t timer_slack_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n",
+			data->simple_interactive_data.alt_data.timer_slack);
+}
+
+static ssize_t timer_slack_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+	int timer_slack;
+
+	if (kstrtoint(buf, 10, &timer_slack))
+		return -EINVAL;
+
+	mutex_lock(&data->devfreq->lock);
+	data->simple_interactive_data.alt_data.timer_slack = timer_slack;
+	mutex_unlock(&data->devfreq->lock);
+
+	return count;
+}
+
+static ssize_t boost_freq_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			data->simple_interactive_data.alt_data.boost_freq);
+}
+
+static ssize_t boost_freq_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+	unsigned int boost_freq;
+
+	if (kstrtouint(buf, 10, &boost_freq))
+		return -EINVAL;
+
+	mutex_lock(&data->devfreq->lock);
+	data->simple_interactive_data.alt_data.boost_freq = boost_freq;
+	mutex_unlock(&data->devfreq->lock);
+
+	return count;
+}
+
+static ssize_t boostpulse_duration_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n",
+			data->simple_interactive_data.alt_data.boostpulse_duration);
+}
+
+static ssize_t boostpulse_duration_store(struct device *dev,
+					 struct device_attribute *attr,
+					 const char *buf, size_t count)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+	unsigned int duration;
+
+	if (kstrtouint(buf, 10, &duration) || !duration)
+		return -EINVAL;
+
+	mutex_lock(&data->devfreq->lock);
+	data->simple_interactive_data.alt_data.boostpulse_duration = duration;
+	mutex_unlock(&data->devfreq->lock);
+
+	return count;
+}
+
+/* write a duration in msec, 0 uses boostpulse_duration */
+static ssize_t boostpulse_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct device *parent = dev->parent;
+	struct platform_device *pdev =
+		container_of(parent, struct platform_device, dev);
+	struct exynos_devfreq_data *data = platform_get_drvdata(pdev);
+	unsigned int duration;
+
+	if (data->gov_type != SIMPLE_INTERACTIVE || !data->use_get_dev)
+		return -EOPNOTSUPP;
+
+	if (kstrtouint(buf, 10, &duration))
+		return -EINVAL;
+
+	devfreq_simple_interactive_boost_pulse(&data->simple_interactive_data,
+					       duration);
+
+	return count;
+}
+
 static ssize_t min_sample_time_show(struct device *dev,
 				    struct device_attribute *attr, char *buf)
 {
@@ -1192,6 +1450,12 @@ static DEVICE_ATTR(target_load, 0640, show_target_load, store_target_load);
 static DEVICE_ATTR(hold_sample_time, 0640, show_hold_sample_time,
 		   store_hold_sample_time);
 static DEVICE_ATTR_RW(min_sample_time);
+static DEVICE_ATTR_RW(freq_target_load);
+static DEVICE_ATTR_RW(above_hispeed_delay);
+static DEVICE_ATTR_RW(timer_slack);
+static DEVICE_ATTR_RW(boost_freq);
+static DEVICE_ATTR_RW(boostpulse_duration);
+static DEVICE_ATTR(boostpulse, 0200, NULL, boostpulse_store);
 #endif
 
 static struct attribute *devfreq_interactive_sysfs_entries[] = {
@@ -1201,6 +1465,12 @@ static struct attribute *devfreq_interactive_sysfs_entries[] = {
 	&dev_attr_target_load.attr,
 	&dev_attr_hold_sample_time.attr,
 	&dev_attr_min_sample_time.attr,
+	&dev_attr_freq_target_load.attr,
+	&dev_attr_above_hispeed_delay.attr,
+	&dev_attr_timer_slack.attr,
+	&dev_attr_boost_freq.attr,
+	&dev_attr_boostpulse_duration.attr,
+	&dev_attr_boostpulse.attr,
 #endif
 	NULL,
 };
@@ -1636,6 +1906,35 @@ static int exynos_devfreq_parse_dt(struct device_node *np,
 						 &alt_data->tolerance))
 				alt_data->tolerance = ALTDVFS_TOLERANCE;
 
+			/* Optional interactive policy, off unless described */
+			if (!of_property_read_string(np, "freq_target_load",
+						     &buf)) {
+				alt_data->freq_target_load =
+					get_tokenized_data(buf, &ntokens);
+				if (IS_ERR(alt_data->freq_target_load))
+					return PTR_ERR(alt_data->freq_target_load);
+				alt_data->nfreq_target_load = ntokens;
+			}
+			if (!of_property_read_string(np, "above_hispeed_delay",
+						     &buf)) {
+				alt_data->above_hispeed_delay =
+					get_tokenized_data(buf, &ntokens);
+				if (IS_ERR(alt_data->above_hispeed_delay))
+					return PTR_ERR(alt_data->above_hispeed_delay);
+				alt_data->nabove_hispeed_delay = ntokens;
+			}
+			if (of_property_read_s32(np, "timer_slack",
+						 &alt_data->timer_slack))
+				alt_data->timer_slack =
+					alt_data->hold_sample_time;
+			if (of_property_read_u32(np, "boost_freq",
+						 &alt_data->boost_freq))
+				alt_data->boost_freq = alt_data->hispeed_freq;
+			if (of_property_read_u32(np, "boostpulse_duration",
+						 &alt_data->boostpulse_duration))
+				alt_data->boostpulse_duration =
+					ALTDVFS_BOOSTPULSE_DURATION;
+
 			/* Initial buffer and load setup */
 			alt_data->track_group = data->um_data.um_group;
 			alt_data->track = devm_kcalloc(data->dev,
@@ -1647,11 +1946,8 @@ static int exynos_devfreq_parse_dt(struct device_node *np,
 					"Failed to allocate memory\n");
 				return -ENOMEM;
 			}
-			for (i = 0; i < alt_data->track_group; i++) {
-				alt_data->track[i].front = alt_data->track[i].buffer;
-				alt_data->track[i].rear = alt_data->track[i].buffer;
-				alt_data->track[i].min_load = 100;
-			}
+			for (i = 0; i < alt_data->track_group; i++)
+				devfreq_alt_init_track(&alt_data->track[i]);
 
 			/* Initial governor freq setup */
 			data->simple_interactive_data.governor_freq = 0;
@@ -11,6 +11,7 @@
  *	Andrew F. Davis <afd@ti.com>
  */
 
+#include <linux/debugfs.h>
 #include <linux/dma-buf.h>
 #include <linux/dma-direct.h>
 #include <linux/dma-heap.h>
@@ -21,6 +22,8 @@
 #include <linux/module.h>
 #include <linux/samsung-dma-mapping.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
 #include <linux/slab.h>
 #include <uapi/linux/dma-buf.h>
 
@@ -29,12 +32,56 @@
 
 struct dma_iovm_map {
 	struct list_head list;
+	struct hlist_node node;		/* buffer->iovm_hash, keyed by domain and attrs */
+	struct list_head lru;		/* iova_lru while lazily unmapped */
+	struct samsung_dma_buffer *buffer;
+	struct dma_buf *dmabuf;		/* pinned by the shrinker while isolated */
 	struct device *dev;
+	struct iommu_domain *domain;
 	struct sg_table table;
 	unsigned long attrs;
 	unsigned int mapcnt;
 };
 
+/*
+ * Mappings whose mapcnt dropped to zero are kept for reuse until the buffer
+ * is released. They are also on a global LRU that the shrinker trims under
+ * memory pressure. Lock order is buffer->lock, then iova_lru_lock.
+ */
+static LIST_HEAD(iova_lru);
+static DEFINE_SPINLOCK(iova_lru_lock);
+static unsigned long iova_lru_count;
+
+static atomic64_t iova_hit;
+static atomic64_t iova_lazy_hit;
+static atomic64_t iova_miss;
+static atomic64_t iova_evict;
+
+static struct dentry *iova_stat_dentry;
+
+static inline unsigned long dma_iovm_key(struct iommu_domain *domain, unsigned long attrs)
+{
+	return (unsigned long)domain ^ attrs;
+}
+
+static void dma_iova_lru_add(struct dma_iovm_map *iovm_map)
+{
+	spin_lock(&iova_lru_lock);
+	list_add_tail(&iovm_map->lru, &iova_lru);
+	iova_lru_count++;
+	spin_unlock(&iova_lru_lock);
+}
+
+static void dma_iova_lru_del(struct dma_iovm_map *iovm_map)
+{
+	spin_lock(&iova_lru_lock);
+	if (!list_empty(&iovm_map->lru)) {
+		list_del_init(&iovm_map->lru);
+		iova_lru_count--;
+	}
+	spin_unlock(&iova_lru_lock);
+}
+
 static struct dma_iovm_map *dma_iova_create(struct dma_buf_attachment *a)
 {
 	struct samsung_dma_buffer *buffer = a->dmabuf->priv;
@@ -58,7 +105,11 @@ static struct dma_iovm_map *dma_iova_create(struct dma_buf_attachment *a)
 		new_sg = sg_next(new_sg);
 	}
 
+	INIT_LIST_HEAD(&iovm_map->lru);
+	iovm_map->buffer = buffer;
+	iovm_map->dmabuf = a->dmabuf;
 	iovm_map->dev = a->dev;
+	iovm_map->domain = iommu_get_domain_for_dev(a->dev);
 	iovm_map->attrs = a->dma_map_attrs;
 
 	return iovm_map;
@@ -70,22 +121,35 @@ static void dma_iova_remove(struct dma_iovm_map *iovm_map)
 	kfree(iovm_map);
 }
 
+/* this function should only be called while buffer->lock is held */
+static void dma_iova_unmap_remove(struct dma_iovm_map *iovm_map)
+{
+	struct samsung_dma_buffer *buffer = iovm_map->buffer;
+
+	list_del(&iovm_map->list);
+	hash_del(&iovm_map->node);
+	dma_iova_lru_del(iovm_map);
+	if (!dma_heap_tzmp_buffer(iovm_map->dev, buffer->flags))
+		dma_unmap_sgtable(iovm_map->dev, &iovm_map->table,
+				  DMA_TO_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+	dma_iova_remove(iovm_map);
+}
+
 static void dma_iova_release(struct dma_buf *dmabuf)
 {
 	struct samsung_dma_buffer *buffer = dmabuf->priv;
 	struct dma_iovm_map *iovm_map, *tmp;
 
+	/* serialize against the shrinker that may be unmapping an idle entry */
+	mutex_lock(&buffer->lock);
 	list_for_each_entry_safe(iovm_map, tmp, &buffer->attachments, list) {
 		if (iovm_map->mapcnt)
 			WARN(1, "iova_map refcount leak found for %s\n",
 			     dev_name(iovm_map->dev));
 
-		list_del(&iovm_map->list);
-		if (!dma_heap_tzmp_buffer(iovm_map->dev, buffer->flags))
-			dma_unmap_sgtable(iovm_map->dev, &iovm_map->table,
-					  DMA_TO_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
-		dma_iova_remove(iovm_map);
+		dma_iova_unmap_remove(iovm_map);
 	}
+	mutex_unlock(&buffer->lock);
 }
 
 #define DMA_MAP_ATTRS_MASK	DMA_ATTR_PRIVILEGED
@@ -96,6 +160,7 @@ static struct dma_iovm_map *dma_find_iovm_map(struct dma_buf_attachment *a)
 {
 	struct samsung_dma_buffer *buffer = a->dmabuf->priv;
 	struct dma_iovm_map *iovm_map;
+	struct iommu_domain *domain;
 	unsigned long attrs;
 
 	if (dma_heap_flags_uncached(buffer->flags)) {
@@ -110,11 +175,11 @@ static struct dma_iovm_map *dma_find_iovm_map(struct dma_buf_attachment *a)
 		a->dma_map_attrs |= (DMA_ATTR_PRIVILEGED | DMA_ATTR_SKIP_CPU_SYNC);
 	}
 	attrs = DMA_MAP_ATTRS(a->dma_map_attrs);
+	domain = iommu_get_domain_for_dev(a->dev);
 
-	list_for_each_entry(iovm_map, &buffer->attachments, list) {
+	hash_for_each_possible(buffer->iovm_hash, iovm_map, node, dma_iovm_key(domain, attrs)) {
 		// device virtual mapping doesn't consider direction currently.
-		if ((iommu_get_domain_for_dev(iovm_map->dev) ==
-		    iommu_get_domain_for_dev(a->dev)) &&
+		if ((iovm_map->domain == domain) &&
 		    (DMA_MAP_ATTRS(iovm_map->attrs) == attrs)) {
 			return iovm_map;
 		}
@@ -133,12 +198,10 @@ static struct dma_iovm_map *dma_put_iovm_map(struct dma_buf_attachment *a)
 		iovm_map->mapcnt--;
 
 		if (!iovm_map->mapcnt && (a->dma_map_attrs & DMA_ATTR_SKIP_LAZY_UNMAP)) {
-			list_del(&iovm_map->list);
-			if (!dma_heap_tzmp_buffer(iovm_map->dev, buffer->flags))
-				dma_unmap_sgtable(iovm_map->dev, &iovm_map->table,
-						  DMA_TO_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
-			dma_iova_remove(iovm_map);
+			dma_iova_unmap_remove(iovm_map);
 			iovm_map = NULL;
+		} else if (!iovm_map->mapcnt) {
+			dma_iova_lru_add(iovm_map);
 		}
 	}
 	mutex_unlock(&buffer->lock);
@@ -156,12 +219,18 @@ static struct dma_iovm_map *dma_get_iovm_map(struct dma_buf_attachment *a,
 	mutex_lock(&buffer->lock);
 	iovm_map = dma_find_iovm_map(a);
 	if (iovm_map) {
-		iovm_map->mapcnt++;
+		if (!iovm_map->mapcnt++) {
+			dma_iova_lru_del(iovm_map);
+			atomic64_inc(&iova_lazy_hit);
+		}
+		atomic64_inc(&iova_hit);
 		mutex_unlock(&buffer->lock);
 		return iovm_map;
 	}
 	mutex_unlock(&buffer->lock);
 
+	atomic64_inc(&iova_miss);
+
 	iovm_map = dma_iova_create(a);
 	if (!iovm_map)
 		return NULL;
@@ -186,12 +255,16 @@ static struct dma_iovm_map *dma_get_iovm_map(struct dma_buf_attachment *a,
 	dup_iovm_map = dma_find_iovm_map(a);
 	if (!dup_iovm_map) {
 		list_add(&iovm_map->list, &buffer->attachments);
+		hash_add(buffer->iovm_hash, &iovm_map->node,
+			 dma_iovm_key(iovm_map->domain, DMA_MAP_ATTRS(iovm_map->attrs)));
 	} else {
 		if (!dma_heap_tzmp_buffer(iovm_map->dev, buffer->flags))
 			dma_unmap_sgtable(iovm_map->dev, &iovm_map->table, direction,
 					  DMA_ATTR_SKIP_CPU_SYNC);
 		dma_iova_remove(iovm_map);
 		iovm_map = dup_iovm_map;
+		if (!iovm_map->mapcnt)
+			dma_iova_lru_del(iovm_map);
 	}
 	iovm_map->mapcnt++;
 	mutex_unlock(&buffer->lock);
@@ -463,6 +536,105 @@ static int samsung_heap_dma_buf_get_flags(struct dma_buf *dmabuf, unsigned long
 	return 0;
 }
 
+static unsigned long iova_shrink_count(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	unsigned long count = READ_ONCE(iova_lru_count);
+
+	return count ? count : SHRINK_EMPTY;
+}
+
+/*
+ * Take the oldest idle mapping whose buffer lock is free and return it
+ * locked, with a reference on its dma-buf so that the buffer outlives the
+ * unlock. A buffer already on its way to release is skipped; release
+ * unmaps it anyway.
+ */
+static struct dma_iovm_map *iova_lru_isolate(void)
+{
+	struct dma_iovm_map *iovm_map, *victim = NULL;
+
+	spin_lock(&iova_lru_lock);
+	list_for_each_entry(iovm_map, &iova_lru, lru) {
+		if (!mutex_trylock(&iovm_map->buffer->lock))
+			continue;
+
+		if (!get_file_rcu(iovm_map->dmabuf->file)) {
+			mutex_unlock(&iovm_map->buffer->lock);
+			continue;
+		}
+
+		victim = iovm_map;
+		list_del_init(&victim->lru);
+		iova_lru_count--;
+		break;
+	}
+	spin_unlock(&iova_lru_lock);
+
+	return victim;
+}
+
+static unsigned long iova_shrink_scan(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct samsung_dma_buffer *buffer;
+	struct dma_iovm_map *iovm_map;
+	struct dma_buf *dmabuf;
+	unsigned long freed = 0;
+
+	while (freed < sc->nr_to_scan) {
+		iovm_map = iova_lru_isolate();
+		if (!iovm_map)
+			break;
+
+		buffer = iovm_map->buffer;
+		dmabuf = iovm_map->dmabuf;
+		dma_iova_unmap_remove(iovm_map);
+		mutex_unlock(&buffer->lock);
+		dma_buf_put(dmabuf);
+
+		atomic64_inc(&iova_evict);
+		freed++;
+	}
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker iova_shrinker = {
+	.count_objects = iova_shrink_count,
+	.scan_objects = iova_shrink_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int iova_stat_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "hit: %lld (lazy: %lld) miss: %lld evict: %lld idle: %lu\n",
+		   atomic64_read(&iova_hit), atomic64_read(&iova_lazy_hit),
+		   atomic64_read(&iova_miss), atomic64_read(&iova_evict),
+		   READ_ONCE(iova_lru_count));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(iova_stat);
+
+int __init samsung_iova_cache_init(void)
+{
+	int ret;
+
+	ret = register_shrinker(&iova_shrinker);
+	if (ret)
+		return ret;
+
+	iova_stat_dentry = debugfs_create_file("samsung_dma_heap_iova", 0444, NULL, NULL,
+					       &iova_stat_fops);
+
+	return 0;
+}
+
+void samsung_iova_cache_exit(void)
+{
+	debugfs_remove(iova_stat_dentry);
+	unregister_shrinker(&iova_shrinker);
+}
+
 const struct dma_buf_ops samsung_dma_buf_ops = {
 	.map_dma_buf = samsung_heap_map_dma_buf,
 	.unmap_dma_buf = samsung_heap_unmap_dma_buf,
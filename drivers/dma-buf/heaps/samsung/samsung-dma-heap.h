@@ -13,6 +13,7 @@
 #include <linux/dma-heap.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
+#include <linux/hashtable.h>
 #include <linux/highmem.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
@@ -45,6 +46,8 @@ unsigned long dma_heap_pool_pages(void);
 struct samsung_dma_buffer {
 	struct samsung_dma_heap *heap;
 	struct list_head attachments;
+	/* index of attachments by iommu domain and map attrs */
+	DECLARE_HASHTABLE(iovm_hash, 3);
 	/* Manage buffer resource of attachments and vaddr, vmap_cnt */
 	struct mutex lock;
 	unsigned long len;
@@ -84,6 +87,8 @@ int samsung_heap_add(struct device *dev, void *priv,
 		     const struct dma_heap_ops *ops);
 struct dma_buf *samsung_export_dmabuf(struct samsung_dma_buffer *buffer, unsigned long fd_flags);
 void samsung_track_buffer_destroyed(struct samsung_dma_buffer *buffer);
+int __init samsung_iova_cache_init(void);
+void samsung_iova_cache_exit(void);
 
 #define DMA_HEAP_VIDEO_PADDING (512)
 #define dma_heap_add_video_padding(len) (PAGE_ALIGN((len) + DMA_HEAP_VIDEO_PADDING))
@@ -107,6 +107,7 @@ struct samsung_dma_buffer *samsung_dma_buffer_alloc(struct samsung_dma_heap *sam
 	}
 
 	INIT_LIST_HEAD(&buffer->attachments);
+	hash_init(buffer->iovm_hash);
 	mutex_init(&buffer->lock);
 	buffer->heap = samsung_dma_heap;
 	buffer->len = size;
@@ -341,10 +342,14 @@ static int __init samsung_dma_heap_init(void)
 {
 	int ret;
 
-	ret = chunk_dma_heap_init();
+	ret = samsung_iova_cache_init();
 	if (ret)
 		return ret;
 
+	ret = chunk_dma_heap_init();
+	if (ret)
+		goto err_chunk;
+
 	ret = cma_dma_heap_init();
 	if (ret)
 		goto err_cma;
@@ -364,6 +369,8 @@ err_carveout:
 	cma_dma_heap_exit();
 err_cma:
 	chunk_dma_heap_exit();
+err_chunk:
+	samsung_iova_cache_exit();
 
 	return ret;
 }
@@ -374,6 +381,7 @@ static void __exit samsung_dma_heap_exit(void)
 	carveout_dma_heap_exit();
 	cma_dma_heap_exit();
 	chunk_dma_heap_exit();
+	samsung_iova_cache_exit();
 }
 
 module_init(samsung_dma_heap_init);
@@ -11,14 +11,20 @@
  *	Andrew F. Davis <afd@ti.com>
  */
 
+#include <linux/debugfs.h>
 #include <linux/dma-buf.h>
 #include <linux/dma-mapping.h>
 #include <linux/dma-heap.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/highmem.h>
+#include <linux/kthread.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/of.h>
@@ -42,28 +48,93 @@ static const unsigned int orders[] = {9, 8, 4, 0};
 #define NUM_ORDERS ARRAY_SIZE(orders)
 struct dmabuf_page_pool *pools[NUM_ORDERS];
 
+/*
+ * Freed pages are zeroed by a low priority kthread before they return to
+ * the pool so that releasing a large buffer does not wait for zeroing.
+ * The backlog is bounded; beyond it pages are zeroed synchronously, and
+ * the shrinker hands backlog pages straight back to the buddy allocator.
+ */
+#define ZERO_BACKLOG_MAX_PAGES	(SZ_32M >> PAGE_SHIFT)
+#define ZERO_BATCH		32
+
+static LIST_HEAD(zero_list);
+static DEFINE_SPINLOCK(zero_lock);
+static unsigned long zero_backlog_pages;
+static DECLARE_WAIT_QUEUE_HEAD(zero_wait);
+static struct task_struct *zero_task;
+static struct dentry *pool_stat_dentry;
+
+/*
+ * High order pools are refilled with zeroed pages by the same kthread
+ * when they drop below the low watermark, up to the high watermark.
+ */
+static unsigned int pool_prefill_low_kb = SZ_4K;
+module_param(pool_prefill_low_kb, uint, 0644);
+static unsigned int pool_prefill_high_kb = SZ_16K;
+module_param(pool_prefill_high_kb, uint, 0644);
+static unsigned long prefill_pending;
+
+static atomic64_t pool_hit[NUM_ORDERS];
+static atomic64_t pool_miss[NUM_ORDERS];
+static atomic64_t prefill_pages[NUM_ORDERS];
+static atomic64_t async_zeroed_pages;
+static atomic64_t sync_zeroed_pages;
+
 unsigned long dma_heap_inuse_pages(void)
 {
 	return atomic64_read(&inuse_pages);
 }
 EXPORT_SYMBOL_GPL(dma_heap_inuse_pages);
 
+static unsigned long pool_count(int pool_idx)
+{
+	return pools[pool_idx]->count[POOL_LOWPAGE] + pools[pool_idx]->count[POOL_HIGHPAGE];
+}
+
+/* pages waiting to be zeroed are counted as pool pages */
 unsigned long dma_heap_pool_pages(void)
 {
 	int i;
-	unsigned long pages = 0;
+	unsigned long pages = READ_ONCE(zero_backlog_pages);
 
 	for (i = 0; i < NUM_ORDERS; i++)
-		pages += (pools[i]->count[POOL_LOWPAGE] +
-			  pools[i]->count[POOL_HIGHPAGE]) << pools[i]->order;
+		pages += pool_count(i) << pools[i]->order;
 	return pages;
 }
 EXPORT_SYMBOL_GPL(dma_heap_pool_pages);
 
+static int order_to_pool_idx(unsigned int order)
+{
+	int pool_idx;
+
+	for (pool_idx = 0; pool_idx < NUM_ORDERS; pool_idx++) {
+		if (order == orders[pool_idx])
+			break;
+	}
+	return pool_idx;
+}
+
+static unsigned long pool_prefill_pages(unsigned int kb, int pool_idx)
+{
+	return ((unsigned long)kb * SZ_1K) >> (PAGE_SHIFT + orders[pool_idx]);
+}
+
+static void request_pool_prefill(int pool_idx)
+{
+	unsigned long low = pool_prefill_pages(READ_ONCE(pool_prefill_low_kb), pool_idx);
+
+	if (!zero_task || !orders[pool_idx] || pool_count(pool_idx) >= low)
+		return;
+
+	if (!test_and_set_bit(pool_idx, &prefill_pending))
+		wake_up(&zero_wait);
+}
+
 static struct page *alloc_largest_available(unsigned long size,
 					    unsigned int max_order)
 {
 	struct page *page;
+	bool pooled;
 	int i;
 
 	for (i = 0; i < NUM_ORDERS; i++) {
@@ -72,15 +143,53 @@ static struct page *alloc_largest_available(unsigned long size,
 		if (max_order < orders[i])
 			continue;
 
+		pooled = !!pool_count(i);
 		page = dmabuf_page_pool_alloc(pools[i]);
 		if (!page)
 			continue;
+		atomic64_inc(pooled ? &pool_hit[i] : &pool_miss[i]);
+		request_pool_prefill(i);
 		dma_heap_inc_inuse(1 << pools[i]->order);
 		return page;
 	}
 	return NULL;
 }
 
+static void zero_and_pool_page(struct page *page)
+{
+	unsigned int order = compound_order(page);
+	int i, numpages = 1 << order;
+
+	for (i = 0; i < numpages; i++)
+		clear_highpage(page + i);
+
+	dmabuf_page_pool_free(pools[order_to_pool_idx(order)], page);
+}
+
+static bool queue_dirty_page(struct page *page)
+{
+	unsigned long numpages = 1UL << compound_order(page);
+	bool was_empty;
+
+	if (!zero_task)
+		return false;
+
+	spin_lock(&zero_lock);
+	if (zero_backlog_pages + numpages > ZERO_BACKLOG_MAX_PAGES) {
+		spin_unlock(&zero_lock);
+		return false;
+	}
+	was_empty = list_empty(&zero_list);
+	list_add_tail(&page->lru, &zero_list);
+	zero_backlog_pages += numpages;
+	spin_unlock(&zero_lock);
+
+	if (was_empty)
+		wake_up(&zero_wait);
+
+	return true;
+}
+
 /*
  * free @page directly without caching it to page pool if @discard is true
  * since it's not likely to be reused since the pool is draining now(e.g.,
@@ -92,22 +201,149 @@ static void free_dma_heap_page(struct page *page, bool discard)
 
 	if (discard) {
 		__free_pages(page, order);
-	} else {
-		int pool_idx;
-		int i, numpages = 1 << order;
+	} else if (!queue_dirty_page(page)) {
+		zero_and_pool_page(page);
+		atomic64_add(1 << order, &sync_zeroed_pages);
+	}
+	dma_heap_dec_inuse(1 << order);
+}
+
+static bool zero_work_pending(void)
+{
+	return !list_empty(&zero_list) || READ_ONCE(prefill_pending);
+}
+
+static void zero_dirty_pages(void)
+{
+	struct page *page;
+	unsigned long numpages;
+	int i;
+
+	for (i = 0; i < ZERO_BATCH; i++) {
+		spin_lock(&zero_lock);
+		page = list_first_entry_or_null(&zero_list, struct page, lru);
+		if (page)
+			list_del(&page->lru);
+		spin_unlock(&zero_lock);
+		if (!page)
+			return;
 
-		for (i = 0; i < numpages; i++)
-			clear_highpage(page + i);
+		numpages = 1UL << compound_order(page);
+		zero_and_pool_page(page);
+		atomic64_add(numpages, &async_zeroed_pages);
 
-		for (pool_idx = 0; pool_idx < NUM_ORDERS; pool_idx++) {
-			if (order == orders[pool_idx])
+		spin_lock(&zero_lock);
+		zero_backlog_pages -= numpages;
+		spin_unlock(&zero_lock);
+	}
+}
+
+static unsigned long zero_backlog_count(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	unsigned long count = READ_ONCE(zero_backlog_pages);
+
+	return count ? count : SHRINK_EMPTY;
+}
+
+/* under memory pressure dirty pages are not worth zeroing for the pool */
+static unsigned long zero_backlog_scan(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct page *page;
+	unsigned long numpages, freed = 0;
+
+	while (freed < sc->nr_to_scan) {
+		page = NULL;
+		spin_lock(&zero_lock);
+		if (!list_empty(&zero_list)) {
+			page = list_last_entry(&zero_list, struct page, lru);
+			list_del(&page->lru);
+			numpages = 1UL << compound_order(page);
+			zero_backlog_pages -= numpages;
+		}
+		spin_unlock(&zero_lock);
+		if (!page)
+			break;
+
+		__free_pages(page, compound_order(page));
+		freed += numpages;
+	}
+
+	return freed ? freed : SHRINK_STOP;
+}
+
+static struct shrinker zero_backlog_shrinker = {
+	.count_objects = zero_backlog_count,
+	.scan_objects = zero_backlog_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static void prefill_pools(void)
+{
+	struct page *page;
+	unsigned long high;
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		if (!test_and_clear_bit(i, &prefill_pending))
+			continue;
+
+		high = pool_prefill_pages(READ_ONCE(pool_prefill_high_kb), i);
+		while (pool_count(i) < high) {
+			/* freed pages are cheaper to pool than new ones; finish later */
+			if (!list_empty(&zero_list) || kthread_should_stop()) {
+				set_bit(i, &prefill_pending);
+				return;
+			}
+
+			/* order_flags has __GFP_ZERO and does not reclaim for high orders */
+			page = alloc_pages(order_flags[i], orders[i]);
+			if (!page)
 				break;
+
+			dmabuf_page_pool_free(pools[i], page);
+			atomic64_inc(&prefill_pages[i]);
 		}
-		dmabuf_page_pool_free(pools[pool_idx], page);
 	}
-	dma_heap_dec_inuse(1 << order);
 }
 
+static int system_heap_zero_thread(void *data)
+{
+	set_freezable();
+	set_user_nice(current, MAX_NICE);
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable(zero_wait, zero_work_pending() || kthread_should_stop());
+
+		zero_dirty_pages();
+		prefill_pools();
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static int system_heap_pool_stat_show(struct seq_file *s, void *unused)
+{
+	u64 hit, miss;
+	int i;
+
+	seq_printf(s, "zero backlog: %lu pages, async zeroed: %lld, sync zeroed: %lld\n",
+		   READ_ONCE(zero_backlog_pages), atomic64_read(&async_zeroed_pages),
+		   atomic64_read(&sync_zeroed_pages));
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		hit = atomic64_read(&pool_hit[i]);
+		miss = atomic64_read(&pool_miss[i]);
+		seq_printf(s, "order %2u: pooled %5lu hit %llu miss %llu hit rate %llu%% prefill %lld\n",
+			   orders[i], pool_count(i), hit, miss,
+			   (hit + miss) ? div64_u64(hit * 100, hit + miss) : 0,
+			   atomic64_read(&prefill_pages[i]));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(system_heap_pool_stat);
+
 static struct dma_buf *system_heap_allocate(struct dma_heap *heap, unsigned long len,
 					    unsigned long fd_flags, unsigned long heap_flags)
 {
@@ -249,10 +485,32 @@ int __init system_dma_heap_init(void)
 		}
 	}
 
+	zero_task = kthread_run(system_heap_zero_thread, NULL, "dma_heap_zero");
+	if (IS_ERR(zero_task)) {
+		pr_warn("%s: zeroing thread creation failed, zero pages on free\n", __func__);
+		zero_task = NULL;
+	} else if (register_shrinker(&zero_backlog_shrinker)) {
+		pr_warn("%s: zero backlog shrinker registration failed\n", __func__);
+	}
+
+	pool_stat_dentry = debugfs_create_file("system_heap_pool", 0444, NULL, NULL,
+					       &system_heap_pool_stat_fops);
+
 	return platform_driver_register(&system_heap_driver);
 }
 
 void system_dma_heap_exit(void)
 {
+	struct task_struct *task = zero_task;
+
 	platform_driver_unregister(&system_heap_driver);
+	debugfs_remove(pool_stat_dentry);
+
+	if (task) {
+		zero_task = NULL;
+		unregister_shrinker(&zero_backlog_shrinker);
+		kthread_stop(task);
+		while (!list_empty(&zero_list))
+			zero_dirty_pages();
+	}
 }
@@ -13,6 +13,7 @@
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/workqueue.h>
 
 #if IS_ENABLED(CONFIG_VIDEO_EXYNOS_REPEATER)
@@ -34,6 +35,18 @@ enum g2d_priority {
 	G2D_PRIORITY_END
 };
 
+/*
+ * Scheduling classes of tasks derived from the priority of their context.
+ * Prepared tasks wait in a queue per class and are pushed to H/W in order of
+ * the deadline given by the queueing time and the latency budget of the class.
+ */
+enum g2d_sched_class {
+	G2D_SCHED_DEADLINE,	/* composition with a frame deadline */
+	G2D_SCHED_UI,
+	G2D_SCHED_BACKGROUND,
+	G2D_SCHED_CLASS_END
+};
+
 /*
  * G2D_DEVICE_STATE_SUSPEND should be treated under g2d_dev->lock_task held
  * because it should be consistent with the state of all tasks attached to
@@ -71,6 +84,22 @@ enum g2d_hw_ppc {
 	PPC_END,
 };
 
+/*
+ * Pixels per 1000 cycles of each entry of hw_ppc measured from completed tasks,
+ * with the mean deviation of the samples in 1/1000 of the estimate. The cycles
+ * predicted by hw_ppc and the measured cycles are accumulated for comparison.
+ * Protected by g2d_device.lock_task.
+ */
+struct g2d_perf_model {
+	u32	ppc[PPC_END];
+	u32	dev[PPC_END];
+	u32	samples[PPC_END];
+	u64	pred_cycles[PPC_END];
+	u64	meas_cycles[PPC_END];
+	/* completion time of the last batch of jobs to find when the next starts */
+	ktime_t	hw_idle;
+};
+
 struct g2d_dvfs_table {
 	u32 lv;
 	u32 freq;
@@ -123,8 +152,18 @@ struct g2d_device {
 	struct g2d_task		*tasks;
 	struct list_head	tasks_free;
 	struct list_head	tasks_free_hwfc;
-	struct list_head	tasks_prepared;
+	struct list_head	tasks_prepared[G2D_SCHED_CLASS_END];
 	struct list_head	tasks_active;
+	/*
+	 * The device keeps power and clock on from the first queued task
+	 * until the last task finishes so that tasks queued back-to-back
+	 * are pushed without toggling them. lock_power serializes the power
+	 * on. powered, nr_queued and nr_active are protected by lock_task.
+	 */
+	struct mutex		lock_power;
+	bool			powered;
+	unsigned int		nr_queued;
+	unsigned int		nr_active;
 	struct kthread_worker	*completion_workq;
 	struct kthread_worker	*schedule_workq;
 
@@ -148,6 +187,7 @@ struct g2d_device {
 #endif
 
 	u32 hw_ppc[PPC_END];
+	struct g2d_perf_model	perf_model;
 	u32				max_layers;
 
 	struct g2d_dvfs_table *dvfs_table;
@@ -167,6 +207,23 @@ struct g2d_device {
 
 #define G2D_AUTHORITY_HIGHUSER 1
 
+/*
+ * Pinned and mapped userptr buffers of a context kept for reuse by later
+ * tasks. Entries leave @lru on LRU eviction or when the user mapping
+ * changes; entries invalidated by the mmu notifier wait in @stale until
+ * their notifier is removed in process context.
+ */
+struct g2d_userptr_cache {
+	spinlock_t		lock; /* protects the lists, count and stats */
+	struct list_head	lru; /* most recently used first */
+	struct list_head	stale;
+	unsigned int		count;
+	unsigned long		hit;
+	unsigned long		miss;
+	unsigned long		evict;
+	unsigned long		invalidate;
+};
+
 struct g2d_context {
 	struct list_head	node;
 	struct g2d_device	*g2d_dev;
@@ -180,6 +237,8 @@ struct g2d_context {
 
 	struct list_head qos_node;
 	struct g2d_qos	ctxqos;
+
+	struct g2d_userptr_cache userptr_cache;
 };
 
 #if !IS_ENABLED(CONFIG_VIDEO_EXYNOS_REPEATER)
@@ -174,6 +174,29 @@ static int g2d_debug_contexts_show(struct seq_file *s, void *unused)
 
 	seq_puts(s, "------------------------------------------------------\n");
 
+	seq_puts(s, "userptr cache:\n");
+	seq_printf(s, "%16s %6s %6s %10s %10s %10s %10s\n",
+		   "task", "pid", "count", "hit", "miss", "evict", "invalidate");
+
+	spin_lock(&g2d_dev->lock_ctx_list);
+
+	list_for_each_entry(ctx, &g2d_dev->ctx_list, node) {
+		struct g2d_userptr_cache *cache = &ctx->userptr_cache;
+
+		task_lock(ctx->owner);
+		spin_lock(&cache->lock);
+		seq_printf(s, "%16s %6u %6u %10lu %10lu %10lu %10lu\n",
+			   ctx->owner->comm, ctx->owner->pid, cache->count,
+			   cache->hit, cache->miss, cache->evict,
+			   cache->invalidate);
+		spin_unlock(&cache->lock);
+		task_unlock(ctx->owner);
+	}
+
+	spin_unlock(&g2d_dev->lock_ctx_list);
+
+	seq_puts(s, "------------------------------------------------------\n");
+
 	seq_puts(s, "priorities:\n");
 	seq_printf(s, "\tlow(0)    : %d\n",
 		   atomic_read(&g2d_dev->prior_stats[G2D_LOW_PRIORITY]));
@@ -230,6 +253,56 @@ static const struct file_operations g2d_debug_tasks_fops = {
 	.release = single_release,
 };
 
+static int g2d_debug_perf_model_show(struct seq_file *s, void *unused)
+{
+	static const char * const fmt_name[PPC_FMT] = {
+		"rgb", "yuv2p", "sbwc", "rgb_afbc", "yuv_afbc",
+	};
+	static const char * const sc_name[PPC_SC] = {
+		"sc_up", "none", "x1", "x1/4", "x1/9", "x1/16",
+	};
+	struct g2d_device *g2d_dev = s->private;
+	struct g2d_perf_model *model = &g2d_dev->perf_model;
+	unsigned int i;
+
+	seq_printf(s, "%9s %4s %6s %6s %8s %6s %8s %14s %14s\n",
+		   "format", "rot", "scale", "ppc", "measured", "dev",
+		   "samples", "pred_cycles", "meas_cycles");
+	seq_puts(s, "------------------------------------------------------\n");
+
+	spin_lock_irq(&g2d_dev->lock_task);
+
+	for (i = 0; i < PPC_END; i++) {
+		if (i == PPC_COLORFILL)
+			seq_printf(s, "%9s %4s %6s ", "colorfill", "-", "-");
+		else
+			seq_printf(s, "%9s %4s %6s ", fmt_name[i / (PPC_ROT * PPC_SC)],
+				   (i / PPC_SC) % PPC_ROT ? "rot" : "-",
+				   sc_name[i % PPC_SC]);
+
+		seq_printf(s, "%6u %8u %6u %8u %14llu %14llu\n",
+			   g2d_dev->hw_ppc[i], model->ppc[i], model->dev[i],
+			   model->samples[i], model->pred_cycles[i],
+			   model->meas_cycles[i]);
+	}
+
+	spin_unlock_irq(&g2d_dev->lock_task);
+
+	return 0;
+}
+
+static int g2d_debug_perf_model_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, g2d_debug_perf_model_show, inode->i_private);
+}
+
+static const struct file_operations g2d_debug_perf_model_fops = {
+	.open = g2d_debug_perf_model_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void g2d_init_debug(struct g2d_device *g2d_dev)
 {
 	g2d_dev->debug_root = debugfs_create_dir("g2d", NULL);
@@ -248,6 +321,9 @@ void g2d_init_debug(struct g2d_device *g2d_dev)
 
 	debugfs_create_file("tasks", 0400, g2d_dev->debug_root,
 			    g2d_dev, &g2d_debug_tasks_fops);
+
+	debugfs_create_file("perf_model", 0400, g2d_dev->debug_root,
+			    g2d_dev, &g2d_debug_perf_model_fops);
 }
 
 void g2d_destroy_debug(struct g2d_device *g2d_dev)
@@ -325,6 +325,8 @@ static int g2d_open(struct inode *inode, struct file *filp)
 
 	INIT_LIST_HEAD(&g2d_ctx->qos_node);
 
+	g2d_userptr_cache_init(&g2d_ctx->userptr_cache);
+
 	return 0;
 }
 
@@ -337,6 +339,8 @@ static int g2d_release(struct inode *inode, struct file *filp)
 
 	g2d_release_hwfc_info(g2d_ctx);
 
+	g2d_userptr_cache_flush(&g2d_ctx->userptr_cache);
+
 	mutex_lock(&g2d_dev->lock_qos);
 
 	list_del_init(&g2d_ctx->qos_node);
@@ -757,7 +761,7 @@ static int g2d_probe(struct platform_device *pdev)
 	struct g2d_device *g2d_dev;
 	struct resource *res;
 	__u32 version;
-	int ret;
+	int i, ret;
 
 	g2d_dev = devm_kzalloc(&pdev->dev, sizeof(*g2d_dev), GFP_KERNEL);
 	if (!g2d_dev)
@@ -805,6 +809,8 @@ static int g2d_probe(struct platform_device *pdev)
 	if (ret < 0)
 		goto err_dt;
 
+	g2d_perf_init_model(g2d_dev);
+
 	of_id = of_match_node(of_g2d_match, pdev->dev.of_node);
 	if (of_id->data) {
 		const struct g2d_device_data *devdata = of_id->data;
@@ -859,12 +865,14 @@ static int g2d_probe(struct platform_device *pdev)
 
 	INIT_LIST_HEAD(&g2d_dev->tasks_free);
 	INIT_LIST_HEAD(&g2d_dev->tasks_free_hwfc);
-	INIT_LIST_HEAD(&g2d_dev->tasks_prepared);
+	for (i = 0; i < G2D_SCHED_CLASS_END; i++)
+		INIT_LIST_HEAD(&g2d_dev->tasks_prepared[i]);
 	INIT_LIST_HEAD(&g2d_dev->tasks_active);
 	INIT_LIST_HEAD(&g2d_dev->qos_contexts);
 	INIT_LIST_HEAD(&g2d_dev->ctx_list);
 
 	mutex_init(&g2d_dev->lock_qos);
+	mutex_init(&g2d_dev->lock_power);
 
 	ret = g2d_create_tasks(g2d_dev);
 	if (ret < 0) {
@@ -5,12 +5,14 @@
  * Contact: Hyesoo Yu <hyesoo.yu@samsung.com>
  */
 
+#include <linux/module.h>
 #include <linux/workqueue.h>
 
 #include "g2d.h"
 #include "g2d_perf.h"
 #include "g2d_task.h"
 #include "g2d_uapi.h"
+#include "g2d_format.h"
 #include "g2d_debug.h"
 #include "g2d_trace.h"
 
@@ -41,12 +43,34 @@ static void g2d_pm_qos_remove_devfreq(struct g2d_device *g2d_dev)
  */
 static u32 perf_basis[PPC_SC] = {1024, 1023, 256, 113, 64, 0};
 
-static char perf_index_sc(struct g2d_performance_layer_data *layer)
+/*
+ * The measured pixels per cycle of an entry of hw_ppc is used for the devfreq
+ * vote after G2D_PERF_MIN_SAMPLES tasks have used the entry. The vote then
+ * has a margin of G2D_PERF_MARGIN plus twice the mean deviation of the
+ * samples instead of the fixed margin for hw_ppc.
+ */
+#define G2D_PERF_MIN_SAMPLES	8
+#define G2D_PERF_MARGIN		100	/* 1/1000 */
+#define G2D_PERF_EWMA_SHIFT	3
+
+static bool perf_use_measured = true;
+module_param(perf_use_measured, bool, 0644);
+
+static unsigned int perf_ppc_index(int fmt, int rot, int sc)
 {
-	u32 ratio = (((u64)layer->window_w * layer->window_h) << 10) /
-			((u32)layer->crop_w * layer->crop_h);
+	return (fmt * PPC_ROT + rot) * PPC_SC + sc;
+}
+
+static char perf_index_sc_area(u32 crop, u32 window)
+{
+	u32 ratio;
 	int i;
 
+	if (!crop)
+		return PPC_NO_SCALE;
+
+	ratio = ((u64)window << 10) / crop;
+
 	for (i = 0; i < PPC_SC; i++) {
 		if (ratio > perf_basis[i])
 			return i;
@@ -55,14 +79,54 @@ static char perf_index_sc(struct g2d_performance_layer_data *layer)
 	return PPC_SC_DOWN_16;
 }
 
+static char perf_index_sc(struct g2d_performance_layer_data *layer)
+{
+	return perf_index_sc_area((u32)layer->crop_w * layer->crop_h,
+				  (u32)layer->window_w * layer->window_h);
+}
+
+static int perf_index_colormode(u32 mode)
+{
+	if (IS_AFBC(mode))
+		return IS_YUV(mode) ? PPC_YUV_AFBC : PPC_RGB_AFBC;
+	if (IS_SBWC(mode))
+		return PPC_SBWC;
+	if (IS_YUV(mode))
+		return PPC_YUV2P;
+
+	return PPC_RGB;
+}
+
+/*
+ * Returns the pixels per 1000 cycles of @idx to predict the cycles. Clears
+ * @measured if the measured value of @idx is not reliable yet, and raises
+ * @margin to the deviation of the measured value.
+ */
+static u32 g2d_perf_ppc(struct g2d_device *g2d_dev, unsigned int idx,
+			bool *measured, u32 *margin)
+{
+	struct g2d_perf_model *model = &g2d_dev->perf_model;
+
+	if (!perf_use_measured ||
+	    READ_ONCE(model->samples[idx]) < G2D_PERF_MIN_SAMPLES) {
+		*measured = false;
+		return g2d_dev->hw_ppc[idx];
+	}
+
+	*margin = max_t(u32, *margin, READ_ONCE(model->dev[idx]));
+
+	return READ_ONCE(model->ppc[idx]);
+}
+
 u32 g2d_calc_device_frequency(struct g2d_device *g2d_dev,
 			      struct g2d_performance_data *data)
 {
 	struct g2d_performance_frame_data *frame;
 	struct g2d_performance_layer_data *layer;
-	u32 (*ppc)[PPC_ROT][PPC_SC] = (u32 (*)[PPC_ROT][PPC_SC])g2d_dev->hw_ppc;
 	u32 frame_rate = 0;
-	unsigned int cycle, ip_clock, crop, window;
+	unsigned int cycle, ip_clock, crop, window, ppc;
+	bool measured = true;
+	u32 margin = 0;
 	int i, j;
 	int sc, fmt, rot;
 
@@ -93,7 +157,12 @@ u32 g2d_calc_device_frequency(struct g2d_device *g2d_dev,
 			if (fmt == PPC_FMT)
 				return 0;
 
-			cycle += max(crop, window) / ppc[fmt][rot][sc];
+			ppc = g2d_perf_ppc(g2d_dev, perf_ppc_index(fmt, rot, sc),
+					   &measured, &margin);
+			if (!ppc)
+				return 0;
+
+			cycle += max(crop, window) / ppc;
 
 			/*
 			 * If frame has colorfill layer on the bottom,
@@ -104,23 +173,27 @@ u32 g2d_calc_device_frequency(struct g2d_device *g2d_dev,
 			if (!j && is_perf_frame_colorfill(frame)) {
 				unsigned int pixelcount;
 				unsigned int colorfill_cycle;
+				u32 cf_ppc;
+
+				cf_ppc = g2d_perf_ppc(g2d_dev, PPC_COLORFILL,
+						      &measured, &margin);
+				if (!cf_ppc)
+					return 0;
 
 				pixelcount = frame->target_pixelcount - window;
 				colorfill_cycle = (pixelcount > 0) ?
-					pixelcount /
-					g2d_dev->hw_ppc[PPC_COLORFILL] : 0;
+					pixelcount / cf_ppc : 0;
 
 				g2d_perf("%d: dst %8d win %8d ppc %4d cycl %8d",
 					 j, frame->target_pixelcount, window,
-					 g2d_dev->hw_ppc[PPC_COLORFILL],
-					 colorfill_cycle);
+					 cf_ppc, colorfill_cycle);
 
 				cycle += colorfill_cycle;
 			}
 
 			g2d_perf("%d: crop %8d window %8d ppc %4d cycle %8d",
 				 is_perf_frame_colorfill(frame) ? j + 1 : j,
-				 crop, window, ppc[fmt][rot][sc], cycle);
+				 crop, window, ppc, cycle);
 		}
 	}
 
@@ -144,8 +217,16 @@ u32 g2d_calc_device_frequency(struct g2d_device *g2d_dev,
 	 *
 	 * Finally, the ip clock is multiplied by 10% weight to ensure
 	 * sufficient performance.
+	 *
+	 * If all layers are predicted by the pixels per cycle measured from
+	 * the completed tasks, the S/W margin and the weight are replaced by
+	 * G2D_PERF_MARGIN and twice the deviation of the measured values.
 	 */
-	ip_clock = (cycle * (frame_rate + 10) * 11) / 10;
+	if (measured)
+		ip_clock = ((u64)cycle * frame_rate *
+			    (1000 + G2D_PERF_MARGIN + 2 * margin)) / 1000;
+	else
+		ip_clock = (cycle * (frame_rate + 10) * 11) / 10;
 
 	for (i = 0; i < g2d_dev->dvfs_table_cnt; i++) {
 		if (ip_clock > g2d_dev->dvfs_table[i].freq) {
@@ -214,3 +295,166 @@ void g2d_update_performance(struct g2d_device *g2d_dev)
 				 &g2d_dev->dwork, msecs_to_jiffies(50));
 	}
 }
+
+void g2d_perf_init_model(struct g2d_device *g2d_dev)
+{
+	struct g2d_perf_model *model = &g2d_dev->perf_model;
+
+	memcpy(model->ppc, g2d_dev->hw_ppc, sizeof(model->ppc));
+}
+
+/*
+ * Records which entries of hw_ppc the layers of @task are processed by.
+ * Called in process context before the task is queued to the scheduler.
+ */
+void g2d_perf_prepare_task(struct g2d_task *task)
+{
+	struct g2d_device *g2d_dev = task->g2d_dev;
+	struct g2d_perf_sample *perf = &task->perf;
+	struct g2d_reg *cmd;
+	u32 crop, window;
+	int i, rot = PPC_NO_ROTATE;
+	unsigned int idx;
+
+	perf->count = 0;
+	perf->freq = (u32)g2d_get_current_freq(g2d_dev->dvfs_int);
+	if (!perf->freq)
+		return;
+
+	for (i = 0; i < task->num_source; i++) {
+		if (task->source[i].commands[G2DSFR_SRC_ROTATE].value & 1) {
+			rot = PPC_ROTATE;
+			break;
+		}
+	}
+
+	for (i = 0; i < task->num_source; i++) {
+		cmd = task->source[i].commands;
+
+		window = (cmd[G2DSFR_SRC_DSTRIGHT].value - cmd[G2DSFR_SRC_DSTLEFT].value) *
+			 (cmd[G2DSFR_SRC_DSTBOTTOM].value - cmd[G2DSFR_SRC_DSTTOP].value);
+
+		if (task->source[i].flags & G2D_LAYERFLAG_COLORFILL) {
+			idx = PPC_COLORFILL;
+			crop = window;
+		} else {
+			crop = (cmd[G2DSFR_IMG_RIGHT].value - cmd[G2DSFR_IMG_LEFT].value) *
+			       (cmd[G2DSFR_IMG_BOTTOM].value - cmd[G2DSFR_IMG_TOP].value);
+			idx = perf_ppc_index(perf_index_colormode(cmd[G2DSFR_IMG_COLORMODE].value),
+					     rot, perf_index_sc_area(crop, window));
+		}
+
+		if (!g2d_dev->hw_ppc[idx])
+			continue;
+
+		perf->idx[perf->count] = idx;
+		perf->pixels[perf->count] = max(crop, window);
+		perf->count++;
+	}
+}
+
+static u64 g2d_perf_predict_cycles(struct g2d_perf_model *model,
+				   struct g2d_perf_sample *perf, u64 *cycles)
+{
+	u64 pred = 0, c;
+	unsigned int i;
+
+	for (i = 0; i < perf->count; i++) {
+		c = div_u64((u64)perf->pixels[i] * 1000, model->ppc[perf->idx[i]]);
+		if (cycles)
+			cycles[i] = c;
+		pred += c;
+	}
+
+	return pred;
+}
+
+/*
+ * Shares the H/W busy time up to now among the active tasks in @intflags.
+ * Tasks completed by the same interrupt ran back to back in H/W and only
+ * the end of the last one is seen, so the interval from the start of the
+ * first one is split in proportion to the cycles predicted for each task.
+ * Called with g2d_dev->lock_task held before the tasks are finished.
+ */
+void g2d_perf_split_busy(struct g2d_device *g2d_dev, unsigned int intflags)
+{
+	struct g2d_perf_model *model = &g2d_dev->perf_model;
+	struct g2d_task *task;
+	ktime_t now = ktime_get(), start = now;
+	u64 pred, total = 0, busy;
+
+	list_for_each_entry(task, &g2d_dev->tasks_active, node) {
+		if (!(intflags & BIT(g2d_task_id(task))))
+			continue;
+
+		task->perf.pred = g2d_perf_predict_cycles(model, &task->perf, NULL);
+		total += task->perf.pred;
+		start = min_t(ktime_t, start, task->ktime_begin);
+	}
+
+	/* a job pushed while H/W is busy starts when the previous job ends */
+	start = max_t(ktime_t, start, model->hw_idle);
+	model->hw_idle = now;
+	busy = ktime_to_ns(ktime_sub(now, start));
+
+	list_for_each_entry(task, &g2d_dev->tasks_active, node) {
+		if (!(intflags & BIT(g2d_task_id(task))))
+			continue;
+
+		pred = task->perf.pred;
+		task->perf.busy_ns = total ? div64_u64(busy * pred, total) : 0;
+	}
+}
+
+/*
+ * Updates the measured pixels per cycle with the time @task took in H/W
+ * as shared by g2d_perf_split_busy(). The measured cycles are distributed
+ * to the layers in proportion to the cycles predicted for them. Called
+ * with g2d_dev->lock_task held.
+ */
+void g2d_perf_update_model(struct g2d_device *g2d_dev, struct g2d_task *task)
+{
+	struct g2d_perf_model *model = &g2d_dev->perf_model;
+	struct g2d_perf_sample *perf = &task->perf;
+	u64 cycles[G2D_MAX_IMAGES];
+	u64 pred, meas, target, err;
+	s64 delta;
+	unsigned int i, idx;
+
+	if (!perf->count)
+		return;
+
+	/* ns * kHz / 10^6 = cycles */
+	meas = div_u64(perf->busy_ns * perf->freq, NSEC_PER_MSEC);
+	if (!meas)
+		return;
+
+	pred = g2d_perf_predict_cycles(model, perf, cycles);
+	if (!pred)
+		return;
+
+	for (i = 0; i < perf->count; i++) {
+		idx = perf->idx[i];
+
+		target = div64_u64((u64)model->ppc[idx] * pred, meas);
+		target = clamp_t(u64, target, g2d_dev->hw_ppc[idx] / 4,
+				 (u64)g2d_dev->hw_ppc[idx] * 4);
+
+		err = abs((s64)target - model->ppc[idx]) * 1000;
+		err = div_u64(err, model->ppc[idx]);
+
+		/* weighted by the share of the layer in the predicted cycles */
+		delta = ((s64)target - model->ppc[idx]) * (s64)cycles[i];
+		delta = div64_s64(delta, (s64)pred << G2D_PERF_EWMA_SHIFT);
+		model->ppc[idx] = max_t(s64, (s64)model->ppc[idx] + delta, 1);
+
+		delta = ((s64)err - model->dev[idx]) * (s64)cycles[i];
+		delta = div64_s64(delta, (s64)pred << G2D_PERF_EWMA_SHIFT);
+		model->dev[idx] = max_t(s64, (s64)model->dev[idx] + delta, 0);
+
+		model->samples[idx]++;
+		model->pred_cycles[idx] += div_u64((u64)perf->pixels[i] * 1000,
+						   g2d_dev->hw_ppc[idx]);
+		model->meas_cycles[idx] += div64_u64(meas * cycles[i], pred);
+	}
+}
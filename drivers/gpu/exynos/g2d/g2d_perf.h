@@ -8,6 +8,7 @@
 
 struct g2d_context;
 struct g2d_performance_data;
+struct g2d_task;
 
 #define perf_index_fmt(layer) \
 		(fls((((layer)->layer_attr) & G2D_PERF_LAYER_FMTMASK) >> 4))
@@ -21,6 +22,10 @@ struct g2d_performance_data;
 u32 g2d_calc_device_frequency(struct g2d_device *g2d_dev,
 			      struct g2d_performance_data *data);
 void g2d_update_performance(struct g2d_device *g2d_dev);
+void g2d_perf_init_model(struct g2d_device *g2d_dev);
+void g2d_perf_prepare_task(struct g2d_task *task);
+void g2d_perf_split_busy(struct g2d_device *g2d_dev, unsigned int intflags);
+void g2d_perf_update_model(struct g2d_device *g2d_dev, struct g2d_task *task);
 
 #if IS_ENABLED(CONFIG_ARM_EXYNOS_DEVFREQ)
 #include <soc/google/exynos-devfreq.h>
@@ -19,8 +19,21 @@
 #include "g2d_fence.h"
 #include "g2d_debug.h"
 #include "g2d_secure.h"
+#include "g2d_perf.h"
 #include "g2d_trace.h"
 
+/* the number of tasks pushed to H/W at once, the rest wait in the scheduler */
+static unsigned int hw_queue_depth = 2;
+module_param(hw_queue_depth, uint, 0644);
+
+/* latency budget from queueing to completion of each scheduling class */
+static unsigned int sched_budget_us[G2D_SCHED_CLASS_END] = {
+	[G2D_SCHED_DEADLINE] = 8000,
+	[G2D_SCHED_UI] = 16000,
+	[G2D_SCHED_BACKGROUND] = 100000,
+};
+module_param_array(sched_budget_us, uint, NULL, 0644);
+
 static void g2d_secure_enable(void)
 {
 	g2d_smc(SMC_PROTECTION_SET, 0, G2D_ALWAYS_S, 1);
@@ -98,9 +111,24 @@ static void __g2d_finish_task(struct g2d_task *task, bool success)
 	kthread_queue_work(task->g2d_dev->completion_workq, &task->completion_work);
 }
 
+/* called with g2d_dev->lock_task held */
+static void g2d_sched_put_power(struct g2d_device *g2d_dev)
+{
+	if (--g2d_dev->nr_queued > 0 || !g2d_dev->powered)
+		return;
+
+	g2d_dev->powered = false;
+
+	clk_disable(g2d_dev->clock);
+
+	pm_runtime_put(g2d_dev->dev);
+}
+
 static void g2d_finish_task(struct g2d_device *g2d_dev,
 			    struct g2d_task *task, bool success)
 {
+	s64 elapsed_us;
+
 	list_del_init(&task->node);
 
 	task->ktime_end = ktime_get();
@@ -110,20 +138,34 @@ static void g2d_finish_task(struct g2d_device *g2d_dev,
 	g2d_stamp_task(task, G2D_STAMP_STATE_DONE,
 		       (int)ktime_us_delta(task->ktime_end, task->ktime_begin));
 
+	if (success)
+		g2d_perf_update_model(g2d_dev, task);
+
+	elapsed_us = ktime_us_delta(task->ktime_end, task->ktime_queued);
+	if (elapsed_us > sched_budget_us[task->sched_class])
+		trace_g2d_sched_deadline_miss(g2d_task_id(task), task->sched_class,
+					      elapsed_us,
+					      sched_budget_us[task->sched_class]);
+
 	g2d_secure_disable();
 
-	clk_disable(g2d_dev->clock);
+	g2d_dev->nr_active--;
 
-	pm_runtime_put(g2d_dev->dev);
+	g2d_sched_put_power(g2d_dev);
 
 	__g2d_finish_task(task, success);
 }
 
+static void g2d_sched_dispatch(struct g2d_device *g2d_dev);
+
 void g2d_finish_tasks(struct g2d_device *g2d_dev,
 		      unsigned int intflags, bool success)
 {
 	struct g2d_task *task, *n;
 
+	if (success)
+		g2d_perf_split_busy(g2d_dev, intflags);
+
 	list_for_each_entry_safe(task, n, &g2d_dev->tasks_active, node) {
 		if (!success || ((intflags & BIT(g2d_task_id(task))) != 0)) {
 			g2d_finish_task(g2d_dev, task, success);
@@ -135,6 +177,9 @@ void g2d_finish_tasks(struct g2d_device *g2d_dev,
 		perrfndev(g2d_dev,
 			  "Found finished jobs (%#x) of inactive tasks",
 			  intflags);
+
+	/* push the waiting tasks while power and clock are still on */
+	g2d_sched_dispatch(g2d_dev);
 }
 
 static void g2d_execute_task(struct g2d_device *g2d_dev, struct g2d_task *task)
@@ -143,6 +188,7 @@ static void g2d_execute_task(struct g2d_device *g2d_dev, struct g2d_task *task)
 
 	list_move_tail(&task->node, &g2d_dev->tasks_active);
 	change_task_state_active(task);
+	g2d_dev->nr_active++;
 
 	task->hw_timer.expires =
 		jiffies + msecs_to_jiffies(G2D_HW_TIMEOUT_MSEC);
@@ -156,6 +202,66 @@ static void g2d_execute_task(struct g2d_device *g2d_dev, struct g2d_task *task)
 	g2d_device_run(g2d_dev, task);
 }
 
+static unsigned int g2d_sched_class(struct g2d_task *task)
+{
+	if (IS_HWFC(task->flags) || task->sec.priority >= G2D_HIGH_PRIORITY)
+		return G2D_SCHED_DEADLINE;
+
+	if (task->sec.priority == G2D_MEDIUM_PRIORITY)
+		return G2D_SCHED_UI;
+
+	return G2D_SCHED_BACKGROUND;
+}
+
+/*
+ * Tasks in a class are served in FIFO order. Among the classes, the head
+ * task with the earliest deadline goes first so that the background class
+ * makes progress under a steady stream of composition.
+ */
+static struct g2d_task *g2d_sched_pick_task(struct g2d_device *g2d_dev)
+{
+	struct g2d_task *task, *next = NULL;
+	ktime_t deadline, earliest = KTIME_MAX;
+	unsigned int i;
+
+	for (i = 0; i < G2D_SCHED_CLASS_END; i++) {
+		task = list_first_entry_or_null(&g2d_dev->tasks_prepared[i],
+						struct g2d_task, node);
+		if (!task)
+			continue;
+
+		deadline = ktime_add_us(task->ktime_queued, sched_budget_us[i]);
+		if (deadline < earliest) {
+			earliest = deadline;
+			next = task;
+		}
+	}
+
+	return next;
+}
+
+/* called with g2d_dev->lock_task held */
+static void g2d_sched_dispatch(struct g2d_device *g2d_dev)
+{
+	unsigned int depth = clamp_val(hw_queue_depth, 1, G2D_MAX_JOBS);
+	struct g2d_task *task;
+
+	if (g2d_dev->state & (1 << G2D_DEVICE_STATE_SUSPEND))
+		return;
+
+	while (g2d_dev->nr_active < depth) {
+		task = g2d_sched_pick_task(g2d_dev);
+		if (!task)
+			break;
+
+		trace_g2d_sched_dispatch(g2d_task_id(task), task->sched_class,
+					 ktime_us_delta(ktime_get(), task->ktime_queued),
+					 g2d_dev->nr_active);
+
+		g2d_execute_task(g2d_dev, task);
+	}
+}
+
 void g2d_prepare_suspend(struct g2d_device *g2d_dev)
 {
 	spin_lock_irq(&g2d_dev->lock_task);
@@ -169,18 +275,12 @@ void g2d_prepare_suspend(struct g2d_device *g2d_dev)
 
 void g2d_suspend_finish(struct g2d_device *g2d_dev)
 {
-	struct g2d_task *task;
-
 	spin_lock_irq(&g2d_dev->lock_task);
 
 	g2d_stamp_task(NULL, G2D_STAMP_STATE_RESUME, 0);
 	clear_bit(G2D_DEVICE_STATE_SUSPEND, &g2d_dev->state);
 
-	while (!list_empty(&g2d_dev->tasks_prepared)) {
-		task = list_first_entry(&g2d_dev->tasks_prepared,
-					struct g2d_task, node);
-		g2d_execute_task(g2d_dev, task);
-	}
+	g2d_sched_dispatch(g2d_dev);
 
 	spin_unlock_irq(&g2d_dev->lock_task);
 	g2d_stamp_task(NULL, G2D_STAMP_STATE_RESUME, 1);
@@ -199,39 +299,55 @@ static void g2d_schedule_task(struct g2d_task *task)
 
 	g2d_complete_commands(task);
 
+	g2d_perf_prepare_task(task);
+
 	/*
-	 * Unconditional invocation of pm_runtime_get_sync() has no side effect
-	 * in g2d_schedule(). It just increases the usage count of RPM if this
-	 * function skips calling g2d_device_run(). The skip only happens when
-	 * there is no task to run in g2d_dev->tasks_prepared.
-	 * If pm_runtime_get_sync() enabled power, there must be a task in
-	 * g2d_dev->tasks_prepared.
+	 * Power and clock are enabled by the first task queued to the idle
+	 * scheduler and disabled by g2d_sched_put_power() when the last
+	 * queued task finishes. lock_power keeps the other schedulers from
+	 * queueing while the power is being enabled.
 	 */
-	ret = pm_runtime_get_sync(g2d_dev->dev);
-	if (ret < 0) {
-		perrfndev(g2d_dev, "Failed to enable power (%d)", ret);
-		goto err_pm;
-	}
+	mutex_lock(&g2d_dev->lock_power);
+
+	spin_lock_irqsave(&g2d_dev->lock_task, flags);
+
+	if (!g2d_dev->powered) {
+		spin_unlock_irqrestore(&g2d_dev->lock_task, flags);
+
+		ret = pm_runtime_get_sync(g2d_dev->dev);
+		if (ret < 0) {
+			perrfndev(g2d_dev, "Failed to enable power (%d)", ret);
+			goto err_pm;
+		}
+
+		ret = clk_enable(g2d_dev->clock);
+		if (ret < 0) {
+			perrfndev(g2d_dev, "Failed to enable clock (%d)", ret);
+			goto err_clk;
+		}
 
-	ret = clk_enable(g2d_dev->clock);
-	if (ret < 0) {
-		perrfndev(g2d_dev, "Failed to enable clock (%d)", ret);
-		goto err_clk;
+		spin_lock_irqsave(&g2d_dev->lock_task, flags);
+		g2d_dev->powered = true;
 	}
 
-	spin_lock_irqsave(&g2d_dev->lock_task, flags);
+	g2d_dev->nr_queued++;
+
+	task->sched_class = g2d_sched_class(task);
+	task->ktime_queued = ktime_get();
 
-	list_add_tail(&task->node, &g2d_dev->tasks_prepared);
+	list_add_tail(&task->node, &g2d_dev->tasks_prepared[task->sched_class]);
 	change_task_state_prepared(task);
 
-	if (!(g2d_dev->state & (1 << G2D_DEVICE_STATE_SUSPEND)))
-		g2d_execute_task(g2d_dev, task);
+	g2d_sched_dispatch(g2d_dev);
 
 	spin_unlock_irqrestore(&g2d_dev->lock_task, flags);
+
+	mutex_unlock(&g2d_dev->lock_power);
 	return;
 err_clk:
 	pm_runtime_put(g2d_dev->dev);
 err_pm:
+	mutex_unlock(&g2d_dev->lock_power);
 err_fence:
 	__g2d_finish_task(task, false);
 }
@@ -299,12 +415,14 @@ static int g2d_queued_task_count(struct g2d_device *g2d_dev)
 {
 	struct g2d_task *task;
 	int num_queued = 0;
+	unsigned int i;
 
 	list_for_each_entry(task, &g2d_dev->tasks_active, node)
 		num_queued++;
 
-	list_for_each_entry(task, &g2d_dev->tasks_prepared, node)
-		num_queued++;
+	for (i = 0; i < G2D_SCHED_CLASS_END; i++)
+		list_for_each_entry(task, &g2d_dev->tasks_prepared[i], node)
+			num_queued++;
 
 	return num_queued;
 }
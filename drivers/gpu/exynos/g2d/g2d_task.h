@@ -33,7 +33,7 @@ struct g2d_buffer_prot_info {
 };
 
 struct page;
-struct frame_vector;
+struct g2d_userptr_entry;
 
 struct g2d_buffer {
 	union {
@@ -44,7 +44,7 @@ struct g2d_buffer {
 		} dmabuf;
 		struct {
 			unsigned long			addr;
-			struct frame_vector		*vec;
+			struct g2d_userptr_entry	*entry;
 		} userptr;
 	};
 	unsigned int	length;
@@ -75,6 +75,18 @@ struct g2d_layer {
 struct g2d_context;
 struct g2d_device;
 
+/* the index to hw_ppc and the pixel count of each layer of a task */
+struct g2d_perf_sample {
+	u16			idx[G2D_MAX_IMAGES];
+	u32			pixels[G2D_MAX_IMAGES];
+	unsigned int		count;
+	/* frequency of the device in kHz when the task is queued */
+	u32			freq;
+	/* predicted cycles and the share of the H/W busy time at completion */
+	u64			pred;
+	u64			busy_ns;
+};
+
 #define IS_HWFC(flags)	(!!((flags) & G2D_FLAG_HWFC))
 
 struct g2d_task {
@@ -109,6 +121,9 @@ struct g2d_task {
 
 	ktime_t			ktime_begin;
 	ktime_t			ktime_end;
+	/* the time the task is queued to the scheduler */
+	ktime_t			ktime_queued;
+	unsigned int		sched_class;
 
 	struct kthread_work	sched_work;
 	struct kthread_work	completion_work;
@@ -126,6 +141,8 @@ struct g2d_task {
 #endif
 	/* inherit device qos when task allocates */
 	struct g2d_qos		taskqos;
+
+	struct g2d_perf_sample	perf;
 };
 
 /* The below functions should be called with g2d_device.lock_tasks held */
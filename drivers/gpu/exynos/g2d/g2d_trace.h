@@ -29,6 +29,48 @@ TRACE_EVENT(g2d_perf_update_qos,
 		__entry->rbw, __entry->wbw, __entry->devfreq)
 );
 
+TRACE_EVENT(g2d_sched_dispatch,
+	TP_PROTO(unsigned int job_id, unsigned int sched_class, s64 queue_us,
+		 unsigned int nr_active),
+	TP_ARGS(job_id, sched_class, queue_us, nr_active),
+	TP_STRUCT__entry(
+		__field(unsigned int, job_id)
+		__field(unsigned int, sched_class)
+		__field(s64, queue_us)
+		__field(unsigned int, nr_active)
+	),
+	TP_fast_assign(
+		__entry->job_id = job_id;
+		__entry->sched_class = sched_class;
+		__entry->queue_us = queue_us;
+		__entry->nr_active = nr_active;
+	),
+	TP_printk("job=%u class=%u queue_us=%lld active=%u",
+		__entry->job_id, __entry->sched_class, __entry->queue_us,
+		__entry->nr_active)
+);
+
+TRACE_EVENT(g2d_sched_deadline_miss,
+	TP_PROTO(unsigned int job_id, unsigned int sched_class, s64 elapsed_us,
+		 unsigned int budget_us),
+	TP_ARGS(job_id, sched_class, elapsed_us, budget_us),
+	TP_STRUCT__entry(
+		__field(unsigned int, job_id)
+		__field(unsigned int, sched_class)
+		__field(s64, elapsed_us)
+		__field(unsigned int, budget_us)
+	),
+	TP_fast_assign(
+		__entry->job_id = job_id;
+		__entry->sched_class = sched_class;
+		__entry->elapsed_us = elapsed_us;
+		__entry->budget_us = budget_us;
+	),
+	TP_printk("job=%u class=%u elapsed_us=%lld budget_us=%u",
+		__entry->job_id, __entry->sched_class, __entry->elapsed_us,
+		__entry->budget_us)
+);
+
 TRACE_EVENT(tracing_mark_write,
 	TP_PROTO(char type, int pid, const char *name, int value),
 	TP_ARGS(type, pid, name, value),
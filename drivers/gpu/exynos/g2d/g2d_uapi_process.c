@@ -4,6 +4,8 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mmu_notifier.h>
 #include <linux/uaccess.h>
 #include <linux/dma-buf.h>
 #include <linux/sync_file.h>
@@ -194,26 +196,123 @@ static int g2d_put_dmabuf(struct g2d_device *g2d_dev, struct g2d_buffer *buffer,
 	return 0;
 }
 
-static int g2d_get_userptr(struct g2d_task *task,
-			   struct g2d_context *ctx,
-			   struct g2d_buffer *buffer,
-			   struct g2d_buffer_data *data,
-			   enum dma_data_direction dir)
+/*
+ * A pinned and DMA-mapped range of a user address space. The userptr cache
+ * holds a reference together with the mmu interval notifier, and each task
+ * using the entry holds another one.
+ */
+struct g2d_userptr_entry {
+	struct kref			kref;
+	struct list_head		node;
+	struct mmu_interval_notifier	notifier;
+	struct g2d_userptr_cache	*cache;
+	struct device			*dev;
+	unsigned long			addr;
+	unsigned int			length;
+	enum dma_data_direction		dir;
+	/* protected by cache->lock */
+	bool				cached; /* linked to cache->lru */
+	bool				stale; /* never cached again */
+	struct frame_vector		*vec;
+	struct sg_table			sgt;
+};
+
+static unsigned int userptr_cache_max = 16;
+module_param(userptr_cache_max, uint, 0644);
+
+static bool g2d_userptr_invalidate(struct mmu_interval_notifier *mni,
+				   const struct mmu_notifier_range *range,
+				   unsigned long cur_seq)
+{
+	struct g2d_userptr_entry *entry =
+		container_of(mni, struct g2d_userptr_entry, notifier);
+	struct g2d_userptr_cache *cache = entry->cache;
+
+	spin_lock(&cache->lock);
+
+	mmu_interval_set_seq(mni, cur_seq);
+
+	entry->stale = true;
+	if (entry->cached) {
+		entry->cached = false;
+		list_move(&entry->node, &cache->stale);
+		cache->count--;
+		cache->invalidate++;
+	}
+
+	spin_unlock(&cache->lock);
+
+	return true;
+}
+
+static const struct mmu_interval_notifier_ops g2d_userptr_notifier_ops = {
+	.invalidate = g2d_userptr_invalidate,
+};
+
+static void g2d_userptr_release(struct kref *kref)
+{
+	struct g2d_userptr_entry *entry =
+		container_of(kref, struct g2d_userptr_entry, kref);
+
+	/* CPU access is synchronized by g2d_put_userptr() */
+	dma_unmap_sg_attrs(entry->dev, entry->sgt.sgl, entry->sgt.orig_nents,
+			   entry->dir, DMA_ATTR_SKIP_CPU_SYNC);
+	sg_free_table(&entry->sgt);
+	put_vaddr_frames(entry->vec);
+	frame_vector_destroy(entry->vec);
+	kfree(entry);
+}
+
+/* drops the reference of the cache to the entries in @list */
+static void g2d_userptr_dispose(struct list_head *list)
+{
+	struct g2d_userptr_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, list, node) {
+		list_del_init(&entry->node);
+		mmu_interval_notifier_remove(&entry->notifier);
+		kref_put(&entry->kref, g2d_userptr_release);
+	}
+}
+
+static struct g2d_userptr_entry *g2d_userptr_pin(struct g2d_userptr_cache *cache,
+						 struct device *dev,
+						 struct g2d_buffer_data *data,
+						 enum dma_data_direction dir)
 {
-	struct device *dev = task->g2d_dev->dev;
 	unsigned long begin = PFN_DOWN(data->userptr);
 	unsigned long end = PFN_UP(data->userptr + data->length);
 	unsigned long page_off = data->userptr & ~PAGE_MASK;
 	unsigned int nr_pages = (unsigned int)(end - begin);
-	struct sg_table *sgt;
+	struct g2d_userptr_entry *entry;
 	struct frame_vector *vec;
 	struct page **pages;
 	int ret = -ENOMEM;
 
-	sgt = kmalloc(sizeof(*sgt), GFP_KERNEL);
-	if (!sgt)
-		return -ENOMEM;
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return ERR_PTR(-ENOMEM);
+
+	kref_init(&entry->kref);
+	INIT_LIST_HEAD(&entry->node);
+	entry->cache = cache;
+	entry->dev = dev;
+	entry->addr = data->userptr;
+	entry->length = data->length;
+	entry->dir = dir;
+
+	/*
+	 * The notifier is registered before pinning so that a change of the
+	 * mapping while pinning marks the entry stale instead of caching it.
+	 */
+	ret = mmu_interval_notifier_insert(&entry->notifier, current->mm,
+					   begin << PAGE_SHIFT,
+					   (unsigned long)nr_pages << PAGE_SHIFT,
+					   &g2d_userptr_notifier_ops);
+	if (ret)
+		goto err_notifier;
 
+	ret = -ENOMEM;
 	vec = frame_vector_create(nr_pages);
 	if (!vec)
 		goto err_vector;
@@ -232,51 +331,183 @@ static int g2d_get_userptr(struct g2d_task *task,
 		goto err_nr_frames;
 	}
 
-	ret = sg_alloc_table_from_pages(sgt, pages, nr_pages, page_off, data->length, 0);
+	ret = sg_alloc_table_from_pages(&entry->sgt, pages, nr_pages, page_off,
+					data->length, 0);
 	if (ret)
 		goto userptr_fail_sgtable;
 
-	sgt->nents = dma_map_sg_attrs(dev, sgt->sgl, sgt->orig_nents, dir, 0);
-	if (!sgt->nents)
+	entry->sgt.nents = dma_map_sg_attrs(dev, entry->sgt.sgl,
+					    entry->sgt.orig_nents, dir, 0);
+	if (!entry->sgt.nents) {
+		ret = -ENOMEM;
 		goto userptr_fail_map;
+	}
 
-	buffer->userptr.addr = data->userptr;
-	buffer->userptr.vec = vec;
-	buffer->dma_addr = sg_dma_address(sgt->sgl);
-	buffer->sgt = sgt;
+	entry->vec = vec;
 
-	return 0;
+	return entry;
 userptr_fail_map:
-	sg_free_table(sgt);
+	sg_free_table(&entry->sgt);
 userptr_fail_sgtable:
 err_nr_frames:
 	put_vaddr_frames(vec);
 err_get_frames:
 	frame_vector_destroy(vec);
 err_vector:
-	kfree(sgt);
-	return ret;
+	mmu_interval_notifier_remove(&entry->notifier);
+err_notifier:
+	kfree(entry);
+	return ERR_PTR(ret);
+}
+
+static struct g2d_userptr_entry *
+g2d_userptr_cache_lookup(struct g2d_userptr_cache *cache,
+			 struct g2d_buffer_data *data, enum dma_data_direction dir,
+			 struct list_head *dispose)
+{
+	struct g2d_userptr_entry *entry, *found = NULL;
+
+	spin_lock(&cache->lock);
+
+	list_for_each_entry(entry, &cache->lru, node) {
+		if (entry->notifier.mm == current->mm &&
+		    entry->addr == data->userptr &&
+		    entry->length == data->length && entry->dir == dir) {
+			list_move(&entry->node, &cache->lru);
+			kref_get(&entry->kref);
+			found = entry;
+			break;
+		}
+	}
+
+	if (found)
+		cache->hit++;
+	else
+		cache->miss++;
+
+	list_splice_init(&cache->stale, dispose);
+
+	spin_unlock(&cache->lock);
+
+	return found;
+}
+
+static void g2d_userptr_cache_add(struct g2d_userptr_cache *cache,
+				  struct g2d_userptr_entry *entry,
+				  struct list_head *dispose)
+{
+	struct g2d_userptr_entry *victim;
+
+	spin_lock(&cache->lock);
+
+	/* the mapping has changed while pinning, the task uses it only once */
+	if (entry->stale) {
+		list_add(&entry->node, dispose);
+	} else {
+		list_add(&entry->node, &cache->lru);
+		entry->cached = true;
+		cache->count++;
+	}
+
+	while (cache->count > userptr_cache_max) {
+		victim = list_last_entry(&cache->lru, struct g2d_userptr_entry, node);
+		victim->cached = false;
+		victim->stale = true;
+		list_move(&victim->node, dispose);
+		cache->count--;
+		cache->evict++;
+	}
+
+	spin_unlock(&cache->lock);
+}
+
+void g2d_userptr_cache_init(struct g2d_userptr_cache *cache)
+{
+	spin_lock_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->lru);
+	INIT_LIST_HEAD(&cache->stale);
+}
+
+/*
+ * Called on the release of the context. Tasks still running keep their
+ * references to the entries and release them on completion.
+ */
+void g2d_userptr_cache_flush(struct g2d_userptr_cache *cache)
+{
+	struct g2d_userptr_entry *entry;
+	LIST_HEAD(dispose);
+
+	spin_lock(&cache->lock);
+
+	list_for_each_entry(entry, &cache->lru, node) {
+		entry->cached = false;
+		entry->stale = true;
+	}
+
+	list_splice_init(&cache->lru, &dispose);
+	list_splice_init(&cache->stale, &dispose);
+	cache->count = 0;
+
+	spin_unlock(&cache->lock);
+
+	g2d_userptr_dispose(&dispose);
+}
+
+static int g2d_get_userptr(struct g2d_task *task,
+			   struct g2d_context *ctx,
+			   struct g2d_buffer *buffer,
+			   struct g2d_buffer_data *data,
+			   enum dma_data_direction dir)
+{
+	struct device *dev = task->g2d_dev->dev;
+	struct g2d_userptr_cache *cache = &ctx->userptr_cache;
+	struct g2d_userptr_entry *entry;
+	LIST_HEAD(dispose);
+
+	entry = g2d_userptr_cache_lookup(cache, data, dir, &dispose);
+
+	g2d_userptr_dispose(&dispose);
+
+	if (entry) {
+		dma_sync_sg_for_device(dev, entry->sgt.sgl, entry->sgt.orig_nents, dir);
+	} else {
+		entry = g2d_userptr_pin(cache, dev, data, dir);
+		if (IS_ERR(entry))
+			return PTR_ERR(entry);
+
+		/* one reference for the cache and one for this task */
+		kref_get(&entry->kref);
+
+		g2d_userptr_cache_add(cache, entry, &dispose);
+		g2d_userptr_dispose(&dispose);
+	}
+
+	buffer->userptr.addr = data->userptr;
+	buffer->userptr.entry = entry;
+	buffer->dma_addr = sg_dma_address(entry->sgt.sgl);
+	buffer->sgt = &entry->sgt;
+
+	return 0;
 }
 
 static int g2d_put_userptr(struct g2d_device *g2d_dev,
 			   struct g2d_buffer *buffer,
 			   enum dma_data_direction dir)
 {
-	dma_unmap_sg_attrs(g2d_dev->dev, buffer->sgt->sgl,
-			   buffer->sgt->orig_nents, dir, 0);
+	struct g2d_userptr_entry *entry = buffer->userptr.entry;
+
+	dma_sync_sg_for_cpu(g2d_dev->dev, entry->sgt.sgl,
+			    entry->sgt.orig_nents, dir);
 
 	if (dir == DMA_FROM_DEVICE || dir == DMA_BIDIRECTIONAL) {
 		struct scatterlist *sg;
 		int i;
 
-		for_each_sg(buffer->sgt->sgl, sg, buffer->sgt->nents, i)
+		for_each_sg(entry->sgt.sgl, sg, entry->sgt.orig_nents, i)
 			set_page_dirty_lock(sg_page(sg));
 	}
 
-	sg_free_table(buffer->sgt);
-	put_vaddr_frames(buffer->userptr.vec);
-	frame_vector_destroy(buffer->userptr.vec);
-	kfree(buffer->sgt);
+	kref_put(&entry->kref, g2d_userptr_release);
 
 	memset(buffer, 0, sizeof(*buffer));
 
@@ -359,9 +590,9 @@ static void g2d_put_image(struct g2d_device *g2d_dev, struct g2d_layer *layer,
 #define IS_DST_SBWC(task) \
 	IS_SBWC((task)->target.commands[G2DSFR_IMG_COLORMODE].value)
 
-static int g2d_get_source(struct g2d_device *g2d_dev, struct g2d_task *task,
-			  struct g2d_layer *layer, struct g2d_layer_data *data,
-			  int index)
+static int g2d_get_source(struct g2d_device *g2d_dev, struct g2d_context *ctx,
+			  struct g2d_task *task, struct g2d_layer *layer,
+			  struct g2d_layer_data *data, int index)
 {
 	int ret;
 
@@ -409,7 +640,7 @@ static int g2d_get_source(struct g2d_device *g2d_dev, struct g2d_task *task,
 		return PTR_ERR(layer->fence);
 	}
 
-	ret = g2d_get_buffer(g2d_dev, NULL, layer, data, DMA_TO_DEVICE);
+	ret = g2d_get_buffer(g2d_dev, ctx, layer, data, DMA_TO_DEVICE);
 	if (ret)
 		goto err_buffer;
 
@@ -431,8 +662,8 @@ err_buffer:
 	return ret;
 }
 
-static int g2d_get_sources(struct g2d_device *g2d_dev, struct g2d_task *task,
-			   struct g2d_layer_data __user *src)
+static int g2d_get_sources(struct g2d_device *g2d_dev, struct g2d_context *ctx,
+			   struct g2d_task *task, struct g2d_layer_data __user *src)
 {
 	unsigned int i;
 	int ret;
@@ -447,7 +678,7 @@ static int g2d_get_sources(struct g2d_device *g2d_dev, struct g2d_task *task,
 			break;
 		}
 
-		ret = g2d_get_source(g2d_dev, task, &task->source[i], &data, i);
+		ret = g2d_get_source(g2d_dev, ctx, task, &task->source[i], &data, i);
 		if (ret)
 			break;
 	}
@@ -606,7 +837,7 @@ int g2d_get_userdata(struct g2d_device *g2d_dev, struct g2d_context *ctx,
 	if (ret)
 		return ret;
 
-	ret = g2d_get_sources(g2d_dev, task, data->source);
+	ret = g2d_get_sources(g2d_dev, ctx, task, data->source);
 	if (ret)
 		goto err_src;
 
@@ -10,10 +10,13 @@
 
 struct g2d_device;
 struct g2d_task;
+struct g2d_userptr_cache;
 
 int g2d_get_userdata(struct g2d_device *g2d_dev, struct g2d_context *ctx,
 		     struct g2d_task *task, struct g2d_task_data *data);
 void g2d_put_images(struct g2d_device *g2d_dev, struct g2d_task *task);
+void g2d_userptr_cache_init(struct g2d_userptr_cache *cache);
+void g2d_userptr_cache_flush(struct g2d_userptr_cache *cache);
 int g2d_wait_put_user(struct g2d_device *g2d_dev, struct g2d_task *task,
 		      struct g2d_task_data __user *uptr, u32 userflag);
 
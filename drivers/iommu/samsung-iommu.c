@@ -5,14 +5,20 @@
 
 #define pr_fmt(fmt) "sysmmu: " fmt
 
+#include <linux/debugfs.h>
 #include <linux/dma-iommu.h>
 #include <linux/kmemleak.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/of_iommu.h>
 #include <linux/of_platform.h>
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
+#include <linux/samsung-iommu.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/version.h>
+#include <linux/workqueue.h>
 
 #include "samsung-iommu.h"
 
@@ -33,6 +39,10 @@
 #define REG_MMU_S2PF_ENABLE	0x7000
 #define MMU_S2PF_ENABLE		BIT(0)
 
+/* pre-zeroed lv2 tables reserved per domain, refilled below the low mark */
+#define LV2POOL_SIZE		16
+#define LV2POOL_LOW		(LV2POOL_SIZE / 2)
+
 static const unsigned int sysmmu_reg_set[MAX_SET_IDX][MAX_REG_IDX] = {
 	/* Default without VM */
 	{
@@ -79,12 +89,24 @@ struct samsung_sysmmu_domain {
 	sysmmu_pte_t *page_table;
 	atomic_t *lv2entcnt;
 	spinlock_t pgtablelock; /* serialize races to page table updates */
+	/* protected by pgtablelock */
+	sysmmu_pte_t *lv2pool[LV2POOL_SIZE];
+	unsigned int lv2pool_cnt;
+	struct work_struct lv2pool_work;
 };
 
 static bool sysmmu_global_init_done;
 static struct device sync_dev;
 static struct kmem_cache *flpt_cache, *slpt_cache;
 
+static struct {
+	atomic64_t hit;
+	atomic64_t miss;
+	atomic64_t alloc_cnt;
+	atomic64_t alloc_ns;
+	atomic64_t alloc_ns_max;
+} lv2pool_stat;
+
 static inline u32 __sysmmu_get_tlb_num(struct sysmmu_drvdata *data)
 {
 	return MMU_CAPA1_NUM_TLB(readl_relaxed(data->sfrbase +
@@ -243,6 +265,32 @@ static inline void pgtable_flush(void *vastart, void *vaend)
 				   (size_t)(vaend - vastart), DMA_TO_DEVICE);
 }
 
+static void samsung_sysmmu_lv2pool_refill(struct work_struct *work)
+{
+	struct samsung_sysmmu_domain *domain =
+		container_of(work, struct samsung_sysmmu_domain, lv2pool_work);
+	unsigned long flags;
+	sysmmu_pte_t *pent;
+
+	while (READ_ONCE(domain->lv2pool_cnt) < LV2POOL_SIZE) {
+		pent = kmem_cache_zalloc(slpt_cache, GFP_KERNEL);
+		if (!pent)
+			break;
+
+		spin_lock_irqsave(&domain->pgtablelock, flags);
+		if (domain->lv2pool_cnt < LV2POOL_SIZE) {
+			domain->lv2pool[domain->lv2pool_cnt++] = pent;
+			pent = NULL;
+		}
+		spin_unlock_irqrestore(&domain->pgtablelock, flags);
+
+		if (pent) {
+			kmem_cache_free(slpt_cache, pent);
+			break;
+		}
+	}
+}
+
 static bool samsung_sysmmu_capable(enum iommu_cap cap)
 {
 	return cap == IOMMU_CAP_CACHE_COHERENCY;
@@ -286,6 +334,9 @@ static struct iommu_domain *samsung_sysmmu_domain_alloc(unsigned int type)
 	pgtable_flush(domain->page_table, domain->page_table + NUM_LV1ENTRIES);
 
 	spin_lock_init(&domain->pgtablelock);
+	INIT_WORK(&domain->lv2pool_work, samsung_sysmmu_lv2pool_refill);
+	if (type != IOMMU_DOMAIN_IDENTITY)
+		queue_work(system_unbound_wq, &domain->lv2pool_work);
 
 	return &domain->domain;
 
@@ -302,6 +353,10 @@ static void samsung_sysmmu_domain_free(struct iommu_domain *dom)
 {
 	struct samsung_sysmmu_domain *domain = to_sysmmu_domain(dom);
 
+	cancel_work_sync(&domain->lv2pool_work);
+	while (domain->lv2pool_cnt)
+		kmem_cache_free(slpt_cache, domain->lv2pool[--domain->lv2pool_cnt]);
+
 	iommu_put_dma_cookie(dom);
 	kmem_cache_free(flpt_cache, domain->page_table);
 	kfree(domain->lv2entcnt);
@@ -520,6 +575,33 @@ static inline sysmmu_pte_t make_sysmmu_pte(phys_addr_t paddr,
 	return ((sysmmu_pte_t)((paddr) >> PG_ENT_SHIFT)) | pgsize | attr;
 }
 
+static void install_lv2table(sysmmu_pte_t *sent, sysmmu_pte_t *pent,
+			     atomic_t *pgcounter)
+{
+	*sent = make_sysmmu_pte(virt_to_phys(pent), SLPD_FLAG, 0);
+	kmemleak_ignore(pent);
+	atomic_set(pgcounter, 0);
+	pgtable_flush(pent, pent + NUM_LV2ENTRIES);
+	pgtable_flush(sent, sent + 1);
+}
+
+static void lv2pool_account_alloc(ktime_t start)
+{
+	s64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	s64 max = atomic64_read(&lv2pool_stat.alloc_ns_max);
+	s64 old;
+
+	atomic64_inc(&lv2pool_stat.alloc_cnt);
+	atomic64_add(ns, &lv2pool_stat.alloc_ns);
+
+	while (ns > max) {
+		old = atomic64_cmpxchg(&lv2pool_stat.alloc_ns_max, max, ns);
+		if (old == max)
+			break;
+		max = old;
+	}
+}
+
 static sysmmu_pte_t *alloc_lv2entry(struct samsung_sysmmu_domain *domain,
 				    sysmmu_pte_t *sent, sysmmu_iova_t iova,
 				    atomic_t *pgcounter)
@@ -530,26 +612,50 @@ static sysmmu_pte_t *alloc_lv2entry(struct samsung_sysmmu_domain *domain,
 	}
 
 	if (lv1ent_unmapped(sent)) {
+		sysmmu_pte_t *pent = NULL;
 		unsigned long flags;
-		sysmmu_pte_t *pent;
+		unsigned int left;
+		ktime_t start;
+
+		spin_lock_irqsave(&domain->pgtablelock, flags);
+		if (lv1ent_unmapped(sent) && domain->lv2pool_cnt) {
+			pent = domain->lv2pool[--domain->lv2pool_cnt];
+			install_lv2table(sent, pent, pgcounter);
+		}
+		left = domain->lv2pool_cnt;
+		spin_unlock_irqrestore(&domain->pgtablelock, flags);
 
+		if (left < LV2POOL_LOW)
+			queue_work(system_unbound_wq, &domain->lv2pool_work);
+
+		if (pent) {
+			atomic64_inc(&lv2pool_stat.hit);
+			return page_entry(sent, iova);
+		}
+
+		if (!lv1ent_unmapped(sent))
+			return page_entry(sent, iova);
+
+		atomic64_inc(&lv2pool_stat.miss);
+		start = ktime_get();
 		pent = kmem_cache_zalloc(slpt_cache, GFP_KERNEL);
+		lv2pool_account_alloc(start);
 		if (!pent)
 			return ERR_PTR(-ENOMEM);
 
 		spin_lock_irqsave(&domain->pgtablelock, flags);
 		if (lv1ent_unmapped(sent)) {
-			*sent = make_sysmmu_pte(virt_to_phys(pent),
-						SLPD_FLAG, 0);
-			kmemleak_ignore(pent);
-			atomic_set(pgcounter, 0);
-			pgtable_flush(pent, pent + NUM_LV2ENTRIES);
-			pgtable_flush(sent, sent + 1);
-		} else {
-			/* allocated entry is not used, so free it. */
-			kmem_cache_free(slpt_cache, pent);
+			install_lv2table(sent, pent, pgcounter);
+			pent = NULL;
+		} else if (domain->lv2pool_cnt < LV2POOL_SIZE) {
+			/* lost the race, keep the table for the next first touch */
+			domain->lv2pool[domain->lv2pool_cnt++] = pent;
+			pent = NULL;
 		}
 		spin_unlock_irqrestore(&domain->pgtablelock, flags);
+
+		if (pent)
+			kmem_cache_free(slpt_cache, pent);
 	}
 
 	return page_entry(sent, iova);
@@ -664,6 +770,116 @@ static int samsung_sysmmu_map(struct iommu_domain *dom, unsigned long l_iova,
 	return ret;
 }
 
+/* ->map_pages() and ->unmap_pages() are only part of iommu_ops from 5.15 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+/*
+ * Fill @pgcount contiguous pages of @pgsize in one lv2 table with a single
+ * cache flush and counter update. On conflict, entries written by this
+ * call are cleared again.
+ */
+static int lv2set_pages(sysmmu_pte_t *pent, phys_addr_t paddr, size_t pgsize,
+			size_t pgcount, int prot, atomic_t *pgcnt)
+{
+	unsigned int attr = !!(prot & IOMMU_CACHE) ? SLPD_SHAREABLE_FLAG : 0;
+	unsigned int nent = pgsize / SPAGE_SIZE;
+	unsigned int flag = (pgsize == SPAGE_SIZE) ? SPAGE_FLAG : LPAGE_FLAG;
+	unsigned int total = pgcount * nent;
+	unsigned int i, j;
+	sysmmu_pte_t pte;
+
+	for (i = 0; i < total; i += nent) {
+		pte = make_sysmmu_pte(paddr + (i / nent) * pgsize, flag, attr);
+
+		for (j = 0; j < nent; j++) {
+			if (WARN_ON(!lv2ent_unmapped(pent + i + j))) {
+				clear_lv2_page_table(pent, i + j);
+				return -EADDRINUSE;
+			}
+
+			pent[i + j] = pte;
+		}
+	}
+	pgtable_flush(pent, pent + total);
+	atomic_add(total, pgcnt);
+
+	return 0;
+}
+
+static int samsung_sysmmu_map_pages(struct iommu_domain *dom, unsigned long l_iova,
+				    phys_addr_t paddr, size_t pgsize, size_t pgcount,
+				    int prot, gfp_t gfp, size_t *mapped)
+{
+	struct samsung_sysmmu_domain *domain = to_sysmmu_domain(dom);
+	sysmmu_iova_t iova = (sysmmu_iova_t)l_iova;
+	sysmmu_pte_t *sent, *pent;
+	atomic_t *lv2entcnt;
+	size_t count;
+	int ret = 0;
+
+	if (pgsize == SECT_SIZE) {
+		for (; pgcount; pgcount--) {
+			ret = samsung_sysmmu_map(dom, iova, paddr, pgsize, prot, gfp);
+			if (ret)
+				return ret;
+
+			iova += pgsize;
+			paddr += pgsize;
+			*mapped += pgsize;
+		}
+		return 0;
+	}
+
+	/* Do not use IO coherency if iOMMU_PRIV exists */
+	if (!!(prot & IOMMU_PRIV))
+		prot &= ~IOMMU_CACHE;
+
+	while (pgcount) {
+		sent = section_entry(domain->page_table, iova);
+		lv2entcnt = &domain->lv2entcnt[lv1ent_offset(iova)];
+
+		pent = alloc_lv2entry(domain, sent, iova, lv2entcnt);
+		if (IS_ERR(pent)) {
+			ret = PTR_ERR(pent);
+			break;
+		}
+
+		/* pages left up to the end of this lv2 table */
+		count = min_t(size_t, pgcount,
+			      (NUM_LV2ENTRIES - lv2ent_offset(iova)) * SPAGE_SIZE / pgsize);
+		ret = lv2set_pages(pent, paddr, pgsize, count, prot, lv2entcnt);
+		if (ret)
+			break;
+
+		iova += count * pgsize;
+		paddr += count * pgsize;
+		pgcount -= count;
+		*mapped += count * pgsize;
+	}
+
+	if (ret)
+		pr_err("failed to map %zu x %#zx @ %#x, ret:%d\n", pgcount, pgsize, iova, ret);
+
+	return ret;
+}
+
+/* the range invalidation of sysmmu does not depend on the page size */
+static void sysmmu_iotlb_gather_add_range(struct iommu_domain *dom,
+					  struct iommu_iotlb_gather *gather,
+					  unsigned long iova, size_t size)
+{
+	unsigned long end = iova + size - 1;
+
+	if (gather->pgsize && (end + 1 < gather->start || iova > gather->end + 1))
+		iommu_iotlb_sync(dom, gather);
+
+	gather->pgsize = SPAGE_SIZE;
+	if (gather->start > iova)
+		gather->start = iova;
+	if (gather->end < end)
+		gather->end = end;
+}
+#endif
+
 static size_t samsung_sysmmu_unmap(struct iommu_domain *dom,
 				   unsigned long l_iova, size_t size,
 				   struct iommu_iotlb_gather *gather)
@@ -734,6 +950,88 @@ err:
 	return 0;
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+/*
+ * Clear a run of lv2 entries of @pgsize within one lv2 table, then flush the
+ * table range and queue one range invalidation. Sections and entries of a
+ * different size are left to samsung_sysmmu_unmap(). The caller loops on a
+ * short return.
+ */
+static size_t samsung_sysmmu_unmap_pages(struct iommu_domain *dom, unsigned long l_iova,
+					 size_t pgsize, size_t pgcount,
+					 struct iommu_iotlb_gather *gather)
+{
+	struct samsung_sysmmu_domain *domain = to_sysmmu_domain(dom);
+	sysmmu_iova_t iova = (sysmmu_iova_t)l_iova;
+	unsigned int nent = pgsize / SPAGE_SIZE;
+	sysmmu_pte_t *sent, *pent;
+	unsigned int cleared = 0;
+	size_t count, i;
+
+	sent = section_entry(domain->page_table, iova);
+	if (pgsize == SECT_SIZE || !lv1ent_page(sent))
+		return samsung_sysmmu_unmap(dom, iova, pgsize, gather);
+
+	pent = page_entry(sent, iova);
+	count = min_t(size_t, pgcount,
+		      (NUM_LV2ENTRIES - lv2ent_offset(iova)) * SPAGE_SIZE / pgsize);
+
+	for (i = 0; i < count; i++, pent += nent) {
+		if (lv2ent_unmapped(pent))
+			continue;
+
+		if ((pgsize == SPAGE_SIZE) != !!lv2ent_small(pent))
+			break;
+
+		clear_lv2_page_table(pent, nent);
+		cleared += nent;
+	}
+
+	if (i == 0)
+		return samsung_sysmmu_unmap(dom, iova, pgsize, gather);
+
+	pgtable_flush(pent - i * nent, pent);
+	atomic_sub(cleared, &domain->lv2entcnt[lv1ent_offset(iova)]);
+	sysmmu_iotlb_gather_add_range(dom, gather, iova, i * pgsize);
+
+	return i * pgsize;
+}
+#endif
+
+/**
+ * samsung_sysmmu_prefault() - populate the lv1 entries covering an IOVA range
+ * @dom: domain owned by this driver
+ * @iova: start of the range
+ * @size: size of the range in bytes
+ *
+ * Installs the lv2 tables for [@iova, @iova + @size) ahead of a large map so
+ * that the map itself does not allocate. 1MiB sections already mapped in the
+ * range are left alone.
+ */
+int samsung_sysmmu_prefault(struct iommu_domain *dom, dma_addr_t iova, size_t size)
+{
+	struct samsung_sysmmu_domain *domain = to_sysmmu_domain(dom);
+	u64 addr, end = (u64)iova + size;
+	sysmmu_pte_t *sent, *pent;
+
+	if (dom->ops != &samsung_sysmmu_ops)
+		return -EINVAL;
+
+	for (addr = iova & SECT_MASK; addr < end; addr += SECT_SIZE) {
+		sent = section_entry(domain->page_table, addr);
+		if (lv1ent_section(sent))
+			continue;
+
+		pent = alloc_lv2entry(domain, sent, addr,
+				      &domain->lv2entcnt[lv1ent_offset(addr)]);
+		if (IS_ERR(pent))
+			return PTR_ERR(pent);
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(samsung_sysmmu_prefault);
+
 static void samsung_sysmmu_flush_iotlb_all(struct iommu_domain *dom)
 {
 	unsigned long flags;
@@ -1176,6 +1474,10 @@ static struct iommu_ops samsung_sysmmu_ops = {
 	.detach_dev		= samsung_sysmmu_detach_dev,
 	.map			= samsung_sysmmu_map,
 	.unmap			= samsung_sysmmu_unmap,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+	.map_pages		= samsung_sysmmu_map_pages,
+	.unmap_pages		= samsung_sysmmu_unmap_pages,
+#endif
 	.flush_iotlb_all	= samsung_sysmmu_flush_iotlb_all,
 	.iotlb_sync		= samsung_sysmmu_iotlb_sync,
 	.iova_to_phys		= samsung_sysmmu_iova_to_phys,
@@ -1330,6 +1632,21 @@ static int sysmmu_parse_dt(struct device *sysmmu, struct sysmmu_drvdata *data)
 	return ret;
 }
 
+static int lv2pool_stat_show(struct seq_file *s, void *unused)
+{
+	s64 cnt = atomic64_read(&lv2pool_stat.alloc_cnt);
+	s64 ns = atomic64_read(&lv2pool_stat.alloc_ns);
+
+	seq_printf(s, "pool hit       : %lld\n", atomic64_read(&lv2pool_stat.hit));
+	seq_printf(s, "pool miss      : %lld\n", atomic64_read(&lv2pool_stat.miss));
+	seq_printf(s, "alloc avg (ns) : %lld\n", cnt ? div64_s64(ns, cnt) : 0);
+	seq_printf(s, "alloc max (ns) : %lld\n",
+		   atomic64_read(&lv2pool_stat.alloc_ns_max));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lv2pool_stat);
+
 static int samsung_sysmmu_init_global(void)
 {
 	int ret = 0;
@@ -1351,6 +1668,8 @@ static int samsung_sysmmu_init_global(void)
 	bus_set_iommu(&platform_bus_type, &samsung_sysmmu_ops);
 
 	device_initialize(&sync_dev);
+	debugfs_create_file("samsung-iommu-lv2pool", 0444, NULL, NULL,
+			    &lv2pool_stat_fops);
 	sysmmu_global_init_done = true;
 
 	return 0;
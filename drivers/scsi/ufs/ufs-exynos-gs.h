@@ -149,12 +149,17 @@ struct exynos_ufs {
 	/* manual_gc */
 	struct ufs_manual_gc manual_gc;
 
-	/* pixel ufs request statistics */
-	struct pixel_req_stats req_stats[REQ_TYPE_MAX];
-	u64 peak_reqs[REQ_TYPE_MAX];
-	u64 peak_queue_depth;
-	/* pixel ufs I/O quatity statistics */
-	struct pixel_io_stats io_stats[IO_TYPE_MAX];
+	/* idle period predictor for hibern8 and manual_gc */
+	struct pixel_idle_pred idle_pred;
+
+	/* pixel ufs request and I/O quatity statistics, folded on read */
+	struct pixel_pcpu_stats __percpu *pcpu_stats;
+	unsigned long stats_gen;
+	/* in-flight read/write amount to track high-water marks */
+	atomic64_t inflight_reqs[IO_TYPE_MAX];
+	atomic64_t inflight_bytes[IO_TYPE_MAX];
+	/* queue depth sampled at issue, per tag */
+	u8 issue_qd[BITS_PER_LONG];
 
 	/* To monitor slow UFS I/O requests. */
 	u64 slowio_min_us;
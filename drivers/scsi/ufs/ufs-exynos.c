@@ -500,6 +500,8 @@ static int exynos_ufs_init(struct ufs_hba *hba)
 
 	pixel_init_manual_gc(hba);
 
+	pixel_init_idle_pred(hba);
+
 	pixel_init_slowio(hba);
 
 	return 0;
@@ -862,8 +864,8 @@ static void exynos_ufs_hibern8_notify(struct ufs_hba *hba,
 			int h8_delay_ms_ovly =
 				ufs->params[UFS_S_PARAM_H8_D_MS];
 
-			/* override h8 enter delay */
-			if (h8_delay_ms_ovly)
+			/* override h8 enter delay unless the idle predictor owns it */
+			if (h8_delay_ms_ovly && !ufs->idle_pred.enabled)
 				hba->clk_gating.delay_ms =
 					(unsigned long)h8_delay_ms_ovly;
 
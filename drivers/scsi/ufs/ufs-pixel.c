@@ -7,6 +7,8 @@
  * Authors: Jaegeuk Kim <jaegeuk@google.com>
  */
 
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "ufs-exynos-gs.h"
 
 #define CREATE_TRACE_POINTS
@@ -68,6 +70,9 @@ static enum pixel_slowio_optype pixel_ufs_get_slowio_optype(u8 opcode)
 	return PIXEL_SLOWIO_OP_MAX;
 }
 
+static void pixel_print_recent_cmd_log(struct ufs_hba *hba, int max_entries);
+static DEFINE_RATELIMIT_STATE(slowio_cmd_log_rs, 60 * HZ, 1);
+
 static void pixel_ufs_log_slowio(struct ufs_hba *hba,
 		struct ufshcd_lrb *lrbp, s64 iotime_us)
 {
@@ -106,6 +111,10 @@ static void pixel_ufs_log_slowio(struct ufs_hba *hba,
 		"Slow UFS (%lld): time = %lld us, opcode = %16s, sector = %ld, "
 		"len = %u\n",
 		slowio_cnt, iotime_us, opcode_str, sector, affected_bytes);
+
+	/* commands around the slow one, merged from all cpus */
+	if (__ratelimit(&slowio_cmd_log_rs))
+		pixel_print_recent_cmd_log(hba, SLOWIO_CMD_ENTRY_NUM);
 }
 
 /* classify request type on statistics by scsi command opcode*/
@@ -143,6 +152,170 @@ static int pixel_ufs_get_cmd_type(struct ufshcd_lrb *lrbp, u8 *cmd_type)
 	return 0;
 }
 
+/* classify request size on latency histogram */
+static inline int pixel_ufs_size_class(u32 affected_bytes)
+{
+	if (affected_bytes <= SZ_4K)
+		return PIXEL_SIZE_4K;
+	if (affected_bytes <= SZ_64K)
+		return PIXEL_SIZE_64K;
+	return PIXEL_SIZE_LARGE;
+}
+
+/* classify queue depth at issue on latency histogram */
+static inline int pixel_ufs_qd_class(u8 qd)
+{
+	if (qd <= 1)
+		return PIXEL_QD_1;
+	if (qd <= 4)
+		return PIXEL_QD_4;
+	if (qd <= 16)
+		return PIXEL_QD_16;
+	return PIXEL_QD_32;
+}
+
+static inline int pixel_ufs_lat_bucket(u64 delta)
+{
+	if (!delta)
+		return 0;
+	return min_t(int, ilog2(delta) + 1, PIXEL_LAT_BUCKETS - 1);
+}
+
+/*
+ * Peaks are reported per trace period. Instead of clearing other cpus' data,
+ * each cpu drops its own peaks once it sees that a new period has started.
+ */
+static inline void pixel_ufs_sync_peak_gen(struct exynos_ufs *ufs,
+		struct pixel_pcpu_stats *pst)
+{
+	unsigned long gen = READ_ONCE(ufs->stats_gen);
+
+	if (pst->peak_gen == gen)
+		return;
+
+	memset(pst->peak_reqs, 0, sizeof(pst->peak_reqs));
+	pst->peak_queue_depth = 0;
+	pst->peak_gen = gen;
+}
+
+/* fold per-cpu statistics together, except histograms */
+static void pixel_ufs_fold_stats(struct exynos_ufs *ufs,
+		struct pixel_stats_snap *snap)
+{
+	unsigned long gen = READ_ONCE(ufs->stats_gen);
+	int cpu, i;
+
+	memset(snap, 0, sizeof(*snap));
+
+	for_each_possible_cpu(cpu) {
+		struct pixel_pcpu_stats *pst = per_cpu_ptr(ufs->pcpu_stats,
+							   cpu);
+		bool peak_valid = READ_ONCE(pst->peak_gen) == gen;
+
+		for (i = 0; i < REQ_TYPE_MAX; i++) {
+			struct pixel_req_stats *rst = &snap->req_stats[i];
+			struct pixel_req_stats *src = &pst->req_stats[i];
+			u64 req_min = READ_ONCE(src->req_min);
+
+			rst->req_count += READ_ONCE(src->req_count);
+			rst->req_sum += READ_ONCE(src->req_sum);
+			if (req_min &&
+			    (!rst->req_min || rst->req_min > req_min))
+				rst->req_min = req_min;
+			rst->req_max = max_t(u64, rst->req_max,
+					READ_ONCE(src->req_max));
+			if (peak_valid)
+				snap->peak_reqs[i] = max_t(u64,
+					snap->peak_reqs[i],
+					READ_ONCE(pst->peak_reqs[i]));
+		}
+		if (peak_valid)
+			snap->peak_queue_depth = max_t(u64,
+					snap->peak_queue_depth,
+					READ_ONCE(pst->peak_queue_depth));
+
+		for (i = 0; i < IO_TYPE_MAX; i++) {
+			struct pixel_io_stats *dst = &snap->io_stats[i];
+			struct pixel_io_stats *src = &pst->io_stats[i];
+
+			dst->req_count_started +=
+				READ_ONCE(src->req_count_started);
+			dst->total_bytes_started +=
+				READ_ONCE(src->total_bytes_started);
+			dst->req_count_completed +=
+				READ_ONCE(src->req_count_completed);
+			dst->total_bytes_completed +=
+				READ_ONCE(src->total_bytes_completed);
+			dst->max_diff_req_count = max_t(u64,
+					dst->max_diff_req_count,
+					READ_ONCE(src->max_diff_req_count));
+			dst->max_diff_total_bytes = max_t(u64,
+					dst->max_diff_total_bytes,
+					READ_ONCE(src->max_diff_total_bytes));
+		}
+	}
+}
+
+/* fold latency histogram of @type over all cpus, size and qd classes */
+static u64 pixel_ufs_fold_hist(struct exynos_ufs *ufs, int type,
+		u64 *hist)
+{
+	u64 total = 0;
+	int cpu, t, size, qd, i;
+
+	memset(hist, 0, sizeof(u64) * PIXEL_LAT_BUCKETS);
+
+	for_each_possible_cpu(cpu) {
+		struct pixel_pcpu_stats *pst = per_cpu_ptr(ufs->pcpu_stats,
+							   cpu);
+
+		for (t = 0; t < REQ_TYPE_MAX; t++) {
+			if (type != REQ_TYPE_VALID && type != t)
+				continue;
+			for (size = 0; size < PIXEL_SIZE_MAX; size++)
+				for (qd = 0; qd < PIXEL_QD_MAX; qd++)
+					for (i = 0; i < PIXEL_LAT_BUCKETS; i++)
+						hist[i] += READ_ONCE(
+						pst->hist[t][size][qd][i]);
+		}
+	}
+
+	for (i = 0; i < PIXEL_LAT_BUCKETS; i++)
+		total += hist[i];
+	return total;
+}
+
+/*
+ * Estimate the request time at @permille of @hist, interpolating linearly in
+ * the bucket. The result is capped by @req_max which is exact.
+ */
+static u64 pixel_ufs_hist_percentile(const u64 *hist, u64 total,
+		unsigned int permille, u64 req_max)
+{
+	u64 rank, seen = 0;
+	int i;
+
+	if (!total)
+		return 0;
+
+	rank = max_t(u64, div_u64(total * permille + 999, 1000), 1);
+	for (i = 0; i < PIXEL_LAT_BUCKETS; i++) {
+		u64 lo, hi;
+
+		if (seen + hist[i] < rank) {
+			seen += hist[i];
+			continue;
+		}
+		if (!i)
+			return 0;
+		lo = 1ULL << (i - 1);
+		hi = (i == PIXEL_LAT_BUCKETS - 1) ? max(req_max, lo) : lo << 1;
+		return min(lo + div64_u64((hi - lo) * (rank - seen), hist[i]),
+				req_max);
+	}
+	return req_max;
+}
+
 /* record_ufs_stats() is following mm/mm_event.c style */
 static const unsigned long period_ms = 3000;
 static unsigned long next_period_ufs_stats;
@@ -155,44 +328,72 @@ static struct pixel_io_stats prev_io_write = { 0, };
 static inline void record_ufs_stats(struct ufs_hba *hba)
 {
 	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	struct pixel_stats_snap snap;
+	unsigned long next = READ_ONCE(next_period_ufs_stats);
 	int i;
 	u64 avg_time[REQ_TYPE_MAX] = { 0, };
 
-	if (time_is_after_jiffies(next_period_ufs_stats))
+	if (time_is_after_jiffies(next))
 		return;
-	next_period_ufs_stats = jiffies + msecs_to_jiffies(period_ms);
+	/* only one cpu closes the period */
+	if (cmpxchg(&next_period_ufs_stats, next,
+			jiffies + msecs_to_jiffies(period_ms)) != next)
+		return;
+
+	if (!trace_ufs_stats_enabled())
+		goto next_gen;
+
+	pixel_ufs_fold_stats(ufs, &snap);
 
 	for (i = 0; i < REQ_TYPE_MAX; i++) {
-		u64 count_diff = ufs->req_stats[i].req_count
+		u64 count_diff = snap.req_stats[i].req_count
 					- pixel_ufs_prev_count[i];
 
 		if (count_diff) {
-			u64 sum_diff = ufs->req_stats[i].req_sum
+			u64 sum_diff = snap.req_stats[i].req_sum
 					- pixel_ufs_prev_sum[i];
 			avg_time[i] = div64_u64(sum_diff, count_diff);
 		}
 	}
 
-	trace_ufs_stats(ufs, &prev_io_read, &prev_io_write, avg_time);
+	trace_ufs_stats(&snap, &prev_io_read, &prev_io_write, avg_time);
 
 	for (i = 0; i < REQ_TYPE_MAX; i++) {
-		ufs->peak_reqs[i] = 0;
-		pixel_ufs_prev_sum[i] = ufs->req_stats[i].req_sum;
-		pixel_ufs_prev_count[i] = ufs->req_stats[i].req_count;
+		pixel_ufs_prev_sum[i] = snap.req_stats[i].req_sum;
+		pixel_ufs_prev_count[i] = snap.req_stats[i].req_count;
 	}
-	ufs->peak_queue_depth = 0;
 
-	memcpy(&prev_io_read, &ufs->io_stats[IO_TYPE_READ],
+	memcpy(&prev_io_read, &snap.io_stats[IO_TYPE_READ],
 			sizeof(struct pixel_io_stats));
-	memcpy(&prev_io_write, &ufs->io_stats[IO_TYPE_WRITE],
+	memcpy(&prev_io_write, &snap.io_stats[IO_TYPE_WRITE],
 			sizeof(struct pixel_io_stats));
+next_gen:
+	/* reset peaks of all cpus */
+	WRITE_ONCE(ufs->stats_gen, ufs->stats_gen + 1);
+}
+
+static inline void __update_req_stats(struct pixel_pcpu_stats *pst,
+		u8 cmd_type, u64 delta)
+{
+	struct pixel_req_stats *rst = &pst->req_stats[cmd_type];
+
+	rst->req_count++;
+	rst->req_sum += delta;
+	if (rst->req_min == 0 || rst->req_min > delta)
+		rst->req_min = delta;
+	if (rst->req_max < delta)
+		rst->req_max = delta;
+	if (delta > pst->peak_reqs[cmd_type])
+		pst->peak_reqs[cmd_type] = delta;
 }
 
 void pixel_ufs_update_req_stats(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
 {
 	struct exynos_ufs *ufs = to_exynos_ufs(hba);
-	struct pixel_req_stats *rst;
+	struct pixel_pcpu_stats *pst;
+	unsigned long flags;
 	u8 cmd_type;
+	int size, qd;
 	u64 delta = (u64)ktime_us_delta(lrbp->compl_time_stamp,
 		lrbp->issue_time_stamp);
 
@@ -202,50 +403,44 @@ void pixel_ufs_update_req_stats(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
 	if (pixel_ufs_get_cmd_type(lrbp, &cmd_type))
 		return;
 
-	/* Update request statistic if need */
-	rst = &(ufs->req_stats[REQ_TYPE_VALID]);
-	rst->req_count++;
-	rst->req_sum += delta;
-	if (rst->req_min == 0 || rst->req_min > delta)
-		rst->req_min = delta;
-	if (rst->req_max < delta)
-		rst->req_max = delta;
-	if (delta > ufs->peak_reqs[REQ_TYPE_VALID])
-		ufs->peak_reqs[REQ_TYPE_VALID] = delta;
+	size = pixel_ufs_size_class(blk_rq_bytes(scsi_cmd_to_rq(lrbp->cmd)));
+	qd = pixel_ufs_qd_class(ufs->issue_qd[lrbp->task_tag]);
 
-	rst = &(ufs->req_stats[cmd_type]);
-	rst->req_count++;
-	rst->req_sum += delta;
-	if (rst->req_min == 0 || rst->req_min > delta)
-		rst->req_min = delta;
-	if (rst->req_max < delta)
-		rst->req_max = delta;
-	if (delta > ufs->peak_reqs[cmd_type])
-		ufs->peak_reqs[cmd_type] = delta;
+	/* Update request statistic if need */
+	local_irq_save(flags);
+	pst = this_cpu_ptr(ufs->pcpu_stats);
+	pixel_ufs_sync_peak_gen(ufs, pst);
+	__update_req_stats(pst, REQ_TYPE_VALID, delta);
+	__update_req_stats(pst, cmd_type, delta);
+	pst->hist[cmd_type][size][qd][pixel_ufs_lat_bucket(delta)]++;
+	local_irq_restore(flags);
 
 	record_ufs_stats(hba);
 }
 
-static void __update_io_stats(struct ufs_hba *hba,
-		struct pixel_io_stats *io_stats, u32 affected_bytes,
+static void __update_io_stats(struct exynos_ufs *ufs,
+		struct pixel_pcpu_stats *pst, int io_type, u32 affected_bytes,
 		bool is_start)
 {
+	struct pixel_io_stats *io_stats = &pst->io_stats[io_type];
+
 	if (is_start) {
-		u64 diff;
+		s64 diff;
 
 		io_stats->req_count_started++;
 		io_stats->total_bytes_started += affected_bytes;
-		diff = io_stats->req_count_started -
-			io_stats->req_count_completed;
-		if (diff > io_stats->max_diff_req_count)
+		diff = atomic64_inc_return(&ufs->inflight_reqs[io_type]);
+		if (diff > (s64)io_stats->max_diff_req_count)
 			io_stats->max_diff_req_count = diff;
-		diff = io_stats->total_bytes_started -
-			io_stats->total_bytes_completed;
-		if (diff > io_stats->max_diff_total_bytes)
+		diff = atomic64_add_return(affected_bytes,
+				&ufs->inflight_bytes[io_type]);
+		if (diff > (s64)io_stats->max_diff_total_bytes)
 			io_stats->max_diff_total_bytes = diff;
 	} else {
 		io_stats->req_count_completed++;
 		io_stats->total_bytes_completed += affected_bytes;
+		atomic64_dec(&ufs->inflight_reqs[io_type]);
+		atomic64_sub(affected_bytes, &ufs->inflight_bytes[io_type]);
 	}
 }
 
@@ -253,30 +448,39 @@ static void pixel_ufs_update_io_stats(struct ufs_hba *hba,
 		struct ufshcd_lrb *lrbp, bool is_start)
 {
 	struct exynos_ufs *ufs = to_exynos_ufs(hba);
-	struct pixel_io_stats *ist;
+	struct pixel_pcpu_stats *pst;
+	unsigned long flags;
 	u32 affected_bytes;
 	u8 cmd_type;
-	u64 inflight_req;
+	s64 inflight_req;
 
 	if (pixel_ufs_get_cmd_type(lrbp, &cmd_type))
 		return;
 
+	/* sample queue depth including this request for the histogram */
+	if (is_start)
+		ufs->issue_qd[lrbp->task_tag] = min_t(unsigned int, U8_MAX,
+			hweight_long(READ_ONCE(hba->outstanding_reqs) |
+				     BIT(lrbp->task_tag)));
+
 	if (cmd_type != REQ_TYPE_READ && cmd_type != REQ_TYPE_WRITE)
 		return;
 
 	affected_bytes = blk_rq_bytes(scsi_cmd_to_rq(lrbp->cmd));
 
 	/* Upload I/O amount on statistic */
-	ist = &(ufs->io_stats[IO_TYPE_READ_WRITE]);
-	__update_io_stats(hba, ist, affected_bytes, is_start);
-	ist = &(ufs->io_stats[(cmd_type == REQ_TYPE_READ) ?
-			IO_TYPE_READ : IO_TYPE_WRITE]);
-	__update_io_stats(hba, ist, affected_bytes, is_start);
-
-	inflight_req = ufs->io_stats[IO_TYPE_READ_WRITE].req_count_started
-			- ufs->io_stats[IO_TYPE_READ_WRITE].req_count_completed;
-	if (inflight_req > ufs->peak_queue_depth)
-		ufs->peak_queue_depth = inflight_req;
+	local_irq_save(flags);
+	pst = this_cpu_ptr(ufs->pcpu_stats);
+	pixel_ufs_sync_peak_gen(ufs, pst);
+	__update_io_stats(ufs, pst, IO_TYPE_READ_WRITE, affected_bytes,
+			is_start);
+	__update_io_stats(ufs, pst, (cmd_type == REQ_TYPE_READ) ?
+			IO_TYPE_READ : IO_TYPE_WRITE, affected_bytes, is_start);
+
+	inflight_req = atomic64_read(&ufs->inflight_reqs[IO_TYPE_READ_WRITE]);
+	if (inflight_req > (s64)pst->peak_queue_depth)
+		pst->peak_queue_depth = inflight_req;
+	local_irq_restore(flags);
 
 	record_ufs_stats(hba);
 }
@@ -309,9 +513,8 @@ static int pixel_ufs_init_cmd_log(struct ufs_hba *hba)
 
 	memset(&ufs->cmd_log, 0, sizeof(struct pixel_cmd_log));
 
-	ufs->cmd_log.entry = devm_kcalloc(ufs->dev, MAX_CMD_ENTRY_NUM,
-					  sizeof(struct pixel_cmd_log_entry),
-					  GFP_KERNEL);
+	ufs->cmd_log.ring = devm_alloc_percpu(ufs->dev,
+					      struct pixel_cmd_log_ring);
 	for (i = 0; i < EVENT_TYPE_MAX; i++)
 		ufs->cmd_log.event_str[i] = devm_kzalloc(ufs->dev,
 							    MAX_EVENT_STR_LEN,
@@ -400,23 +603,6 @@ static int pixel_ufs_init_cmd_log(struct ufs_hba *hba)
 	return 0;
 }
 
-static struct pixel_cmd_log_entry *__get_log_entry(struct ufs_hba *hba)
-{
-	struct exynos_ufs *ufs = to_exynos_ufs(hba);
-	struct pixel_cmd_log_entry *entry = NULL;
-
-	if (!virt_addr_valid(ufs->cmd_log.entry))
-		return entry;
-
-	ufs->cmd_log.seq_cnt++;
-	ufs->cmd_log.head = (ufs->cmd_log.head + 1) % MAX_CMD_ENTRY_NUM;
-	entry = &ufs->cmd_log.entry[ufs->cmd_log.head];
-	memset(entry, 0, sizeof(struct pixel_cmd_log_entry));
-	entry->seq_num = ufs->cmd_log.seq_cnt;
-
-	return entry;
-}
-
 static void __set_cmd_log_str(struct ufs_hba *hba, u8 event, u8 opcode,
 		struct pixel_cmd_log_entry *entry)
 {
@@ -486,14 +672,25 @@ static void __store_cmd_log(struct ufs_hba *hba, u8 event, u8 lun,
 		u8 group_id, int tag, u64 error, u8 queue_eh_work)
 {
 	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	struct pixel_cmd_log_ring *ring;
 	struct pixel_cmd_log_entry *entry;
+	unsigned long flags;
+	u32 seq;
 
-	if (!ufs->enable_cmd_log)
+	if (!ufs->enable_cmd_log || !ufs->cmd_log.ring ||
+	    event >= EVENT_TYPE_MAX)
 		return;
 
-	entry = __get_log_entry(hba);
-	if (!entry || event >= EVENT_TYPE_MAX)
-		return;
+	local_irq_save(flags);
+	ring = this_cpu_ptr(ufs->cmd_log.ring);
+	seq = ++ring->seq;
+	if (unlikely(!seq))
+		seq = ++ring->seq;
+	entry = &ring->entry[seq % MAX_CMD_ENTRY_NUM];
+
+	/* invalidate the entry for readers while it is being rewritten */
+	WRITE_ONCE(entry->seq_num, 0);
+	smp_wmb();
 
 	__set_cmd_log_str(hba, event, opcode, entry);
 	entry->tstamp = ktime_get();
@@ -508,6 +705,127 @@ static void __store_cmd_log(struct ufs_hba *hba, u8 event, u8 lun,
 	entry->group_id = group_id;
 	entry->error = error;
 	entry->queue_eh_work = queue_eh_work;
+
+	smp_wmb();
+	WRITE_ONCE(entry->seq_num, seq);
+	local_irq_restore(flags);
+}
+
+/* copy out the entry written at @seq, if it is still there */
+static bool pixel_cmd_log_read(struct pixel_cmd_log_ring *ring, u32 seq,
+		struct pixel_cmd_log_entry *out)
+{
+	struct pixel_cmd_log_entry *entry;
+
+	if (!seq)
+		return false;
+
+	entry = &ring->entry[seq % MAX_CMD_ENTRY_NUM];
+	if (READ_ONCE(entry->seq_num) != seq)
+		return false;
+	smp_rmb();
+	memcpy(out, entry, sizeof(*out));
+	smp_rmb();
+	return READ_ONCE(entry->seq_num) == seq;
+}
+
+/* the oldest sequence still kept in a ring which was written up to @seq */
+static inline u32 pixel_cmd_log_floor(u32 seq)
+{
+	return seq > MAX_CMD_ENTRY_NUM ? seq - MAX_CMD_ENTRY_NUM : 0;
+}
+
+/*
+ * Walk the latest @max_entries of all per-cpu rings in time order. The
+ * rings are merged by timestamp here, so producers never share anything.
+ */
+static void pixel_walk_cmd_log(struct ufs_hba *hba, int max_entries,
+		void (*fn)(struct ufs_hba *hba, int cpu,
+			   struct pixel_cmd_log_entry *entry, void *priv),
+		void *priv)
+{
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	struct pixel_cmd_log_entry entry;
+	struct pixel_cmd_log_entry best_entry = { 0, };
+	u32 *cur, *end;
+	int cpu, best, n;
+	ktime_t best_t = 0;
+
+	if (!ufs->enable_cmd_log || !ufs->cmd_log.ring)
+		return;
+
+	cur = kcalloc(nr_cpu_ids * 2, sizeof(u32), GFP_ATOMIC);
+	if (!cur)
+		return;
+	end = cur + nr_cpu_ids;
+
+	for_each_possible_cpu(cpu) {
+		end[cpu] = READ_ONCE(per_cpu_ptr(ufs->cmd_log.ring, cpu)->seq);
+		cur[cpu] = end[cpu];
+	}
+
+	/* step back from the newest entries to find where to start */
+	for (n = 0; n < max_entries; n++) {
+		best = -1;
+		for_each_possible_cpu(cpu) {
+			struct pixel_cmd_log_ring *ring =
+				per_cpu_ptr(ufs->cmd_log.ring, cpu);
+			u32 floor = pixel_cmd_log_floor(end[cpu]);
+
+			while (cur[cpu] > floor &&
+			       !pixel_cmd_log_read(ring, cur[cpu], &entry))
+				cur[cpu]--;
+			if (cur[cpu] <= floor)
+				continue;
+			if (best < 0 || ktime_after(entry.tstamp, best_t)) {
+				best = cpu;
+				best_t = entry.tstamp;
+			}
+		}
+		if (best < 0)
+			break;
+		cur[best]--;
+	}
+
+	/* then replay them from the oldest one */
+	for_each_possible_cpu(cpu)
+		cur[cpu]++;
+
+	for (;;) {
+		best = -1;
+		for_each_possible_cpu(cpu) {
+			struct pixel_cmd_log_ring *ring =
+				per_cpu_ptr(ufs->cmd_log.ring, cpu);
+
+			while (cur[cpu] <= end[cpu] &&
+			       !pixel_cmd_log_read(ring, cur[cpu], &entry))
+				cur[cpu]++;
+			if (cur[cpu] > end[cpu])
+				continue;
+			if (best < 0 || ktime_before(entry.tstamp, best_t)) {
+				best = cpu;
+				best_t = entry.tstamp;
+				best_entry = entry;
+			}
+		}
+		if (best < 0)
+			break;
+		cur[best]++;
+		fn(hba, best, &best_entry, priv);
+	}
+
+	kfree(cur);
+}
+
+static void pixel_print_cmd_log_entry(struct ufs_hba *hba, int cpu,
+		struct pixel_cmd_log_entry *entry, void *priv)
+{
+	dev_err(hba->dev, "%d/%u: %s tag: %d cmd: %s sector: %llu len: 0x%x DB: 0x%llx outstanding: 0x%llx GID: 0x%x\n",
+		cpu, entry->seq_num, entry->event,
+		entry->tag, entry->cmd,
+		(u64)entry->sector, entry->affected_bytes,
+		entry->doorbell, entry->outstanding_reqs,
+		entry->group_id);
 }
 
 static void pixel_ufs_trace_upiu_cmd(struct ufs_hba *hba,
@@ -600,9 +918,225 @@ static void pixel_ufs_check_int_errors(void *data, struct ufs_hba *hba,
 			queue_eh_work);
 }
 
+/*
+ * Typical idle period among the recent ones, following the outlier
+ * rejection of the cpuidle menu governor. Returns 0 if the recent periods
+ * are too scattered to tell.
+ */
+static u64 pixel_idle_typical_us(struct pixel_idle_pred *pred)
+{
+	u64 thresh = U64_MAX;
+	u64 avg, variance, max;
+	int divisor, i;
+
+again:
+	avg = 0;
+	max = 0;
+	divisor = 0;
+	for (i = 0; i < PIXEL_IDLE_INTERVALS; i++) {
+		u64 value = pred->intervals[i];
+
+		if (!value || value > thresh)
+			continue;
+		avg += value;
+		max = max(max, value);
+		divisor++;
+	}
+
+	if (divisor * 4 < PIXEL_IDLE_INTERVALS * 3)
+		return 0;
+	avg = div_u64(avg, divisor);
+
+	variance = 0;
+	for (i = 0; i < PIXEL_IDLE_INTERVALS; i++) {
+		u64 value = pred->intervals[i];
+		s64 diff;
+
+		if (!value || value > thresh)
+			continue;
+		diff = value - avg;
+		variance += diff * diff;
+	}
+	variance = div_u64(variance, divisor);
+
+	/* stddev is less than 1/6 of average or 20us */
+	if (avg * avg > variance * 36 || variance <= 400)
+		return avg;
+
+	/* drop the largest one and try again */
+	thresh = max - 1;
+	goto again;
+}
+
+/* called when the first command arrives after an idle period */
+static void pixel_idle_pred_end(struct ufs_hba *hba)
+{
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	struct pixel_idle_pred *pred = &ufs->idle_pred;
+	unsigned long flags;
+	bool long_pred, long_idle;
+	u64 idle_us;
+
+	spin_lock_irqsave(&pred->lock, flags);
+	if (!pred->idle_start) {
+		spin_unlock_irqrestore(&pred->lock, flags);
+		return;
+	}
+
+	idle_us = ktime_us_delta(ktime_get(), pred->idle_start);
+	pred->idle_start = 0;
+	pred->intervals[pred->next] = clamp_t(u64, idle_us, 1,
+						PIXEL_IDLE_MAX_US);
+	pred->next = (pred->next + 1) % PIXEL_IDLE_INTERVALS;
+
+	long_pred = pred->predicted_us >= pred->h8_breakeven_us;
+	long_idle = idle_us >= pred->h8_breakeven_us;
+	if (long_pred == long_idle)
+		pred->hit++;
+	else if (long_pred)
+		pred->miss_wake++;
+	else
+		pred->miss_idle++;
+
+	pred->idle_total_us += idle_us;
+	if (long_pred)
+		pred->idle_fast_us += idle_us;
+	spin_unlock_irqrestore(&pred->lock, flags);
+}
+
+/*
+ * called when the last outstanding command completes, from the transfer
+ * completion path which holds host_lock like every other clk_gating writer
+ */
+static void pixel_idle_pred_start(struct ufs_hba *hba)
+{
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	struct pixel_idle_pred *pred = &ufs->idle_pred;
+	struct ufs_manual_gc *mgc = &ufs->manual_gc;
+	unsigned long flags;
+
+	lockdep_assert_held(hba->host->host_lock);
+
+	spin_lock_irqsave(&pred->lock, flags);
+	pred->idle_start = ktime_get();
+	pred->predicted_us = pixel_idle_typical_us(pred);
+
+	if (!pred->enabled)
+		goto out;
+
+	/*
+	 * Gate the clocks, which puts the link into hibern8, soon only if
+	 * this idle period is expected to pay back the enter/exit cost. The
+	 * predictor owns the delay while enabled, so the driver param only
+	 * seeds the delay used otherwise and is not re-applied on H8 exit.
+	 */
+	if (!pred->h8_delay_ms)
+		pred->h8_delay_ms = ufs->params[UFS_S_PARAM_H8_D_MS] ?:
+				    hba->clk_gating.delay_ms;
+	hba->clk_gating.delay_ms =
+		pred->predicted_us >= pred->h8_breakeven_us ?
+		pred->h8_fast_delay_ms : pred->h8_delay_ms;
+
+	/* issue deferred manual gc if its window fits in this idle period */
+	if (mgc->pending &&
+	    (!pred->predicted_us ||
+	     pred->predicted_us >= (u64)mgc->delay_ms * USEC_PER_MSEC)) {
+		mgc->pending = false;
+		del_timer(&mgc->defer_timer);
+		queue_work(mgc->mgc_workq, &mgc->issue_work);
+	}
+out:
+	spin_unlock_irqrestore(&pred->lock, flags);
+}
+
+/*
+ * Returns true if manual gc on should wait for an idle period which is
+ * expected to be long enough for its hold window.
+ */
+static bool pixel_idle_pred_defer_gc(struct ufs_hba *hba)
+{
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	struct pixel_idle_pred *pred = &ufs->idle_pred;
+	struct ufs_manual_gc *mgc = &ufs->manual_gc;
+	unsigned long flags;
+	bool defer = false;
+
+	spin_lock_irqsave(&pred->lock, flags);
+	if (!pred->enabled)
+		goto out;
+
+	if (pred->idle_start) {
+		u64 idle_us = ktime_us_delta(ktime_get(), pred->idle_start);
+
+		/* nothing to predict, or enough idle time is left */
+		if (!pred->predicted_us ||
+		    pred->predicted_us >= idle_us +
+				(u64)mgc->delay_ms * USEC_PER_MSEC)
+			goto out;
+	}
+
+	if (!mgc->pending) {
+		mgc->pending = true;
+		mod_timer(&mgc->defer_timer, jiffies +
+			  msecs_to_jiffies(UFSHCD_MANUAL_GC_MAX_DEFER));
+		pred->gc_deferred++;
+	}
+	defer = true;
+out:
+	spin_unlock_irqrestore(&pred->lock, flags);
+	return defer;
+}
+
+static void pixel_idle_pred_cancel_gc(struct ufs_hba *hba)
+{
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ufs->idle_pred.lock, flags);
+	ufs->manual_gc.pending = false;
+	del_timer(&ufs->manual_gc.defer_timer);
+	spin_unlock_irqrestore(&ufs->idle_pred.lock, flags);
+}
+
+/* a deferred manual gc is issued anyway after UFSHCD_MANUAL_GC_MAX_DEFER */
+static void pixel_idle_pred_defer_timeout(struct timer_list *t)
+{
+	struct exynos_ufs *ufs = from_timer(ufs, t, manual_gc.defer_timer);
+	struct ufs_manual_gc *mgc = &ufs->manual_gc;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ufs->idle_pred.lock, flags);
+	if (mgc->pending) {
+		mgc->pending = false;
+		ufs->idle_pred.gc_forced++;
+		queue_work(mgc->mgc_workq, &mgc->issue_work);
+	}
+	spin_unlock_irqrestore(&ufs->idle_pred.lock, flags);
+}
+
+void pixel_init_idle_pred(struct ufs_hba *hba)
+{
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	struct pixel_idle_pred *pred = &ufs->idle_pred;
+
+	memset(pred, 0, sizeof(*pred));
+	spin_lock_init(&pred->lock);
+	atomic_set(&pred->inflight, 0);
+	pred->h8_breakeven_us = PIXEL_DEFAULT_H8_BREAKEVEN_US;
+	pred->h8_fast_delay_ms = PIXEL_DEFAULT_H8_FAST_DELAY_MS;
+	pred->enabled = true;
+
+	timer_setup(&ufs->manual_gc.defer_timer, pixel_idle_pred_defer_timeout, 0);
+}
+
 static void pixel_ufs_send_command(void *data, struct ufs_hba *hba,
 					struct ufshcd_lrb *lrbp)
 {
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+
+	if (lrbp->cmd && atomic_inc_return(&ufs->idle_pred.inflight) == 1)
+		pixel_idle_pred_end(hba);
+
 	pixel_ufs_update_io_stats(hba, lrbp, true);
 	pixel_ufs_trace_upiu_cmd(hba, lrbp, true);
 }
@@ -631,6 +1165,11 @@ static void pixel_ufs_compl_command(void *data, struct ufs_hba *hba,
 	u8 *asc, *sense_buffer;
 	int ocs;
 	struct request *rq;
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+
+	if (lrbp->cmd &&
+	    atomic_dec_if_positive(&ufs->idle_pred.inflight) == 0)
+		pixel_idle_pred_start(hba);
 
 	pixel_ufs_update_io_stats(hba, lrbp, false);
 	pixel_ufs_update_req_stats(hba, lrbp);
@@ -840,31 +1379,11 @@ static int manual_gc_enable(struct ufs_hba *hba, u32 *value)
 	return ret;
 }
 
-static ssize_t manual_gc_store(struct device *dev,
-			struct device_attribute *attr,
-			const char *buf, size_t count)
+static void pixel_mgc_issue(struct ufs_hba *hba, u32 value)
 {
-	struct ufs_hba *hba = dev_get_drvdata(dev);
 	struct exynos_ufs *ufs = to_exynos_ufs(hba);
-	u32 value;
 	int err = 0;
 
-	if (kstrtou32(buf, 0, &value))
-		return -EINVAL;
-
-	if (value >= MANUAL_GC_MAX)
-		return -EINVAL;
-
-	if (ufshcd_eh_in_progress(hba))
-		return -EBUSY;
-
-	if (value == MANUAL_GC_DISABLE || value == MANUAL_GC_ENABLE) {
-		ufs->manual_gc.state = value;
-		return count;
-	}
-	if (ufs->manual_gc.state == MANUAL_GC_DISABLE)
-		return count;
-
 	if (ufs->manual_gc.hagc_support)
 		ufs->manual_gc.hagc_support =
 			manual_gc_enable(hba, &value) ? false : true;
@@ -895,13 +1414,47 @@ static ssize_t manual_gc_store(struct device *dev,
 
 	if (err || hrtimer_active(&ufs->manual_gc.hrtimer)) {
 		pm_runtime_put_sync(hba->dev);
-		return count;
 	} else {
 		/* pm_runtime_put_sync in delay_ms */
 		hrtimer_start(&ufs->manual_gc.hrtimer,
 			ms_to_ktime(ufs->manual_gc.delay_ms),
 			HRTIMER_MODE_REL);
 	}
+}
+
+static ssize_t manual_gc_store(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	u32 value;
+
+	if (kstrtou32(buf, 0, &value))
+		return -EINVAL;
+
+	if (value >= MANUAL_GC_MAX)
+		return -EINVAL;
+
+	if (ufshcd_eh_in_progress(hba))
+		return -EBUSY;
+
+	if (value == MANUAL_GC_DISABLE || value == MANUAL_GC_ENABLE) {
+		ufs->manual_gc.state = value;
+		if (value == MANUAL_GC_DISABLE)
+			pixel_idle_pred_cancel_gc(hba);
+		return count;
+	}
+	if (ufs->manual_gc.state == MANUAL_GC_DISABLE)
+		return count;
+
+	/* keep the gc window away from foreground I/O bursts */
+	if (value == MANUAL_GC_ON && pixel_idle_pred_defer_gc(hba))
+		return count;
+	if (value == MANUAL_GC_OFF)
+		pixel_idle_pred_cancel_gc(hba);
+
+	pixel_mgc_issue(hba, value);
 	return count;
 }
 
@@ -945,6 +1498,19 @@ static void pixel_mgc_hibern8_work(struct work_struct *work)
 	/* bkops will be disabled when power down */
 }
 
+static void pixel_mgc_issue_work(struct work_struct *work)
+{
+	struct exynos_ufs *ufs = container_of(work, struct exynos_ufs,
+					manual_gc.issue_work);
+	struct ufs_hba *hba = ufs->hba;
+
+	if (ufs->manual_gc.state == MANUAL_GC_DISABLE ||
+	    ufshcd_eh_in_progress(hba))
+		return;
+
+	pixel_mgc_issue(hba, MANUAL_GC_ON);
+}
+
 void pixel_init_manual_gc(struct ufs_hba *hba)
 {
 	struct exynos_ufs *ufs = to_exynos_ufs(hba);
@@ -959,6 +1525,8 @@ void pixel_init_manual_gc(struct ufs_hba *hba)
 	mgc->hrtimer.function = pixel_mgc_hrtimer_handler;
 
 	INIT_WORK(&mgc->hibern8_work, pixel_mgc_hibern8_work);
+	INIT_WORK(&mgc->issue_work, pixel_mgc_issue_work);
+	mgc->pending = false;
 	snprintf(wq_name, ARRAY_SIZE(wq_name), "ufs_mgc_hibern8_work_%d",
 			hba->host->host_no);
 	ufs->manual_gc.mgc_workq = create_singlethread_workqueue(wq_name);
@@ -1162,43 +1730,71 @@ static const struct attribute_group pixel_sysfs_group = {
 	.attrs = pixel_sysfs_pixel_attrs,
 };
 
+static u64 pixel_ufs_req_stats_val(struct ufs_hba *hba, int type, int show)
+{
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	struct pixel_stats_snap snap;
+	struct pixel_req_stats *rst = &snap.req_stats[type];
+	u64 hist[PIXEL_LAT_BUCKETS];
+	u64 total;
+
+	pixel_ufs_fold_stats(ufs, &snap);
+
+	switch (show) {
+	case REQ_SYSFS_MIN:
+		return rst->req_min;
+	case REQ_SYSFS_MAX:
+		return rst->req_max;
+	case REQ_SYSFS_AVG:
+		return rst->req_count ?
+			div64_u64(rst->req_sum, rst->req_count) : 0;
+	case REQ_SYSFS_SUM:
+		return rst->req_sum;
+	}
+
+	total = pixel_ufs_fold_hist(ufs, type, hist);
+	switch (show) {
+	case REQ_SYSFS_P50:
+		return pixel_ufs_hist_percentile(hist, total, 500,
+						 rst->req_max);
+	case REQ_SYSFS_P99:
+		return pixel_ufs_hist_percentile(hist, total, 990,
+						 rst->req_max);
+	case REQ_SYSFS_P999:
+		return pixel_ufs_hist_percentile(hist, total, 999,
+						 rst->req_max);
+	}
+	return 0;
+}
+
 #define PIXEL_REQ_STATS_ATTR(_name, _type_name, _type_show)		\
 static ssize_t _name##_show(struct device *dev,				\
 	struct device_attribute *attr, char *buf)			\
 {									\
 	struct ufs_hba *hba = dev_get_drvdata(dev);			\
-	struct exynos_ufs *ufs = to_exynos_ufs(hba);			\
-	unsigned long flags;						\
 	u64 val;							\
-	spin_lock_irqsave(hba->host->host_lock, flags);			\
-	switch (_type_show) {						\
-	case REQ_SYSFS_MIN:						\
-		val = ufs->req_stats[_type_name].req_min;		\
-		break;							\
-	case REQ_SYSFS_MAX:						\
-		val = ufs->req_stats[_type_name].req_max;		\
-		break;							\
-	case REQ_SYSFS_AVG:						\
-		val = div64_u64(ufs->req_stats[_type_name].req_sum,	\
-				ufs->req_stats[_type_name].req_count);	\
-		break;							\
-	case REQ_SYSFS_SUM:						\
-		val = ufs->req_stats[_type_name].req_sum;		\
-		break;							\
-	default:							\
-		val = 0;						\
-		break;							\
-	}								\
-	spin_unlock_irqrestore(hba->host->host_lock, flags);		\
+	val = pixel_ufs_req_stats_val(hba, _type_name, _type_show);	\
 	return sprintf(buf, "%llu\n", val);				\
 }									\
 static DEVICE_ATTR_RO(_name)
 
+/*
+ * Reset may race with completions on other cpus, which can leave a few
+ * requests in the new statistics. That is fine for monitoring.
+ */
 static inline void pixel_init_req_stats(struct ufs_hba *hba)
 {
 	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	int cpu;
 
-	memset(ufs->req_stats, 0, sizeof(ufs->req_stats));
+	for_each_possible_cpu(cpu) {
+		struct pixel_pcpu_stats *pst = per_cpu_ptr(ufs->pcpu_stats,
+							   cpu);
+
+		memset(pst->req_stats, 0, sizeof(pst->req_stats));
+		memset(pst->peak_reqs, 0, sizeof(pst->peak_reqs));
+		memset(pst->hist, 0, sizeof(pst->hist));
+	}
 	memset(pixel_ufs_prev_sum, 0, sizeof(pixel_ufs_prev_sum));
 	memset(pixel_ufs_prev_count, 0, sizeof(pixel_ufs_prev_count));
 }
@@ -1213,7 +1809,6 @@ static ssize_t reset_req_status_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t count)
 {
 	struct ufs_hba *hba = dev_get_drvdata(dev);
-	unsigned long flags;
 	unsigned long value;
 
 	if (kstrtoul(buf, 0, &value)) {
@@ -1221,13 +1816,83 @@ static ssize_t reset_req_status_store(struct device *dev,
 		return -EINVAL;
 	}
 
-	spin_lock_irqsave(hba->host->host_lock, flags);
 	pixel_init_req_stats(hba);
-	spin_unlock_irqrestore(hba->host->host_lock, flags);
 
 	return count;
 }
 
+static const char * const pixel_req_type_str[REQ_TYPE_MAX] = {
+	[REQ_TYPE_READ] = "read",
+	[REQ_TYPE_WRITE] = "write",
+	[REQ_TYPE_FLUSH] = "flush",
+	[REQ_TYPE_DISCARD] = "discard",
+	[REQ_TYPE_SECURITY] = "security",
+	[REQ_TYPE_OTHER] = "other",
+};
+
+static const char * const pixel_size_class_str[PIXEL_SIZE_MAX] = {
+	[PIXEL_SIZE_4K] = "4k",
+	[PIXEL_SIZE_64K] = "64k",
+	[PIXEL_SIZE_LARGE] = "large",
+};
+
+static const char * const pixel_qd_class_str[PIXEL_QD_MAX] = {
+	[PIXEL_QD_1] = "qd1",
+	[PIXEL_QD_4] = "qd4",
+	[PIXEL_QD_16] = "qd16",
+	[PIXEL_QD_32] = "qd32",
+};
+
+/* one line per type, size and queue depth class which has requests */
+static ssize_t latency_hist_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	u64 hist[PIXEL_LAT_BUCKETS];
+	int cpu, type, size, qd, i;
+	ssize_t len = 0;
+
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "type size qd count p50 p99 p999 (us)\n");
+
+	for (type = REQ_TYPE_READ; type < REQ_TYPE_MAX; type++) {
+		for (size = 0; size < PIXEL_SIZE_MAX; size++) {
+			for (qd = 0; qd < PIXEL_QD_MAX; qd++) {
+				u64 total = 0;
+
+				memset(hist, 0, sizeof(hist));
+				for_each_possible_cpu(cpu) {
+					struct pixel_pcpu_stats *pst =
+						per_cpu_ptr(ufs->pcpu_stats,
+							    cpu);
+
+					for (i = 0; i < PIXEL_LAT_BUCKETS; i++)
+						hist[i] += READ_ONCE(
+						pst->hist[type][size][qd][i]);
+				}
+				for (i = 0; i < PIXEL_LAT_BUCKETS; i++)
+					total += hist[i];
+				if (!total)
+					continue;
+
+				len += scnprintf(buf + len, PAGE_SIZE - len,
+					"%s %s %s %llu %llu %llu %llu\n",
+					pixel_req_type_str[type],
+					pixel_size_class_str[size],
+					pixel_qd_class_str[qd], total,
+					pixel_ufs_hist_percentile(hist, total,
+						500, U64_MAX),
+					pixel_ufs_hist_percentile(hist, total,
+						990, U64_MAX),
+					pixel_ufs_hist_percentile(hist, total,
+						999, U64_MAX));
+			}
+		}
+	}
+	return len;
+}
+
 PIXEL_REQ_STATS_ATTR(all_min, REQ_TYPE_VALID, REQ_SYSFS_MIN);
 PIXEL_REQ_STATS_ATTR(all_max, REQ_TYPE_VALID, REQ_SYSFS_MAX);
 PIXEL_REQ_STATS_ATTR(all_avg, REQ_TYPE_VALID, REQ_SYSFS_AVG);
@@ -1252,34 +1917,72 @@ PIXEL_REQ_STATS_ATTR(security_min, REQ_TYPE_SECURITY, REQ_SYSFS_MIN);
 PIXEL_REQ_STATS_ATTR(security_max, REQ_TYPE_SECURITY, REQ_SYSFS_MAX);
 PIXEL_REQ_STATS_ATTR(security_avg, REQ_TYPE_SECURITY, REQ_SYSFS_AVG);
 PIXEL_REQ_STATS_ATTR(security_sum, REQ_TYPE_SECURITY, REQ_SYSFS_SUM);
+PIXEL_REQ_STATS_ATTR(all_p50, REQ_TYPE_VALID, REQ_SYSFS_P50);
+PIXEL_REQ_STATS_ATTR(all_p99, REQ_TYPE_VALID, REQ_SYSFS_P99);
+PIXEL_REQ_STATS_ATTR(all_p999, REQ_TYPE_VALID, REQ_SYSFS_P999);
+PIXEL_REQ_STATS_ATTR(read_p50, REQ_TYPE_READ, REQ_SYSFS_P50);
+PIXEL_REQ_STATS_ATTR(read_p99, REQ_TYPE_READ, REQ_SYSFS_P99);
+PIXEL_REQ_STATS_ATTR(read_p999, REQ_TYPE_READ, REQ_SYSFS_P999);
+PIXEL_REQ_STATS_ATTR(write_p50, REQ_TYPE_WRITE, REQ_SYSFS_P50);
+PIXEL_REQ_STATS_ATTR(write_p99, REQ_TYPE_WRITE, REQ_SYSFS_P99);
+PIXEL_REQ_STATS_ATTR(write_p999, REQ_TYPE_WRITE, REQ_SYSFS_P999);
+PIXEL_REQ_STATS_ATTR(flush_p50, REQ_TYPE_FLUSH, REQ_SYSFS_P50);
+PIXEL_REQ_STATS_ATTR(flush_p99, REQ_TYPE_FLUSH, REQ_SYSFS_P99);
+PIXEL_REQ_STATS_ATTR(flush_p999, REQ_TYPE_FLUSH, REQ_SYSFS_P999);
+PIXEL_REQ_STATS_ATTR(discard_p50, REQ_TYPE_DISCARD, REQ_SYSFS_P50);
+PIXEL_REQ_STATS_ATTR(discard_p99, REQ_TYPE_DISCARD, REQ_SYSFS_P99);
+PIXEL_REQ_STATS_ATTR(discard_p999, REQ_TYPE_DISCARD, REQ_SYSFS_P999);
+PIXEL_REQ_STATS_ATTR(security_p50, REQ_TYPE_SECURITY, REQ_SYSFS_P50);
+PIXEL_REQ_STATS_ATTR(security_p99, REQ_TYPE_SECURITY, REQ_SYSFS_P99);
+PIXEL_REQ_STATS_ATTR(security_p999, REQ_TYPE_SECURITY, REQ_SYSFS_P999);
 DEVICE_ATTR_RW(reset_req_status);
+static DEVICE_ATTR_RO(latency_hist);
 
 static struct attribute *ufs_sysfs_req_stats[] = {
 	&dev_attr_all_min.attr,
 	&dev_attr_all_max.attr,
 	&dev_attr_all_avg.attr,
 	&dev_attr_all_sum.attr,
+	&dev_attr_all_p50.attr,
+	&dev_attr_all_p99.attr,
+	&dev_attr_all_p999.attr,
 	&dev_attr_read_min.attr,
 	&dev_attr_read_max.attr,
 	&dev_attr_read_avg.attr,
 	&dev_attr_read_sum.attr,
+	&dev_attr_read_p50.attr,
+	&dev_attr_read_p99.attr,
+	&dev_attr_read_p999.attr,
 	&dev_attr_write_min.attr,
 	&dev_attr_write_max.attr,
 	&dev_attr_write_avg.attr,
 	&dev_attr_write_sum.attr,
+	&dev_attr_write_p50.attr,
+	&dev_attr_write_p99.attr,
+	&dev_attr_write_p999.attr,
 	&dev_attr_flush_min.attr,
 	&dev_attr_flush_max.attr,
 	&dev_attr_flush_avg.attr,
 	&dev_attr_flush_sum.attr,
+	&dev_attr_flush_p50.attr,
+	&dev_attr_flush_p99.attr,
+	&dev_attr_flush_p999.attr,
 	&dev_attr_discard_min.attr,
 	&dev_attr_discard_max.attr,
 	&dev_attr_discard_avg.attr,
 	&dev_attr_discard_sum.attr,
+	&dev_attr_discard_p50.attr,
+	&dev_attr_discard_p99.attr,
+	&dev_attr_discard_p999.attr,
 	&dev_attr_security_min.attr,
 	&dev_attr_security_max.attr,
 	&dev_attr_security_avg.attr,
 	&dev_attr_security_sum.attr,
+	&dev_attr_security_p50.attr,
+	&dev_attr_security_p99.attr,
+	&dev_attr_security_p999.attr,
 	&dev_attr_reset_req_status.attr,
+	&dev_attr_latency_hist.attr,
 	NULL,
 };
 
@@ -1294,12 +1997,10 @@ static ssize_t _name##_show(struct device *dev,			\
 {								\
 	struct ufs_hba *hba = dev_get_drvdata(dev);		\
 	struct exynos_ufs *ufs = to_exynos_ufs(hba);		\
-	unsigned long flags;					\
-	u64 val;						\
-	spin_lock_irqsave(hba->host->host_lock, flags);		\
-	val = ufs->io_stats[_io_name]._type_show;		\
-	spin_unlock_irqrestore(hba->host->host_lock, flags);	\
-	return sprintf(buf, "%llu\n", val);			\
+	struct pixel_stats_snap snap;				\
+	pixel_ufs_fold_stats(ufs, &snap);			\
+	return sprintf(buf, "%llu\n",				\
+			snap.io_stats[_io_name]._type_show);	\
 }								\
 static DEVICE_ATTR_RO(_name)
 
@@ -1314,16 +2015,17 @@ static ssize_t reset_io_status_store(struct device *dev,
 {
 	struct ufs_hba *hba = dev_get_drvdata(dev);
 	struct exynos_ufs *ufs = to_exynos_ufs(hba);
-	unsigned long flags;
+	int cpu, i;
 
-	spin_lock_irqsave(hba->host->host_lock, flags);
-	ufs->io_stats[IO_TYPE_READ].max_diff_req_count = 0;
-	ufs->io_stats[IO_TYPE_READ].max_diff_total_bytes = 0;
-	ufs->io_stats[IO_TYPE_WRITE].max_diff_req_count = 0;
-	ufs->io_stats[IO_TYPE_WRITE].max_diff_total_bytes = 0;
-	ufs->io_stats[IO_TYPE_READ_WRITE].max_diff_req_count = 0;
-	ufs->io_stats[IO_TYPE_READ_WRITE].max_diff_total_bytes = 0;
-	spin_unlock_irqrestore(hba->host->host_lock, flags);
+	for_each_possible_cpu(cpu) {
+		struct pixel_pcpu_stats *pst = per_cpu_ptr(ufs->pcpu_stats,
+							   cpu);
+
+		for (i = 0; i < IO_TYPE_MAX; i++) {
+			WRITE_ONCE(pst->io_stats[i].max_diff_req_count, 0);
+			WRITE_ONCE(pst->io_stats[i].max_diff_total_bytes, 0);
+		}
+	}
 
 	return count;
 }
@@ -1524,6 +2226,123 @@ static const struct attribute_group pixel_sysfs_ufs_stats_group = {
 	.attrs = ufs_sysfs_ufs_stats,
 };
 
+#define PIXEL_IDLE_PRED_ATTR_RO(_name)				\
+static ssize_t _name##_show(struct device *dev,			\
+	struct device_attribute *attr, char *buf)		\
+{								\
+	struct ufs_hba *hba = dev_get_drvdata(dev);		\
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);		\
+	unsigned long flags;					\
+	u64 val;						\
+	spin_lock_irqsave(&ufs->idle_pred.lock, flags);		\
+	val = ufs->idle_pred._name;				\
+	spin_unlock_irqrestore(&ufs->idle_pred.lock, flags);	\
+	return sprintf(buf, "%llu\n", val);			\
+}								\
+static DEVICE_ATTR_RO(_name)
+
+#define PIXEL_IDLE_PRED_ATTR_RW(_name)				\
+static ssize_t _name##_show(struct device *dev,			\
+	struct device_attribute *attr, char *buf)		\
+{								\
+	struct ufs_hba *hba = dev_get_drvdata(dev);		\
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);		\
+	return sprintf(buf, "%u\n", ufs->idle_pred._name);	\
+}								\
+static ssize_t _name##_store(struct device *dev,		\
+	struct device_attribute *attr, const char *buf, size_t count)	\
+{								\
+	struct ufs_hba *hba = dev_get_drvdata(dev);		\
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);		\
+	unsigned long flags;					\
+	u32 value;						\
+	if (kstrtou32(buf, 0, &value))				\
+		return -EINVAL;					\
+	spin_lock_irqsave(&ufs->idle_pred.lock, flags);		\
+	ufs->idle_pred._name = value;				\
+	spin_unlock_irqrestore(&ufs->idle_pred.lock, flags);	\
+	return count;						\
+}								\
+static DEVICE_ATTR_RW(_name)
+
+static ssize_t idle_pred_enable_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+
+	return sprintf(buf, "%d\n", ufs->idle_pred.enabled);
+}
+
+static ssize_t idle_pred_enable_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct exynos_ufs *ufs = to_exynos_ufs(hba);
+	struct pixel_idle_pred *pred = &ufs->idle_pred;
+	struct ufs_manual_gc *mgc = &ufs->manual_gc;
+	unsigned long flags;
+	bool value;
+
+	if (kstrtobool(buf, &value))
+		return -EINVAL;
+
+	/* host_lock nests outside pred->lock, as on the completion path */
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	spin_lock(&pred->lock);
+	if (pred->enabled && !value) {
+		/* give back the clock gating delay and deferred gc */
+		if (ufs->params[UFS_S_PARAM_H8_D_MS])
+			hba->clk_gating.delay_ms = ufs->params[UFS_S_PARAM_H8_D_MS];
+		else if (pred->h8_delay_ms)
+			hba->clk_gating.delay_ms = pred->h8_delay_ms;
+		if (mgc->pending) {
+			mgc->pending = false;
+			del_timer(&mgc->defer_timer);
+			queue_work(mgc->mgc_workq, &mgc->issue_work);
+		}
+	}
+	pred->enabled = value;
+	spin_unlock(&pred->lock);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+PIXEL_IDLE_PRED_ATTR_RW(h8_breakeven_us);
+PIXEL_IDLE_PRED_ATTR_RW(h8_fast_delay_ms);
+PIXEL_IDLE_PRED_ATTR_RW(h8_delay_ms);
+PIXEL_IDLE_PRED_ATTR_RO(predicted_us);
+PIXEL_IDLE_PRED_ATTR_RO(hit);
+PIXEL_IDLE_PRED_ATTR_RO(miss_wake);
+PIXEL_IDLE_PRED_ATTR_RO(miss_idle);
+PIXEL_IDLE_PRED_ATTR_RO(idle_total_us);
+PIXEL_IDLE_PRED_ATTR_RO(idle_fast_us);
+PIXEL_IDLE_PRED_ATTR_RO(gc_deferred);
+PIXEL_IDLE_PRED_ATTR_RO(gc_forced);
+static DEVICE_ATTR_RW(idle_pred_enable);
+
+static struct attribute *pixel_sysfs_idle_pred[] = {
+	&dev_attr_idle_pred_enable.attr,
+	&dev_attr_h8_breakeven_us.attr,
+	&dev_attr_h8_fast_delay_ms.attr,
+	&dev_attr_h8_delay_ms.attr,
+	&dev_attr_predicted_us.attr,
+	&dev_attr_hit.attr,
+	&dev_attr_miss_wake.attr,
+	&dev_attr_miss_idle.attr,
+	&dev_attr_idle_total_us.attr,
+	&dev_attr_idle_fast_us.attr,
+	&dev_attr_gc_deferred.attr,
+	&dev_attr_gc_forced.attr,
+	NULL,
+};
+
+static const struct attribute_group pixel_sysfs_idle_pred_group = {
+	.name = "idle_pred",
+	.attrs = pixel_sysfs_idle_pred,
+};
+
 #define PIXEL_HC_REG_ATTR(_name, _uname)			\
 static ssize_t _name##_show(struct device *dev,			\
 	struct device_attribute *attr, char *buf)		\
@@ -1616,6 +2435,7 @@ static const struct attribute_group *pixel_ufs_sysfs_groups[] = {
 	&pixel_sysfs_io_stats_group,
 	&pixel_sysfs_err_stats_group,
 	&pixel_sysfs_ufs_stats_group,
+	&pixel_sysfs_idle_pred_group,
 	&pixel_sysfs_hc_register_ifc_group,
 	&pixel_sysfs_power_info_group,
 	NULL,
@@ -1654,28 +2474,40 @@ static void pixel_ufs_update_sysfs(void *data, struct ufs_hba *hba)
 	queue_work(system_highpri_wq, &ufs->update_sysfs_work);
 }
 
+static void pixel_print_recent_cmd_log(struct ufs_hba *hba, int max_entries)
+{
+	pixel_walk_cmd_log(hba, max_entries, pixel_print_cmd_log_entry, NULL);
+}
+
 void pixel_print_cmd_log(struct ufs_hba *hba)
 {
-	struct exynos_ufs *ufs = to_exynos_ufs(hba);
-	struct pixel_cmd_log_entry *entry = NULL;
-	int i;
+	pixel_print_recent_cmd_log(hba, MAX_CMD_ENTRY_NUM);
+}
 
-	if (!ufs->enable_cmd_log)
-		return;
+static void pixel_seq_cmd_log_entry(struct ufs_hba *hba, int cpu,
+		struct pixel_cmd_log_entry *entry, void *priv)
+{
+	struct seq_file *s = priv;
+
+	seq_printf(s, "%lld %d/%u: %s lun: %u tag: %d cmd: %s opcode: 0x%x idn: 0x%x sector: %llu len: 0x%x DB: 0x%llx outstanding: 0x%llx GID: 0x%x err: 0x%llx eh: %u\n",
+		   ktime_to_us(entry->tstamp), cpu, entry->seq_num,
+		   entry->event, entry->lun, entry->tag,
+		   entry->cmd ? (char *)entry->cmd : "-",
+		   entry->opcode, entry->idn, (u64)entry->sector,
+		   entry->affected_bytes, entry->doorbell,
+		   entry->outstanding_reqs, entry->group_id,
+		   entry->error, entry->queue_eh_work);
+}
 
-	for (i = 1; i <= MAX_CMD_ENTRY_NUM; i++) {
-		entry = &ufs->cmd_log.entry[(ufs->cmd_log.head + i) %
-						MAX_CMD_ENTRY_NUM];
-		if (!entry->seq_num)
-			break;
-		dev_err(hba->dev, "%lu: %s tag: %lu cmd: %s sector: %lu len: 0x%lx DB: 0x%lx outstanding: 0x%lx GID: 0x%x\n",
-			entry->seq_num, entry->event,
-			entry->tag, entry->cmd,
-			entry->sector, entry->affected_bytes,
-			entry->doorbell, entry->outstanding_reqs,
-			entry->group_id);
-	}
+static int pixel_ufs_cmd_log_show(struct seq_file *s, void *unused)
+{
+	struct ufs_hba *hba = s->private;
+
+	pixel_walk_cmd_log(hba, MAX_CMD_ENTRY_NUM * num_possible_cpus(),
+			   pixel_seq_cmd_log_entry, s);
+	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(pixel_ufs_cmd_log);
 
 int pixel_init(struct ufs_hba *hba)
 {
@@ -1685,6 +2517,10 @@ int pixel_init(struct ufs_hba *hba)
 	memset(&ufs->ufs_stats, 0, sizeof(struct pixel_ufs_stats));
 	ufs->ufs_stats.hibern8_flag = false;
 
+	ufs->pcpu_stats = devm_alloc_percpu(ufs->dev, struct pixel_pcpu_stats);
+	if (!ufs->pcpu_stats)
+		return -ENOMEM;
+
 	ret = register_trace_android_vh_ufs_prepare_command(
 				pixel_ufs_prepare_command, NULL);
 	if (ret)
@@ -1721,6 +2557,9 @@ int pixel_init(struct ufs_hba *hba)
 		return ret;
 
 	pixel_ufs_init_cmd_log(hba);
+	ufs->cmd_log.debugfs = debugfs_create_file("ufs-pixel-cmd-log", 0400,
+						   NULL, hba,
+						   &pixel_ufs_cmd_log_fops);
 
 	INIT_WORK(&ufs->update_sysfs_work, pixel_ufs_update_sysfs_work);
 	return 0;
@@ -1731,7 +2570,9 @@ void pixel_exit(struct ufs_hba *hba)
 	struct exynos_ufs *ufs = to_exynos_ufs(hba);
 	int i;
 
-	devm_kfree(ufs->dev, ufs->cmd_log.entry);
+	del_timer_sync(&ufs->manual_gc.defer_timer);
+	debugfs_remove(ufs->cmd_log.debugfs);
+	devm_free_percpu(ufs->dev, ufs->cmd_log.ring);
 	for (i = 0; i < EVENT_TYPE_MAX; i++)
 		devm_kfree(ufs->dev, ufs->cmd_log.event_str);
 }
@@ -26,9 +26,14 @@ struct ufs_manual_gc {
 	unsigned long delay_ms;
 	struct work_struct hibern8_work;
 	struct workqueue_struct *mgc_workq;
+	/* manual gc on deferred to a predicted idle period */
+	bool pending;
+	struct timer_list defer_timer;
+	struct work_struct issue_work;
 };
 
 #define UFSHCD_MANUAL_GC_HOLD_HIBERN8		2000	/* 2 seconds */
+#define UFSHCD_MANUAL_GC_MAX_DEFER		30000	/* 30 seconds */
 
 #define QUERY_ATTR_IDN_MANUAL_GC_CONT		0x12
 #define QUERY_ATTR_IDN_MANUAL_GC_STATUS		0x13
@@ -43,6 +48,55 @@ enum {
 
 extern void pixel_init_manual_gc(struct ufs_hba *hba);
 
+/* idle period predictor */
+#define PIXEL_IDLE_INTERVALS			8
+#define PIXEL_IDLE_MAX_US			10000000	/* 10 seconds */
+#define PIXEL_DEFAULT_H8_BREAKEVEN_US		5000		/* 5 ms */
+#define PIXEL_DEFAULT_H8_FAST_DELAY_MS		2
+
+/**
+ * struct pixel_idle_pred - idle period predictor fed by scsi command arrivals
+ * @enabled: whether the prediction drives hibern8 entry and manual gc
+ * @lock: protects the fields below, except @inflight
+ * @inflight: outstanding scsi commands
+ * @idle_start: when the last outstanding command completed, 0 if busy
+ * @intervals: recent idle periods (us), ring indexed by @next
+ * @next: next slot in @intervals
+ * @predicted_us: predicted length of the current idle period, 0 if unknown
+ * @h8_breakeven_us: shortest idle period which pays back hibern8 enter/exit
+ * @h8_fast_delay_ms: clock gating delay when a long idle period is predicted
+ * @h8_delay_ms: clock gating delay otherwise, taken from UFS_S_PARAM_H8_D_MS
+ *	or the host at start
+ * @hit: idle periods which were predicted on the right side of breakeven
+ * @miss_wake: predicted long, but woken up before breakeven
+ * @miss_idle: not predicted long, but stayed idle longer than breakeven
+ * @idle_total_us: total idle time between commands
+ * @idle_fast_us: idle time in periods predicted long
+ * @gc_deferred: manual gc requests deferred to an idle period
+ * @gc_forced: deferred manual gc issued after UFSHCD_MANUAL_GC_MAX_DEFER
+ */
+struct pixel_idle_pred {
+	bool enabled;
+	spinlock_t lock;
+	atomic_t inflight;
+	ktime_t idle_start;
+	u32 intervals[PIXEL_IDLE_INTERVALS];
+	int next;
+	u64 predicted_us;
+	u32 h8_breakeven_us;
+	u32 h8_fast_delay_ms;
+	u32 h8_delay_ms;
+	u64 hit;
+	u64 miss_wake;
+	u64 miss_idle;
+	u64 idle_total_us;
+	u64 idle_fast_us;
+	u64 gc_deferred;
+	u64 gc_forced;
+};
+
+extern void pixel_init_idle_pred(struct ufs_hba *hba);
+
 /* defined request category on statistics */
 enum req_type_stats {
 	REQ_TYPE_VALID = 0,
@@ -61,6 +115,9 @@ enum req_sysfs_stats {
 	REQ_SYSFS_MAX = 1,
 	REQ_SYSFS_AVG = 2,
 	REQ_SYSFS_SUM = 3,
+	REQ_SYSFS_P50 = 4,
+	REQ_SYSFS_P99 = 5,
+	REQ_SYSFS_P999 = 6,
 };
 
 /**
@@ -103,6 +160,61 @@ struct pixel_io_stats {
 	u64 max_diff_total_bytes;
 };
 
+/*
+ * Request time histogram buckets. Bucket 0 counts 0us, and bucket N counts
+ * [2^(N-1), 2^N) us. The last bucket also counts anything slower (~4s).
+ */
+#define PIXEL_LAT_BUCKETS	24
+
+/* request size class on latency histogram */
+enum pixel_size_class {
+	PIXEL_SIZE_4K = 0,	/* ~ 4KB */
+	PIXEL_SIZE_64K = 1,	/* ~ 64KB */
+	PIXEL_SIZE_LARGE = 2,	/* 64KB ~ */
+	PIXEL_SIZE_MAX = 3,
+};
+
+/* queue depth class at issue on latency histogram */
+enum pixel_qd_class {
+	PIXEL_QD_1 = 0,		/* 1 */
+	PIXEL_QD_4 = 1,		/* 2 ~ 4 */
+	PIXEL_QD_16 = 2,	/* 5 ~ 16 */
+	PIXEL_QD_32 = 3,	/* 17 ~ */
+	PIXEL_QD_MAX = 4,
+};
+
+/**
+ * struct pixel_pcpu_stats - per-cpu request and I/O statistics
+ * @req_stats: request time statistics completed on this cpu
+ * @peak_reqs: maximum request time in the trace period of @peak_gen
+ * @peak_queue_depth: maximum read/write queue depth in the same period
+ * @peak_gen: trace period which @peak_reqs and @peak_queue_depth belong to
+ * @io_stats: I/O amount statistics started or completed on this cpu
+ * @hist: request time histogram per type, size class and queue depth class.
+ *        REQ_TYPE_VALID is not recorded, but folded from the other types.
+ *
+ * Only the owning cpu writes to this with local irq disabled. Readers fold
+ * all cpus together without locking.
+ */
+struct pixel_pcpu_stats {
+	struct pixel_req_stats req_stats[REQ_TYPE_MAX];
+	u64 peak_reqs[REQ_TYPE_MAX];
+	u64 peak_queue_depth;
+	unsigned long peak_gen;
+	struct pixel_io_stats io_stats[IO_TYPE_MAX];
+	u64 hist[REQ_TYPE_MAX][PIXEL_SIZE_MAX][PIXEL_QD_MAX][PIXEL_LAT_BUCKETS];
+};
+
+/**
+ * struct pixel_stats_snap - statistics folded from all cpus
+ */
+struct pixel_stats_snap {
+	struct pixel_req_stats req_stats[REQ_TYPE_MAX];
+	u64 peak_reqs[REQ_TYPE_MAX];
+	u64 peak_queue_depth;
+	struct pixel_io_stats io_stats[IO_TYPE_MAX];
+};
+
 static inline char *parse_opcode(u8 opcode)
 {
 	/* string should be less than 12 byte-long */
@@ -250,11 +362,21 @@ struct pixel_cmd_log_entry {
 #define MAX_CMD_ENTRY_NUM       200
 #define MAX_EVENT_STR_LEN       16
 #define MAX_CMD_STR_LEN         16
+#define SLOWIO_CMD_ENTRY_NUM    16
+
+/*
+ * Each cpu logs into its own ring without locking. An entry is valid only
+ * while its seq_num matches the ring sequence it was written at, so dumpers
+ * on other cpus can skip entries that are being overwritten.
+ */
+struct pixel_cmd_log_ring {
+	u32 seq;
+	struct pixel_cmd_log_entry entry[MAX_CMD_ENTRY_NUM];
+};
 
 struct pixel_cmd_log {
-	struct pixel_cmd_log_entry *entry;
-	u32 head;
-	u32 seq_cnt;
+	struct pixel_cmd_log_ring __percpu *ring;
+	struct dentry *debugfs;
 	u8 *event_str[EVENT_TYPE_MAX];
 	u8 *cmd_str[CMD_TYPE_MAX];
 };
@@ -6,6 +6,9 @@
 
 #include <linux/ip.h>
 #include <linux/ipv6.h>
+#include <linux/sort.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "modem_prj.h"
 #include "modem_utils.h"
 #include "link_device_memory.h"
@@ -152,8 +155,169 @@ static u32 tpmon_get_rx_others_speed_mbps(struct tpmon_data *data)
 	return (u32)data->tpmon->rx_others.rx_mbps;
 }
 
+static u32 tpmon_get_rx_flow_speed_mbps(struct tpmon_data *data)
+{
+	if (!data->enable)
+		return 0;
+
+	if (!data->tpmon->num_top_flow)
+		return 0;
+
+	return (u32)data->tpmon->top_flow[0].rx_mbps;
+}
+
+/* RX bytes */
+static void fold_rx_bytes_internal(struct cpif_tpmon *tpmon,
+		struct cpif_rx_data *rx_data, unsigned long sum, bool discard)
+{
+	if (!discard && !tpmon->rx_bytes_skip_add)
+		rx_data->rx_bytes += sum - rx_data->rx_bytes_folded;
+	rx_data->rx_bytes_folded = sum;
+}
+
+/* Fold the per-CPU counters into rx_bytes. discard only moves the baseline */
+static void tpmon_fold_rx_bytes(struct cpif_tpmon *tpmon, bool discard)
+{
+	unsigned long total = 0, tcp = 0, udp = 0, others = 0;
+	unsigned long flags;
+	int cpu;
+
+	if (!tpmon->rx_pcpu)
+		return;
+
+	spin_lock_irqsave(&tpmon->lock, flags);
+
+	for_each_possible_cpu(cpu) {
+		struct cpif_rx_pcpu *rx = per_cpu_ptr(tpmon->rx_pcpu, cpu);
+
+		total += READ_ONCE(rx->total);
+		tcp += READ_ONCE(rx->tcp);
+		udp += READ_ONCE(rx->udp);
+		others += READ_ONCE(rx->others);
+	}
+
+	fold_rx_bytes_internal(tpmon, &tpmon->rx_total, total, discard);
+	fold_rx_bytes_internal(tpmon, &tpmon->rx_tcp, tcp, discard);
+	fold_rx_bytes_internal(tpmon, &tpmon->rx_udp, udp, discard);
+	fold_rx_bytes_internal(tpmon, &tpmon->rx_others, others, discard);
+
+	spin_unlock_irqrestore(&tpmon->lock, flags);
+}
+
+/* Flow */
+static void tpmon_add_flow_bytes(struct cpif_tpmon *tpmon, struct sk_buff *skb, u8 proto)
+{
+	struct cpif_flow_pcpu *flow;
+	struct cpif_flow_slot *table, *slot, *min_slot = NULL;
+	u32 epoch = READ_ONCE(tpmon->flow_epoch);
+	u32 hash;
+	unsigned long flags;
+	int i;
+
+	if (!tpmon->flow_pcpu)
+		return;
+
+	hash = skb_get_hash(skb);
+	if (!hash)
+		return;
+
+	local_irq_save(flags);
+
+	flow = this_cpu_ptr(tpmon->flow_pcpu);
+	table = flow->slot[epoch & 1];
+	if (flow->epoch[epoch & 1] != epoch) {
+		/* this half holds an epoch that was merged already */
+		memset(table, 0, sizeof(flow->slot[0]));
+		WRITE_ONCE(flow->epoch[epoch & 1], epoch);
+	}
+
+	for (i = 0; i < MAX_TPMON_FLOW_SLOTS; i++) {
+		slot = &table[i];
+		if (slot->hash == hash) {
+			slot->bytes += skb->len;
+			goto out;
+		}
+
+		if (!min_slot || slot->bytes < min_slot->bytes)
+			min_slot = slot;
+	}
+
+	/* Evict the smallest flow. The new one inherits its count */
+	min_slot->hash = hash;
+	min_slot->proto = proto;
+	min_slot->bytes += skb->len;
+
+out:
+	local_irq_restore(flags);
+}
+
+static void tpmon_calc_flow_speed(struct cpif_tpmon *tpmon, unsigned long rx_bytes)
+{
+	struct cpif_flow_info *merge = tpmon->flow_merge;
+	u32 epoch = tpmon->flow_epoch;
+	unsigned long divider_mbps;
+	u32 num = 0;
+	int cpu, i, j, k;
+
+	if (!tpmon->flow_pcpu || !merge)
+		return;
+
+	/*
+	 * Move packets to the other half of each per-CPU table. The half of
+	 * this epoch is only reset by a CPU once the epoch after the next one
+	 * starts, so it can be merged without racing with new packets.
+	 */
+	WRITE_ONCE(tpmon->flow_epoch, epoch + 1);
+
+	for_each_possible_cpu(cpu) {
+		struct cpif_flow_pcpu *flow = per_cpu_ptr(tpmon->flow_pcpu, cpu);
+		struct cpif_flow_slot *table = flow->slot[epoch & 1];
+
+		if (READ_ONCE(flow->epoch[epoch & 1]) != epoch)
+			continue;
+
+		for (i = 0; i < MAX_TPMON_FLOW_SLOTS; i++) {
+			u32 hash = READ_ONCE(table[i].hash);
+			unsigned long bytes = READ_ONCE(table[i].bytes);
+
+			if (!hash || !bytes)
+				continue;
+
+			for (j = 0; j < num; j++)
+				if (merge[j].hash == hash)
+					break;
+
+			if (j == num) {
+				merge[num].hash = hash;
+				merge[num].proto = READ_ONCE(table[i].proto);
+				merge[num].rx_bytes = 0;
+				num++;
+			}
+			merge[j].rx_bytes += bytes;
+		}
+	}
+
+	/* mbps 131072 = 1024 * 1024 / 8 */
+	divider_mbps = 131072 * tpmon->monitor_interval_msec / 1000;
+	tpmon->rx_interval_mbps = divider_mbps ? rx_bytes / divider_mbps : 0;
+
+	tpmon->num_top_flow = 0;
+	for (i = 0; i < min_t(u32, num, MAX_TPMON_TOP_FLOWS); i++) {
+		k = i;
+		for (j = i + 1; j < num; j++)
+			if (merge[j].rx_bytes > merge[k].rx_bytes)
+				k = j;
+		swap(merge[i], merge[k]);
+
+		tpmon->top_flow[i] = merge[i];
+		tpmon->top_flow[i].rx_mbps = divider_mbps ?
+			merge[i].rx_bytes / divider_mbps : 0;
+		tpmon->num_top_flow++;
+	}
+}
+
 /* RX speed */
-static void calc_rx_speed_internal(struct cpif_tpmon *tpmon,
+static unsigned long calc_rx_speed_internal(struct cpif_tpmon *tpmon,
 		struct cpif_rx_data *rx_data)
 {
 	unsigned long divider_mbps, divider_kbps;
@@ -188,16 +352,22 @@ static void calc_rx_speed_internal(struct cpif_tpmon *tpmon,
 		rx_data->rx_kbps = 0;
 	else
 		rx_data->rx_kbps = rx_data->rx_sum / divider_kbps;
+
+	return rx_bytes;
 }
 
 static void tpmon_calc_rx_speed(struct cpif_tpmon *tpmon)
 {
+	unsigned long rx_bytes;
 	unsigned long flags;
 
 	if (tpmon->rx_bytes_valid_cnt < tpmon->rx_bytes_len)
 		tpmon->rx_bytes_valid_cnt++;
 
-	calc_rx_speed_internal(tpmon, &tpmon->rx_total);
+	tpmon_fold_rx_bytes(tpmon, false);
+
+	rx_bytes = calc_rx_speed_internal(tpmon, &tpmon->rx_total);
+	tpmon_calc_flow_speed(tpmon, rx_bytes);
 	calc_rx_speed_internal(tpmon, &tpmon->rx_tcp);
 	calc_rx_speed_internal(tpmon, &tpmon->rx_udp);
 	calc_rx_speed_internal(tpmon, &tpmon->rx_others);
@@ -207,6 +377,161 @@ static void tpmon_calc_rx_speed(struct cpif_tpmon *tpmon)
 	spin_unlock_irqrestore(&tpmon->lock, flags);
 }
 
+/*
+ * Predictor
+ * Forecasts the per-interval throughput so that boosting can start ahead
+ * of a ramp and hold through short dips. Values are in Mbps << PRED_SHIFT.
+ */
+#define TPMON_PRED_SHIFT	8
+
+static u32 tpmon_pred_ewma_update(struct cpif_tpmon *tpmon, u32 mbps)
+{
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+	s64 x = (s64)mbps << TPMON_PRED_SHIFT;
+
+	if (!pred->primed) {
+		pred->level = x;
+		pred->primed = true;
+	} else {
+		pred->level += div_s64((x - pred->level) * pred->alpha_percent, 100);
+	}
+
+	return (u32)(pred->level >> TPMON_PRED_SHIFT);
+}
+
+static u32 tpmon_pred_holt_update(struct cpif_tpmon *tpmon, u32 mbps)
+{
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+	s64 x = (s64)mbps << TPMON_PRED_SHIFT;
+	s64 prev_level, forecast;
+
+	if (!pred->primed) {
+		pred->level = x;
+		pred->trend = 0;
+		pred->primed = true;
+		return mbps;
+	}
+
+	prev_level = pred->level;
+	pred->level = div_s64(x * pred->alpha_percent +
+			(pred->level + pred->trend) * (100 - pred->alpha_percent), 100);
+	pred->trend = div_s64((pred->level - prev_level) * pred->beta_percent +
+			pred->trend * (100 - pred->beta_percent), 100);
+
+	forecast = pred->level + pred->trend * pred->horizon;
+	if (forecast < 0)
+		forecast = 0;
+
+	return (u32)(forecast >> TPMON_PRED_SHIFT);
+}
+
+static int tpmon_pred_cmp_u32(const void *a, const void *b)
+{
+	u32 l = *(const u32 *)a;
+	u32 r = *(const u32 *)b;
+
+	return (l > r) - (l < r);
+}
+
+static u32 tpmon_pred_percentile_update(struct cpif_tpmon *tpmon, u32 mbps)
+{
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+	u32 sorted[MAX_TPMON_PRED_WINDOW];
+
+	pred->window[pred->window_idx] = mbps;
+	pred->window_idx = (pred->window_idx + 1) % MAX_TPMON_PRED_WINDOW;
+	if (pred->window_cnt < MAX_TPMON_PRED_WINDOW)
+		pred->window_cnt++;
+
+	memcpy(sorted, pred->window, sizeof(u32) * pred->window_cnt);
+	sort(sorted, pred->window_cnt, sizeof(u32), tpmon_pred_cmp_u32, NULL);
+
+	return sorted[(pred->window_cnt - 1) * pred->percentile / 100];
+}
+
+static const struct tpmon_predictor tpmon_predictors[MAX_TPMON_PRED] = {
+	[TPMON_PRED_NONE] = { .name = "none", .update = NULL },
+	[TPMON_PRED_EWMA] = { .name = "ewma", .update = tpmon_pred_ewma_update },
+	[TPMON_PRED_HOLT] = { .name = "holt", .update = tpmon_pred_holt_update },
+	[TPMON_PRED_PERCENTILE] = { .name = "percentile", .update = tpmon_pred_percentile_update },
+};
+
+static void tpmon_pred_reset(struct cpif_tpmon *tpmon)
+{
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+
+	pred->primed = false;
+	pred->level = 0;
+	pred->trend = 0;
+	pred->window_idx = 0;
+	pred->window_cnt = 0;
+	pred->predicted_mbps = 0;
+}
+
+static void tpmon_pred_record(struct cpif_tpmon *tpmon, u8 event, struct tpmon_data *data)
+{
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+	struct tpmon_pred_record *rec;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tpmon->lock, flags);
+
+	rec = &pred->record[pred->record_head];
+	rec->time_ns = ktime_get_ns();
+	rec->event = event;
+	rec->measured_mbps = (u32)tpmon->rx_interval_mbps;
+	rec->predicted_mbps = pred->predicted_mbps;
+	rec->data_idx = data ? (u8)(data - tpmon->data) : 0;
+	rec->prev_value_pos = data ? (u8)data->prev_value_pos : 0;
+	rec->curr_value_pos = data ? (u8)data->curr_value_pos : 0;
+
+	pred->record_head = (pred->record_head + 1) % MAX_TPMON_PRED_RECORD;
+	if (pred->record_cnt < MAX_TPMON_PRED_RECORD)
+		pred->record_cnt++;
+
+	spin_unlock_irqrestore(&tpmon->lock, flags);
+}
+
+static void tpmon_pred_update(struct cpif_tpmon *tpmon)
+{
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+
+	if (!pred->ops || !pred->ops->update)
+		return;
+
+	pred->predicted_mbps = pred->ops->update(tpmon, (u32)tpmon->rx_interval_mbps);
+	tpmon_pred_record(tpmon, TPMON_PRED_EVENT_SAMPLE, NULL);
+}
+
+/*
+ * Forecast of @usage for the next interval. The predictor models the total
+ * rate, so a per-protocol or per-flow usage is scaled by the expected total
+ * increase. The measured usage itself is left untouched.
+ */
+static int tpmon_pred_get_forecast_usage(struct cpif_tpmon *tpmon, int usage)
+{
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+
+	if (!pred->ops || !pred->ops->update || !tpmon->rx_interval_mbps)
+		return usage;
+
+	if (pred->predicted_mbps <= tpmon->rx_interval_mbps)
+		return usage;
+
+	return (int)min_t(u64, div_u64((u64)usage * pred->predicted_mbps,
+				       tpmon->rx_interval_mbps), INT_MAX);
+}
+
+static unsigned long tpmon_pred_get_unboost_mbps(struct cpif_tpmon *tpmon)
+{
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+
+	if (!pred->ops || !pred->ops->update)
+		return tpmon->rx_total.rx_mbps;
+
+	return max_t(unsigned long, tpmon->rx_total.rx_mbps, pred->predicted_mbps);
+}
+
 /* Inforamtion */
 static void tpmon_print_info(struct cpif_tpmon *tpmon)
 {
@@ -237,6 +562,39 @@ static void tpmon_print_info(struct cpif_tpmon *tpmon)
 }
 
 /* Check speed changing */
+static bool tpmon_check_udp_dominant(struct cpif_tpmon *tpmon)
+{
+	unsigned long udp_mbps = 0;
+	int i;
+
+	if (!tpmon->num_top_flow)
+		return (tpmon->rx_udp.rx_mbps > tpmon->trigger_mbps) &&
+			(tpmon->rx_udp.rx_mbps >
+			(tpmon->rx_tcp.rx_mbps + tpmon->rx_others.rx_mbps));
+
+	/* Only UDP elephant flows count, not the aggregate UDP traffic */
+	for (i = 0; i < tpmon->num_top_flow; i++)
+		if (tpmon->top_flow[i].proto == IPPROTO_UDP)
+			udp_mbps += tpmon->top_flow[i].rx_mbps;
+
+	if (udp_mbps <= tpmon->trigger_mbps)
+		return false;
+
+	return udp_mbps > (tpmon->rx_interval_mbps - min(udp_mbps, tpmon->rx_interval_mbps));
+}
+
+/* number of thresholds @usage reaches */
+static int tpmon_get_threshold_pos(struct tpmon_data *data, int usage)
+{
+	int i;
+
+	for (i = 0; i < data->num_threshold; i++)
+		if (usage < data->threshold[i])
+			break;
+
+	return i;
+}
+
 static bool tpmon_check_to_boost(struct tpmon_data *data)
 {
 	struct tpmon_data *data_list;
@@ -265,10 +623,7 @@ static bool tpmon_check_to_boost(struct tpmon_data *data)
 		}
 	}
 
-	if (data->check_udp &&
-		(data->tpmon->rx_udp.rx_mbps > data->tpmon->trigger_mbps) &&
-		(data->tpmon->rx_udp.rx_mbps >
-		(data->tpmon->rx_tcp.rx_mbps + data->tpmon->rx_others.rx_mbps))) {
+	if (data->check_udp && tpmon_check_udp_dominant(data->tpmon)) {
 		data->forced_unboost = true;
 		return false;
 	}
@@ -280,9 +635,10 @@ static bool tpmon_check_to_boost(struct tpmon_data *data)
 		return false;
 	}
 
-	for (i = 0; i < data->num_threshold; i++)
-		if (usage < data->threshold[i])
-			break;
+	i = tpmon_get_threshold_pos(data, usage);
+	if (data->measure == TPMON_MEASURE_TP)
+		i = max(i, tpmon_get_threshold_pos(data,
+				tpmon_pred_get_forecast_usage(data->tpmon, usage)));
 
 	if (i <= data->curr_value_pos)
 		return false;
@@ -341,7 +697,7 @@ static bool tpmon_check_to_unboost(struct tpmon_data *data)
 		return false;
 	}
 
-	if ((data->tpmon->rx_total.rx_mbps >=
+	if ((tpmon_pred_get_unboost_mbps(data->tpmon) >=
 		data->unboost_tp_mbps[data->curr_threshold_pos])) {
 		if (!data->forced_unboost) {
 			data->jiffies_to_unboost = jiffies_curr;
@@ -649,6 +1005,27 @@ static void tpmon_set_irq_affinity_dit(struct tpmon_data *data)
 
 	dit_set_irq_affinity(cpu_num);
 }
+
+static void tpmon_set_irq_affinity_dit_ring(struct tpmon_data *data)
+{
+	u32 cpu_num;
+
+	if (!data->enable)
+		return;
+
+	cpu_num = data->tpmon->use_user_value ? data->user_value :
+				data->values[data->curr_value_pos];
+
+	if (dit_get_rx_ring_irq_affinity(data->extra_idx) == cpu_num) {
+		mif_info("skip to set same cpu_num for %s (CPU:%d)\n",
+			data->name, cpu_num);
+		return;
+	}
+
+	mif_info("%s (ring:%d CPU:%d)\n", data->name, data->extra_idx, cpu_num);
+
+	dit_set_rx_ring_irq_affinity(data->extra_idx, cpu_num);
+}
 #endif
 
 /* Frequency */
@@ -791,6 +1168,7 @@ static void tpmon_monitor_work(struct work_struct *ws)
 
 	if (tpmon_check_active()) {
 		tpmon_calc_rx_speed(tpmon);
+		tpmon_pred_update(tpmon);
 		tpmon_print_info(tpmon);
 	}
 
@@ -803,6 +1181,7 @@ static void tpmon_monitor_work(struct work_struct *ws)
 
 			if (tpmon_check_to_boost(data)) {
 				data->set_data(data);
+				tpmon_pred_record(tpmon, TPMON_PRED_EVENT_BOOST, data);
 				continue;
 			}
 		}
@@ -833,11 +1212,14 @@ static void tpmon_monitor_work(struct work_struct *ws)
 
 		if (tpmon_check_to_boost(data)) {
 			data->set_data(data);
+			tpmon_pred_record(tpmon, TPMON_PRED_EVENT_BOOST, data);
 			continue;
 		}
 
-		if (tpmon_check_to_unboost(data))
+		if (tpmon_check_to_unboost(data)) {
 			data->set_data(data);
+			tpmon_pred_record(tpmon, TPMON_PRED_EVENT_UNBOOST, data);
+		}
 	}
 
 	if (atomic_read(&tpmon->need_urgent))
@@ -882,7 +1264,6 @@ void tpmon_add_rx_bytes(struct sk_buff *skb)
 {
 	struct cpif_tpmon *tpmon = &_tpmon;
 	u16 proto = 0;
-	unsigned long flags;
 
 	switch (ip_hdr(skb)->version) {
 	case 4:
@@ -897,26 +1278,24 @@ void tpmon_add_rx_bytes(struct sk_buff *skb)
 		return;
 	}
 
-	spin_lock_irqsave(&tpmon->lock, flags);
-	if (tpmon->rx_bytes_skip_add)
-		goto skip_add;
+	if (unlikely(!tpmon->rx_pcpu))
+		return;
 
-	tpmon->rx_total.rx_bytes += skb->len;
+	this_cpu_add(tpmon->rx_pcpu->total, skb->len);
 
 	switch (proto) {
 	case IPPROTO_TCP:
-		tpmon->rx_tcp.rx_bytes += skb->len;
+		this_cpu_add(tpmon->rx_pcpu->tcp, skb->len);
 		break;
 	case IPPROTO_UDP:
-		tpmon->rx_udp.rx_bytes += skb->len;
+		this_cpu_add(tpmon->rx_pcpu->udp, skb->len);
 		break;
 	default:
-		tpmon->rx_others.rx_bytes += skb->len;
+		this_cpu_add(tpmon->rx_pcpu->others, skb->len);
 		break;
 	}
 
-skip_add:
-	spin_unlock_irqrestore(&tpmon->lock, flags);
+	tpmon_add_flow_bytes(tpmon, skb, proto);
 }
 EXPORT_SYMBOL(tpmon_add_rx_bytes);
 
@@ -963,6 +1342,11 @@ static int tpmon_init_params(struct cpif_tpmon *tpmon)
 	memset(&tpmon->rx_tcp, 0, sizeof(struct cpif_rx_data));
 	memset(&tpmon->rx_udp, 0, sizeof(struct cpif_rx_data));
 	memset(&tpmon->rx_others, 0, sizeof(struct cpif_rx_data));
+	tpmon_fold_rx_bytes(tpmon, true);
+
+	tpmon->num_top_flow = 0;
+	tpmon->rx_interval_mbps = 0;
+	tpmon_pred_reset(tpmon);
 
 	tpmon->pktproc_queue_status = 0;
 	tpmon->netdev_backlog_queue_status = 0;
@@ -1034,6 +1418,8 @@ static bool tpmon_check_to_start(struct cpif_tpmon *tpmon)
 	u64 delta_msec;
 	unsigned long flags;
 
+	tpmon_fold_rx_bytes(tpmon, false);
+
 	jiffies_curr = get_jiffies_64();
 	if (!tpmon->jiffies_to_trigger) {
 		tpmon->jiffies_to_trigger = jiffies_curr;
@@ -1101,6 +1487,7 @@ static bool tpmon_check_to_start(struct cpif_tpmon *tpmon)
 	spin_unlock_irqrestore(&tpmon->lock, flags);
 
 	tpmon->rx_bytes_valid_cnt = 0;
+	WRITE_ONCE(tpmon->flow_epoch, tpmon->flow_epoch + 1);
 
 	return true;
 }
@@ -1301,6 +1688,14 @@ static ssize_t status_show(struct device *dev, struct device_attribute *attr, ch
 			tpmon->dit_src_queue_status,
 			tpmon->netdev_backlog_queue_status,
 			tpmon->legacy_packet_count);
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			"top flows:%d interval:%ldMbps\n",
+			tpmon->num_top_flow, tpmon->rx_interval_mbps);
+	for (i = 0; i < tpmon->num_top_flow; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+			"  hash:0x%08x proto:%d %ldMbps\n",
+			tpmon->top_flow[i].hash, tpmon->top_flow[i].proto,
+			tpmon->top_flow[i].rx_mbps);
 	len += scnprintf(buf + len, PAGE_SIZE - len,
 			"use_user_value:%d debug_print:%d\n",
 			tpmon->use_user_value,
@@ -1436,6 +1831,77 @@ static ssize_t set_user_value_store(struct device *dev, struct device_attribute
 }
 static DEVICE_ATTR_WO(set_user_value);
 
+static ssize_t predictor_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct cpif_tpmon *tpmon = &_tpmon;
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+	ssize_t len = 0;
+	int i;
+
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			"predictor:%s alpha:%d beta:%d horizon:%d percentile:%d\n",
+			pred->ops ? pred->ops->name : "none",
+			pred->alpha_percent, pred->beta_percent,
+			pred->horizon, pred->percentile);
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			"predicted:%dMbps measured:%ldMbps\n",
+			pred->predicted_mbps, tpmon->rx_interval_mbps);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "available:");
+	for (i = 0; i < MAX_TPMON_PRED; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, " %s",
+				tpmon_predictors[i].name);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	return len;
+}
+
+static ssize_t predictor_store(struct device *dev, struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct cpif_tpmon *tpmon = &_tpmon;
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+	u32 alpha = pred->alpha_percent;
+	u32 beta = pred->beta_percent;
+	u32 horizon = pred->horizon;
+	u32 percentile = pred->percentile;
+	char name[20];
+	int ret;
+	int i;
+
+	ret = sscanf(buf, "%19s %u %u %u %u", name, &alpha, &beta, &horizon, &percentile);
+	if (ret < 1)
+		return -EINVAL;
+
+	if (alpha > 100 || beta > 100 || percentile > 100)
+		return -EINVAL;
+
+	for (i = 0; i < MAX_TPMON_PRED; i++)
+		if (strcmp(tpmon_predictors[i].name, name) == 0)
+			break;
+
+	if (i == MAX_TPMON_PRED)
+		return -EINVAL;
+
+	cancel_delayed_work_sync(&tpmon->monitor_dwork);
+
+	pred->type = i;
+	pred->ops = &tpmon_predictors[i];
+	pred->alpha_percent = alpha;
+	pred->beta_percent = beta;
+	pred->horizon = horizon;
+	pred->percentile = percentile;
+	tpmon_pred_reset(tpmon);
+
+	if (tpmon_check_active() || atomic_read(&tpmon->need_init))
+		queue_delayed_work(tpmon->monitor_wq, &tpmon->monitor_dwork, 0);
+
+	mif_info("predictor:%s alpha:%d beta:%d horizon:%d percentile:%d\n",
+		pred->ops->name, alpha, beta, horizon, percentile);
+
+	return count;
+}
+static DEVICE_ATTR_RW(predictor);
+
 static struct attribute *tpmon_attrs[] = {
 	&dev_attr_dt_value.attr,
 	&dev_attr_curr_value.attr,
@@ -1443,6 +1909,7 @@ static struct attribute *tpmon_attrs[] = {
 	&dev_attr_use_user_value.attr,
 	&dev_attr_debug_print.attr,
 	&dev_attr_set_user_value.attr,
+	&dev_attr_predictor.attr,
 	NULL,
 };
 
@@ -1451,6 +1918,51 @@ static const struct attribute_group tpmon_group = {
 	.name = "tpmon",
 };
 
+/*
+ * debugfs
+ */
+static const char * const tpmon_pred_event_str[] = {
+	[TPMON_PRED_EVENT_SAMPLE] = "sample",
+	[TPMON_PRED_EVENT_BOOST] = "boost",
+	[TPMON_PRED_EVENT_UNBOOST] = "unboost",
+};
+
+static int tpmon_decisions_show(struct seq_file *s, void *unused)
+{
+	struct cpif_tpmon *tpmon = s->private;
+	struct cpif_tpmon_pred *pred = &tpmon->pred;
+	struct tpmon_pred_record *rec;
+	unsigned long flags;
+	u32 i, idx;
+
+	seq_printf(s, "predictor:%s\n", pred->ops ? pred->ops->name : "none");
+	seq_puts(s, "time_ns event measured_mbps predicted_mbps name pos\n");
+
+	spin_lock_irqsave(&tpmon->lock, flags);
+	for (i = 0; i < pred->record_cnt; i++) {
+		idx = (pred->record_head + MAX_TPMON_PRED_RECORD - pred->record_cnt + i) %
+			MAX_TPMON_PRED_RECORD;
+		rec = &pred->record[idx];
+
+		if (rec->event == TPMON_PRED_EVENT_SAMPLE) {
+			seq_printf(s, "%llu %s %u %u - -\n",
+				rec->time_ns, tpmon_pred_event_str[rec->event],
+				rec->measured_mbps, rec->predicted_mbps);
+			continue;
+		}
+
+		seq_printf(s, "%llu %s %u %u %s %u->%u\n",
+			rec->time_ns, tpmon_pred_event_str[rec->event],
+			rec->measured_mbps, rec->predicted_mbps,
+			tpmon->data[rec->data_idx].name,
+			rec->prev_value_pos, rec->curr_value_pos);
+	}
+	spin_unlock_irqrestore(&tpmon->lock, flags);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(tpmon_decisions);
+
 /*
  * Init
  */
@@ -1466,6 +1978,9 @@ static void tpmon_parse_protocol(struct tpmon_data *data)
 	case TPMON_PROTO_OTHERS:
 		data->get_data = tpmon_get_rx_others_speed_mbps;
 		break;
+	case TPMON_PROTO_FLOW:
+		data->get_data = tpmon_get_rx_flow_speed_mbps;
+		break;
 	case TPMON_PROTO_ALL:
 	default:
 		data->get_data = tpmon_get_rx_total_speed_mbps;
@@ -1516,6 +2031,27 @@ static int tpmon_parse_dt(struct device_node *np, struct cpif_tpmon *tpmon)
 			tpmon->monitor_interval_msec, tpmon->boost_hold_msec,
 			tpmon->unboost_tp_percent);
 
+	tpmon->pred.type = TPMON_PRED_NONE;
+	tpmon->pred.alpha_percent = 50;
+	tpmon->pred.beta_percent = 30;
+	tpmon->pred.horizon = 2;
+	tpmon->pred.percentile = 90;
+	of_property_read_u32(tpmon_np, "tpmon_predictor", &tpmon->pred.type);
+	of_property_read_u32(tpmon_np, "tpmon_predictor_alpha", &tpmon->pred.alpha_percent);
+	of_property_read_u32(tpmon_np, "tpmon_predictor_beta", &tpmon->pred.beta_percent);
+	of_property_read_u32(tpmon_np, "tpmon_predictor_horizon", &tpmon->pred.horizon);
+	of_property_read_u32(tpmon_np, "tpmon_predictor_percentile", &tpmon->pred.percentile);
+	if (tpmon->pred.type >= MAX_TPMON_PRED)
+		tpmon->pred.type = TPMON_PRED_NONE;
+	tpmon->pred.alpha_percent = min_t(u32, tpmon->pred.alpha_percent, 100);
+	tpmon->pred.beta_percent = min_t(u32, tpmon->pred.beta_percent, 100);
+	tpmon->pred.percentile = min_t(u32, tpmon->pred.percentile, 100);
+	tpmon->pred.ops = &tpmon_predictors[tpmon->pred.type];
+	mif_info("predictor:%s alpha:%d beta:%d horizon:%d percentile:%d\n",
+			tpmon->pred.ops->name, tpmon->pred.alpha_percent,
+			tpmon->pred.beta_percent, tpmon->pred.horizon,
+			tpmon->pred.percentile);
+
 	for_each_child_of_node(tpmon_np, child_np) {
 		if (count >= MAX_TPMON_DATA) {
 			mif_err("count is full:%d\n", count);
@@ -1630,6 +2166,9 @@ static int tpmon_parse_dt(struct device_node *np, struct cpif_tpmon *tpmon)
 		case TPMON_TARGET_IRQ_DIT:
 			data->set_data = tpmon_set_irq_affinity_dit;
 			break;
+		case TPMON_TARGET_IRQ_DIT_RING:
+			data->set_data = tpmon_set_irq_affinity_dit_ring;
+			break;
 #endif
 
 #if IS_ENABLED(CONFIG_EXYNOS_BTS)
@@ -1773,6 +2312,16 @@ int tpmon_create(struct platform_device *pdev, struct link_device *ld)
 	spin_lock_init(&tpmon->lock);
 	atomic_set(&tpmon->active, 0);
 
+	tpmon->rx_pcpu = alloc_percpu(struct cpif_rx_pcpu);
+	tpmon->flow_pcpu = alloc_percpu(struct cpif_flow_pcpu);
+	tpmon->flow_merge = kcalloc(num_possible_cpus() * MAX_TPMON_FLOW_SLOTS,
+				sizeof(struct cpif_flow_info), GFP_KERNEL);
+	if (!tpmon->rx_pcpu || !tpmon->flow_pcpu || !tpmon->flow_merge) {
+		mif_err("failed to alloc rx counters\n");
+		ret = -ENOMEM;
+		goto create_error;
+	}
+
 	INIT_LIST_HEAD(&tpmon->data_list);
 	INIT_LIST_HEAD(&tpmon->urgent_data_list);
 
@@ -1820,11 +2369,35 @@ int tpmon_create(struct platform_device *pdev, struct link_device *ld)
 	if (sysfs_create_group(&pdev->dev.kobj, &tpmon_group))
 		mif_err("failed to create cpif tpmon groups node\n");
 
+	tpmon->dbgfs_dir = debugfs_create_dir("cpif_tpmon", NULL);
+	debugfs_create_file("decisions", 0400, tpmon->dbgfs_dir, tpmon,
+			&tpmon_decisions_fops);
+
 	return ret;
 
 create_error:
 	mif_err("Error:%d\n", ret);
 
+	kfree(tpmon->flow_merge);
+	tpmon->flow_merge = NULL;
+	free_percpu(tpmon->flow_pcpu);
+	tpmon->flow_pcpu = NULL;
+	free_percpu(tpmon->rx_pcpu);
+	tpmon->rx_pcpu = NULL;
+
 	return ret;
 }
 EXPORT_SYMBOL(tpmon_create);
+
+void tpmon_destroy(struct platform_device *pdev)
+{
+	struct cpif_tpmon *tpmon = &_tpmon;
+
+	if (!tpmon->dbgfs_dir)
+		return;
+
+	debugfs_remove_recursive(tpmon->dbgfs_dir);
+	tpmon->dbgfs_dir = NULL;
+	sysfs_remove_group(&pdev->dev.kobj, &tpmon_group);
+}
+EXPORT_SYMBOL(tpmon_destroy);
@@ -26,6 +26,10 @@
 #define MAX_IRQ_AFFINITY_DATA	5
 #define MAX_IRQ_AFFINITY_STRING	8
 #define MAX_RX_BYTES_COUNT	1000
+#define MAX_TPMON_FLOW_SLOTS	16
+#define MAX_TPMON_TOP_FLOWS	4
+#define MAX_TPMON_PRED_WINDOW	16
+#define MAX_TPMON_PRED_RECORD	256
 
 struct tpmon_data {
 	struct cpif_tpmon *tpmon;
@@ -64,8 +68,41 @@ struct tpmon_data {
 	u32 (*get_data)(struct tpmon_data *data);
 };
 
+/* Per-CPU RX byte counters. Only increased by the owning CPU */
+struct cpif_rx_pcpu {
+	unsigned long total;
+	unsigned long tcp;
+	unsigned long udp;
+	unsigned long others;
+};
+
+/* Per-CPU space-saving table of the heaviest flows by 5-tuple hash */
+struct cpif_flow_slot {
+	u32 hash;
+	u8 proto;
+	unsigned long bytes;
+};
+
+/*
+ * Double buffered by epoch parity: packets fill slot[epoch & 1] while the
+ * monitor merges the table of the previous epoch from the other half.
+ * epoch[i] is the epoch whose packets slot[i] holds.
+ */
+struct cpif_flow_pcpu {
+	u32 epoch[2];
+	struct cpif_flow_slot slot[2][MAX_TPMON_FLOW_SLOTS];
+};
+
+struct cpif_flow_info {
+	u32 hash;
+	u8 proto;
+	unsigned long rx_bytes;
+	unsigned long rx_mbps;
+};
+
 struct cpif_rx_data {
 	unsigned long rx_bytes;
+	unsigned long rx_bytes_folded;	/* Sum of per-CPU counters at the last fold */
 	unsigned long rx_mbps;
 	unsigned long rx_kbps;
 	unsigned long rx_sum;
@@ -73,6 +110,63 @@ struct cpif_rx_data {
 	u32 rx_bytes_idx;
 };
 
+/* Throughput predictor */
+enum tpmon_pred_type {
+	TPMON_PRED_NONE,
+	TPMON_PRED_EWMA,
+	TPMON_PRED_HOLT,
+	TPMON_PRED_PERCENTILE,
+	MAX_TPMON_PRED
+};
+
+enum tpmon_pred_event {
+	TPMON_PRED_EVENT_SAMPLE,
+	TPMON_PRED_EVENT_BOOST,
+	TPMON_PRED_EVENT_UNBOOST,
+};
+
+struct tpmon_pred_record {
+	u64 time_ns;
+	u32 measured_mbps;
+	u32 predicted_mbps;
+	u8 event;
+	u8 data_idx;
+	u8 prev_value_pos;
+	u8 curr_value_pos;
+};
+
+struct cpif_tpmon;
+
+struct tpmon_predictor {
+	const char *name;
+	u32 (*update)(struct cpif_tpmon *tpmon, u32 mbps);
+};
+
+struct cpif_tpmon_pred {
+	u32 type;
+	const struct tpmon_predictor *ops;
+
+	/* Params */
+	u32 alpha_percent;	/* Level smoothing */
+	u32 beta_percent;	/* Trend smoothing for Holt */
+	u32 horizon;		/* Intervals ahead for Holt */
+	u32 percentile;		/* Percentile of the window */
+
+	/* State in fixed point */
+	bool primed;
+	s64 level;
+	s64 trend;
+	u32 window[MAX_TPMON_PRED_WINDOW];
+	u32 window_idx;
+	u32 window_cnt;
+	u32 predicted_mbps;
+
+	/* Decision log */
+	struct tpmon_pred_record record[MAX_TPMON_PRED_RECORD];
+	u32 record_head;
+	u32 record_cnt;
+};
+
 struct cpif_tpmon {
 	struct link_device *ld;
 
@@ -110,6 +204,15 @@ struct cpif_tpmon {
 	unsigned int rx_bytes_len;
 	u32 rx_bytes_valid_cnt;
 	bool rx_bytes_skip_add;
+	struct cpif_rx_pcpu __percpu *rx_pcpu;
+
+	/* Top-K flows of the last monitor interval */
+	struct cpif_flow_pcpu __percpu *flow_pcpu;
+	u32 flow_epoch;
+	struct cpif_flow_info *flow_merge;
+	struct cpif_flow_info top_flow[MAX_TPMON_TOP_FLOWS];
+	u32 num_top_flow;
+	unsigned long rx_interval_mbps;
 
 	u32 pktproc_queue_status;
 	u32 netdev_backlog_queue_status;
@@ -119,6 +222,9 @@ struct cpif_tpmon {
 	u32 use_user_value;
 	u32 debug_print;
 
+	struct cpif_tpmon_pred pred;
+	struct dentry *dbgfs_dir;
+
 	struct tpmon_data data[MAX_TPMON_DATA];
 
 #if IS_ENABLED(CONFIG_EXYNOS_PM_QOS)
@@ -152,6 +258,7 @@ struct cpif_tpmon {
 
 #if IS_ENABLED(CONFIG_CPIF_TP_MONITOR)
 extern int tpmon_create(struct platform_device *pdev, struct link_device *ld);
+extern void tpmon_destroy(struct platform_device *pdev);
 extern int tpmon_start(void);
 extern int tpmon_stop(void);
 extern int tpmon_init(void);
@@ -161,6 +268,7 @@ extern void tpmon_add_net_node(struct list_head *node);
 extern int tpmon_check_active(void);
 #else
 static inline int tpmon_create(struct platform_device *pdev, struct link_device *ld) { return 0; }
+static inline void tpmon_destroy(struct platform_device *pdev) { return; }
 static inline int tpmon_start(void) { return 0; }
 static inline int tpmon_stop(void) { return 0; }
 static inline int tpmon_init(void) { return 0; }
@@ -862,7 +862,7 @@ static int dit_fill_rx_dst_data_buffer(enum dit_desc_ring ring_num, unsigned int
 
 			dst_skb[dst_rp_pos] = __netdev_alloc_skb(dc->netdev, buf_size, gfp_mask);
 		} else
-			dst_skb[dst_rp_pos] = napi_alloc_skb(&dc->napi, buf_size);
+			dst_skb[dst_rp_pos] = napi_alloc_skb(&dc->rx_ring[ring_num].napi, buf_size);
 
 		if (unlikely(!dst_skb[dst_rp_pos])) {
 			mif_err("dit dst[%d] skb[%d] build failed\n", ring_num, dst_rp_pos);
@@ -953,6 +953,25 @@ static int dit_get_dst_data_buffer_free_space(enum dit_direction dir)
 	return min;
 }
 
+static void dit_free_rx_skb_cache(struct dit_rx_ring *ring)
+{
+	while (ring->skb_cache_cnt)
+		dev_kfree_skb_any(ring->skb_cache[--ring->skb_cache_cnt]);
+}
+
+/* the cache is only touched by napi poll, so keep the poll off while freeing */
+static void dit_drop_rx_skb_cache(struct dit_rx_ring *ring)
+{
+	if (!ring->napi.dev) {
+		dit_free_rx_skb_cache(ring);
+		return;
+	}
+
+	napi_disable(&ring->napi);
+	dit_free_rx_skb_cache(ring);
+	napi_enable(&ring->napi);
+}
+
 int dit_manage_rx_dst_data_buffers(bool fill)
 {
 	int ring_num;
@@ -970,84 +989,137 @@ int dit_manage_rx_dst_data_buffers(bool fill)
 				dc->desc_info[DIT_DIR_RX].dst_wp[ring_num],
 				dc->desc_info[DIT_DIR_RX].dst_rp[ring_num]);
 			dit_set_dst_desc_int_range(DIT_DIR_RX, ring_num);
-		} else
+		} else {
 			ret = dit_free_dst_data_buffer(DIT_DIR_RX, ring_num);
+			if (!ret && dc->use_multi_napi)
+				dit_drop_rx_skb_cache(&dc->rx_ring[ring_num]);
+		}
 	}
 
 	return ret;
 }
 EXPORT_SYMBOL(dit_manage_rx_dst_data_buffers);
 
-int dit_read_rx_dst_poll(struct napi_struct *napi, int budget)
+/* allocate skbs for the next refill at once instead of one per desc */
+static void dit_fill_rx_skb_cache(struct dit_rx_ring *ring, unsigned int count)
+{
+	unsigned int buf_size = dc->desc_info[DIT_DIR_RX].buf_size;
+	struct sk_buff *skb;
+
+	count = min_t(unsigned int, count, ARRAY_SIZE(ring->skb_cache));
+	while (ring->skb_cache_cnt < count) {
+		skb = napi_alloc_skb(&ring->napi, buf_size);
+		if (unlikely(!skb)) {
+			ring->refill_fail++;
+			mif_err_limited("dit rx ring %d skb cache fill failed\n", ring->ring_num);
+			break;
+		}
+
+		ring->skb_cache[ring->skb_cache_cnt++] = skb;
+	}
+}
+
+static int dit_read_rx_dst_ring(struct dit_rx_ring *ring, enum dit_desc_ring ring_num,
+		int budget)
 {
 	struct dit_desc_info *desc_info = &dc->desc_info[DIT_DIR_RX];
 	struct dit_dst_desc *dst_desc;
-	struct sk_buff *skb;
-	unsigned int rcvd_total = 0;
+	struct sk_buff *skb, *new_skb;
 	unsigned int usage;
-	unsigned int ring_num;
-	int i, ret;
-#if IS_ENABLED(CONFIG_CPIF_TP_MONITOR)
-	struct mem_link_device *mld = to_mem_link_device(dc->ld);
-#endif
+	unsigned int rp;
+	int rcvd = 0;
+	int ret;
 
-	for (ring_num = DIT_DST_DESC_RING_0; ring_num < DIT_DST_DESC_RING_MAX; ring_num++) {
-		/* read from rp to wp */
-		usage = circ_get_usage(desc_info->dst_desc_ring_len,
-			desc_info->dst_wp[ring_num], desc_info->dst_rp[ring_num]);
-		for (i = 0; i < usage; i++) {
-			if (rcvd_total >= budget)
-				break;
+	if (unlikely(!desc_info->dst_skb_buf[ring_num]))
+		return 0;
 
-			/* get dst desc and skb */
-			dst_desc = &desc_info->dst_desc_ring[ring_num][desc_info->dst_rp[ring_num]];
-			skb = desc_info->dst_skb_buf[ring_num][desc_info->dst_rp[ring_num]];
+	/* read from rp to wp */
+	usage = circ_get_usage(desc_info->dst_desc_ring_len,
+		desc_info->dst_wp[ring_num], desc_info->dst_rp[ring_num]);
+	usage = min_t(unsigned int, usage, budget);
+	if (!usage)
+		return 0;
 
-			/* try to fill dst data buffers */
-			desc_info->dst_skb_buf[ring_num][desc_info->dst_rp[ring_num]] = NULL;
-			ret = dit_fill_rx_dst_data_buffer(ring_num, 1, false);
-			if (ret) {
-				desc_info->dst_skb_buf[ring_num][desc_info->dst_rp[ring_num]] = skb;
-				break;
-			}
+	dit_fill_rx_skb_cache(ring, usage);
 
-			/* set skb */
-			skb_put(skb, dst_desc->length);
-			skbpriv(skb)->lnk_hdr = 0;
-			skbpriv(skb)->sipc_ch = dst_desc->ch_id;
-			skbpriv(skb)->iod = link_get_iod_with_channel(dc->ld,
-					skbpriv(skb)->sipc_ch);
-			skbpriv(skb)->ld = dc->ld;
-			skbpriv(skb)->napi = napi;
-
-			/* clat */
-			if ((dst_desc->packet_info & BIT(DIT_PACKET_INFO_IPV6_BIT)) &&
-					((skb->data[0] & 0xFF) == 0x45)) {
-				skbpriv(skb)->rx_clat = 1;
-				snapshot[DIT_DIR_RX][ring_num].clat_packets++;
-			}
+	while (rcvd < usage) {
+		/* the dst desc must get a new buffer before the skb is passed */
+		if (unlikely(!ring->skb_cache_cnt))
+			break;
 
-			/* hw checksum */
-			dit_set_skb_checksum(dst_desc, ring_num, skb);
+		/* get dst desc and skb */
+		rp = desc_info->dst_rp[ring_num];
+		dst_desc = &desc_info->dst_desc_ring[ring_num][rp];
+		skb = desc_info->dst_skb_buf[ring_num][rp];
 
-			/* reset udp checksum if it was 0 */
-			dit_set_skb_udp_csum_zero(dst_desc, ring_num, skb);
+		new_skb = ring->skb_cache[--ring->skb_cache_cnt];
+		desc_info->dst_skb_buf[ring_num][rp] = new_skb;
+		dst_desc->dst_addr = virt_to_phys(new_skb->data);
+#if defined(DIT_DEBUG_LOW)
+		snapshot[DIT_DIR_RX][ring_num].alloc_skbs++;
+#endif
 
-			dst_desc->packet_info = 0;
-			dst_desc->status = 0;
+		/* set skb */
+		skb_put(skb, dst_desc->length);
+		skbpriv(skb)->lnk_hdr = 0;
+		skbpriv(skb)->sipc_ch = dst_desc->ch_id;
+		skbpriv(skb)->iod = link_get_iod_with_channel(dc->ld,
+				skbpriv(skb)->sipc_ch);
+		skbpriv(skb)->ld = dc->ld;
+		skbpriv(skb)->napi = &ring->napi;
+
+		/* clat */
+		if ((dst_desc->packet_info & BIT(DIT_PACKET_INFO_IPV6_BIT)) &&
+				((skb->data[0] & 0xFF) == 0x45)) {
+			skbpriv(skb)->rx_clat = 1;
+			snapshot[DIT_DIR_RX][ring_num].clat_packets++;
+		}
 
-			rcvd_total++;
+		/* hw checksum */
+		dit_set_skb_checksum(dst_desc, ring_num, skb);
 
-			/* update dst rp */
-			desc_info->dst_rp[ring_num] = circ_new_ptr(desc_info->dst_desc_ring_len,
-				desc_info->dst_rp[ring_num], 1);
+		/* reset udp checksum if it was 0 */
+		dit_set_skb_udp_csum_zero(dst_desc, ring_num, skb);
+
+		dst_desc->packet_info = 0;
+		dst_desc->status = 0;
+
+		rcvd++;
+
+		/* update dst rp */
+		desc_info->dst_rp[ring_num] = circ_new_ptr(desc_info->dst_desc_ring_len,
+			rp, 1);
 
 #if defined(DIT_DEBUG_LOW)
-			snapshot[DIT_DIR_RX][ring_num].alloc_skbs--;
+		snapshot[DIT_DIR_RX][ring_num].alloc_skbs--;
 #endif
-			ret = dit_pass_to_net(ring_num, skb);
-			if (ret < 0)
+		ret = dit_pass_to_net(ring_num, skb);
+		if (ret < 0)
+			break;
+	}
+
+	return rcvd;
+}
+
+int dit_read_rx_dst_poll(struct napi_struct *napi, int budget)
+{
+	struct dit_rx_ring *ring = container_of(napi, struct dit_rx_ring, napi);
+	unsigned int ring_num;
+	int rcvd_total = 0;
+#if IS_ENABLED(CONFIG_CPIF_TP_MONITOR)
+	struct mem_link_device *mld = to_mem_link_device(dc->ld);
+#endif
+
+	ring->polls++;
+
+	if (dc->use_multi_napi) {
+		rcvd_total = dit_read_rx_dst_ring(ring, ring->ring_num, budget);
+	} else {
+		for (ring_num = DIT_DST_DESC_RING_0; ring_num < DIT_DST_DESC_RING_MAX; ring_num++) {
+			if (rcvd_total >= budget)
 				break;
+
+			rcvd_total += dit_read_rx_dst_ring(ring, ring_num, budget - rcvd_total);
 		}
 	}
 
@@ -1056,8 +1128,9 @@ int dit_read_rx_dst_poll(struct napi_struct *napi, int budget)
 		mld->tpmon->start();
 #endif
 
-	if (atomic_read(&dc->stop_napi_poll)) {
-		atomic_set(&dc->stop_napi_poll, 0);
+	if (atomic_read(&ring->stop_napi_poll)) {
+		atomic_set(&ring->stop_napi_poll, 0);
+		dit_free_rx_skb_cache(ring);
 		napi_complete(napi);
 		/* kick can be reserved if dst buffer was not enough */
 		dit_kick(DIT_DIR_RX, true);
@@ -1170,9 +1243,17 @@ irqreturn_t dit_irq_handler(int irq, void *arg)
 		pending_mask = DIT_RX_INT_PENDING_MASK;
 
 		ring_num = (enum dit_desc_ring)(pending_bit - RX_DST0_INT_PENDING_BIT);
+
+		/* ring irqs can be steered to different cpus. src_rp is shared */
+		spin_lock(&dc->rx_dst_lock);
 		dit_update_dst_desc_pos(DIT_DIR_RX, ring_num);
-		if (napi_schedule_prep(&dc->napi))
-			__napi_schedule(&dc->napi);
+		spin_unlock(&dc->rx_dst_lock);
+
+		/* napi runs on the cpu that took the ring irq */
+		if (!dc->use_multi_napi)
+			ring_num = DIT_DST_DESC_RING_0;
+		if (napi_schedule_prep(&dc->rx_ring[ring_num].napi))
+			__napi_schedule(&dc->rx_ring[ring_num].napi);
 		break;
 	case TX_DST0_INT_PENDING_BIT:
 		dir = DIT_DIR_TX;
@@ -1729,6 +1810,14 @@ EXPORT_SYMBOL(dit_init);
 
 int dit_deinit(void)
 {
+	int ring_num;
+
+	if (unlikely(!dc))
+		return -EPERM;
+
+	for (ring_num = DIT_DST_DESC_RING_0; ring_num < DIT_DST_DESC_RING_MAX; ring_num++)
+		dit_drop_rx_skb_cache(&dc->rx_ring[ring_num]);
+
 	return 0;
 }
 EXPORT_SYMBOL(dit_deinit);
@@ -1820,6 +1909,17 @@ static ssize_t status_show(struct device *dev, struct device_attribute *attr, ch
 		}
 	}
 
+	count += scnprintf(&buf[count], PAGE_SIZE - count, "multi napi: %d\n",
+		dc->use_multi_napi);
+	for (ring_num = DIT_DST_DESC_RING_0; ring_num < DIT_DST_DESC_RING_MAX; ring_num++) {
+		struct dit_rx_ring *ring = &dc->rx_ring[ring_num];
+
+		count += scnprintf(&buf[count], PAGE_SIZE - count,
+			"  rx ring%d cpu: %d, polls: %llu, skb cache: %u, refill fail: %llu\n",
+			ring_num, ring->irq_affinity, ring->polls, ring->skb_cache_cnt,
+			ring->refill_fail);
+	}
+
 	return count;
 }
 
@@ -2154,25 +2254,36 @@ int dit_get_irq_affinity(void)
 }
 EXPORT_SYMBOL(dit_get_irq_affinity);
 
-int dit_set_irq_affinity(int affinity)
+static int dit_check_irq_affinity(int affinity)
 {
-	int i;
 	int num_cpu;
 
-	if (!dc)
-		return -EPERM;
-
 #if defined(CONFIG_VENDOR_NR_CPUS)
 	num_cpu = CONFIG_VENDOR_NR_CPUS;
 #else
 	num_cpu = 8;
 #endif
-	if (affinity >= num_cpu) {
+	if (affinity < 0 || affinity >= num_cpu) {
 		mif_err("affinity:%d error. cpu max:%d\n", affinity, num_cpu);
 		return -EINVAL;
 	}
 
+	return 0;
+}
+
+int dit_set_irq_affinity(int affinity)
+{
+	int i;
+
+	if (!dc)
+		return -EPERM;
+
+	if (dit_check_irq_affinity(affinity))
+		return -EINVAL;
+
 	dc->irq_affinity = affinity;
+	for (i = 0; i < DIT_DST_DESC_RING_MAX; i++)
+		dc->rx_ring[i].irq_affinity = affinity;
 
 	for (i = 0; i < dc->irq_len; i++) {
 		mif_debug("num:%d affinity:%d\n", dc->irq_buf[i], affinity);
@@ -2183,6 +2294,39 @@ int dit_set_irq_affinity(int affinity)
 }
 EXPORT_SYMBOL(dit_set_irq_affinity);
 
+int dit_get_rx_ring_irq_affinity(enum dit_desc_ring ring_num)
+{
+	if (!dc)
+		return -EPERM;
+
+	if (ring_num >= DIT_DST_DESC_RING_MAX)
+		return -EINVAL;
+
+	return dc->rx_ring[ring_num].irq_affinity;
+}
+EXPORT_SYMBOL(dit_get_rx_ring_irq_affinity);
+
+/* irq_buf starts with the rx dst ring irqs in ring order */
+int dit_set_rx_ring_irq_affinity(enum dit_desc_ring ring_num, int affinity)
+{
+	if (!dc)
+		return -EPERM;
+
+	if (ring_num >= DIT_DST_DESC_RING_MAX || ring_num >= dc->irq_len)
+		return -EINVAL;
+
+	if (dit_check_irq_affinity(affinity))
+		return -EINVAL;
+
+	dc->rx_ring[ring_num].irq_affinity = affinity;
+
+	mif_debug("ring:%d num:%d affinity:%d\n", ring_num, dc->irq_buf[ring_num], affinity);
+	irq_set_affinity_hint(dc->irq_buf[ring_num], cpumask_of(affinity));
+
+	return 0;
+}
+EXPORT_SYMBOL(dit_set_rx_ring_irq_affinity);
+
 int dit_set_buf_size(enum dit_direction dir, u32 size)
 {
 	struct dit_desc_info *desc_info = NULL;
@@ -2282,10 +2426,13 @@ EXPORT_SYMBOL(dit_get_netdev);
 
 int dit_stop_napi_poll(void)
 {
+	int ring_num;
+
 	if (!dc)
 		return -EPERM;
 
-	atomic_set(&dc->stop_napi_poll, 1);
+	for (ring_num = DIT_DST_DESC_RING_0; ring_num < DIT_DST_DESC_RING_MAX; ring_num++)
+		atomic_set(&dc->rx_ring[ring_num].stop_napi_poll, 1);
 
 	return 0;
 }
@@ -2310,6 +2457,7 @@ static int dit_read_dt(struct device_node *np)
 	mif_dt_read_bool(np, "dit_hal_linked", dc->hal_linked);
 	mif_dt_read_u32(np, "dit_rx_extra_desc_ring_len", dc->rx_extra_desc_ring_len);
 	mif_dt_read_u32(np, "dit_irq_affinity", dc->irq_affinity);
+	mif_dt_read_u32_noerr(np, "dit_use_multi_napi", dc->use_multi_napi);
 
 	return 0;
 }
@@ -2319,6 +2467,7 @@ int dit_create(struct platform_device *pdev)
 	struct device *dev = &pdev->dev;
 	struct device_node *np = dev->of_node;
 	struct resource *res;
+	int ring_num;
 	int ret;
 
 	if (!np) {
@@ -2365,9 +2514,13 @@ int dit_create(struct platform_device *pdev)
 	}
 
 	spin_lock_init(&dc->src_lock);
+	spin_lock_init(&dc->rx_dst_lock);
 	INIT_LIST_HEAD(&dc->reg_value_q);
 	atomic_set(&dc->init_running, 0);
-	atomic_set(&dc->stop_napi_poll, 0);
+	for (ring_num = DIT_DST_DESC_RING_0; ring_num < DIT_DST_DESC_RING_MAX; ring_num++) {
+		dc->rx_ring[ring_num].ring_num = ring_num;
+		atomic_set(&dc->rx_ring[ring_num].stop_napi_poll, 0);
+	}
 
 	dit_set_irq_affinity(dc->irq_affinity);
 	dev_set_drvdata(dev, dc);
@@ -2398,6 +2551,7 @@ int dit_create(struct platform_device *pdev)
 	mif_info("dit created. hw_ver:0x%08X, tx:%d, rx:%d, clat:%d, hal:%d, ext_len:%d, irq:%d\n",
 		dc->hw_version, dc->use_tx, dc->use_rx, dc->use_clat, dc->hal_linked,
 		dc->rx_extra_desc_ring_len, dc->irq_affinity);
+	mif_info("multi napi:%d\n", dc->use_multi_napi);
 
 	return 0;
 
@@ -2423,6 +2577,21 @@ static int dit_probe(struct platform_device *pdev)
 
 static int dit_remove(struct platform_device *pdev)
 {
+	int ring_num;
+
+	if (!dc)
+		return 0;
+
+	for (ring_num = DIT_DST_DESC_RING_0; ring_num < DIT_DST_DESC_RING_MAX; ring_num++) {
+		struct dit_rx_ring *ring = &dc->rx_ring[ring_num];
+
+		if (ring->napi.dev) {
+			napi_disable(&ring->napi);
+			netif_napi_del(&ring->napi);
+		}
+		dit_free_rx_skb_cache(ring);
+	}
+
 	return 0;
 }
 
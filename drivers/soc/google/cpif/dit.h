@@ -313,11 +313,29 @@ struct dit_desc_info {
 	bool dst_skb_buf_filled[DIT_DST_DESC_RING_MAX];
 };
 
+/* NAPI context for rx dst rings */
+struct dit_rx_ring {
+	struct napi_struct napi;
+	enum dit_desc_ring ring_num;
+	int irq_affinity;
+	atomic_t stop_napi_poll;
+
+	/* skbs allocated in a batch and not yet given to a dst desc */
+	struct sk_buff *skb_cache[NAPI_POLL_WEIGHT];
+	unsigned int skb_cache_cnt;
+
+	u64 polls;
+	u64 refill_fail;
+};
+
 struct dit_ctrl_t {
 	struct device *dev;
 	struct link_device *ld;
 	struct net_device *netdev;
-	struct napi_struct napi;
+	/* with use_multi_napi, each rx dst ring is polled by its own napi */
+	struct dit_rx_ring rx_ring[DIT_DST_DESC_RING_MAX];
+	bool use_multi_napi;
+	spinlock_t rx_dst_lock;
 	int *irq_buf;
 	int irq_len;
 	int irq_affinity;
@@ -347,7 +365,6 @@ struct dit_ctrl_t {
 	bool init_reserved;
 
 	atomic_t init_running;
-	atomic_t stop_napi_poll;
 
 #if defined(DIT_DEBUG_LOW)
 	int pktgen_ch;
@@ -414,6 +431,8 @@ int dit_read_rx_dst_poll(struct napi_struct *napi, int budget);
 int dit_manage_rx_dst_data_buffers(bool fill);
 int dit_get_irq_affinity(void);
 int dit_set_irq_affinity(int affinity);
+int dit_get_rx_ring_irq_affinity(enum dit_desc_ring ring_num);
+int dit_set_rx_ring_irq_affinity(enum dit_desc_ring ring_num, int affinity);
 int dit_set_buf_size(enum dit_direction dir, u32 size);
 int dit_set_pktproc_base(enum dit_direction dir, phys_addr_t base);
 int dit_set_desc_ring_len(enum dit_direction dir, u32 len);
@@ -61,6 +61,7 @@ int dit_net_init(struct dit_ctrl_t *dc)
 {
 	struct net_device *dev;
 	struct dit_net_priv *priv;
+	int ring_num;
 	int ret;
 
 	if (dc->netdev)
@@ -85,8 +86,16 @@ int dit_net_init(struct dit_ctrl_t *dc)
 	priv = netdev_priv(dev);
 	priv->dc = dc;
 
-	netif_napi_add(dc->netdev, &dc->napi, dit_read_rx_dst_poll, NAPI_POLL_WEIGHT);
-	napi_enable(&dc->napi);
+	for (ring_num = DIT_DST_DESC_RING_0; ring_num < DIT_DST_DESC_RING_MAX; ring_num++) {
+		struct dit_rx_ring *ring = &dc->rx_ring[ring_num];
+
+		/* ring 0 drains every dst ring without multi napi */
+		if (ring_num != DIT_DST_DESC_RING_0 && !dc->use_multi_napi)
+			break;
+
+		netif_napi_add(dc->netdev, &ring->napi, dit_read_rx_dst_poll, NAPI_POLL_WEIGHT);
+		napi_enable(&ring->napi);
+	}
 
 	return 0;
 }
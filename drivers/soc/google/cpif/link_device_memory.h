@@ -223,6 +223,10 @@ struct mem_link_device {
 	 * CP Binary size for CRC checking
 	 */
 	u32 cp_binary_size;
+	/* running CRC of the CP binary and the length it covers from the start */
+	u32 cp_binary_crc;
+	u32 cp_binary_crc_len;
+	void *cp_crc_bounce;
 
 	/**
 	 * (u32 *) syscp_alive[0] = Magic Code, Version
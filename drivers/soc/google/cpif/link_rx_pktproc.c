@@ -577,7 +577,7 @@ static int pktproc_get_pkt_from_sktbuf_mode(struct pktproc_queue *q, struct sk_b
 	}
 
 	/* Build skb */
-	if (q->use_memcpy) {
+	if (!q->zerocopy_quota) {
 		if (q->ppa->use_napi)
 			skb = napi_alloc_skb(q->napi_ptr, len);
 		else
@@ -606,6 +606,8 @@ static int pktproc_get_pkt_from_sktbuf_mode(struct pktproc_queue *q, struct sk_b
 		skb->head_frag = 0;
 		skb_reserve(skb, q->ppa->skb_padding_size);
 		skb_put(skb, len);
+		q->zerocopy_quota--;
+		q->stat.zerocopy_cnt++;
 	}
 
 	if (csum)
@@ -680,24 +682,48 @@ int pktproc_get_usage_fore_rear(struct pktproc_queue *q)
 	return usage;
 }
 
-static bool pktproc_check_memcpy_mode(struct pktproc_queue *q, u32 budget)
+/*
+ * Number of packets in this poll that can be handed up as zerocopy skbs.
+ * A zerocopy skb keeps its cell until the stack frees it, so only the free
+ * cells above what the refill needs are spent on zerocopy. The rest of the
+ * poll falls back to memcpy and returns its cells at once.
+ */
+static u32 pktproc_get_zerocopy_quota(struct pktproc_queue *q, u32 num_frames, u32 budget)
 {
+	struct pktproc_perftest *perf = &q->ppa->perftest;
+	u32 posted, free_cells;
+	u32 reserve = 0;
+
 	if (q->ppa->desc_mode != DESC_MODE_SKTBUF)
-		return true;
+		return 0;
 
 	if (!q->manager)
-		return true;
+		return 0;
 
 	if (!q->manager->enable_sw_zerocopy)
-		return true;
+		return 0;
 
-	if (q->manager->free_cell_count < budget)
-		return true;
+	if (unlikely(perf->test_run)) {
+		switch (perf->copy_mode) {
+		case PERFTEST_COPY_MEMCPY:
+			return 0;
+		case PERFTEST_COPY_ZEROCOPY:
+			return num_frames;
+		default:
+			break;
+		}
+	}
 
-	if (circ_get_space(q->num_desc, *q->rear_ptr, *q->fore_ptr) < budget)
-		return true;
+	/* Keep enough cells to bring the buffers posted to CP back up to budget */
+	posted = circ_get_space(q->num_desc, *q->rear_ptr, *q->fore_ptr);
+	if (posted < budget)
+		reserve = budget - posted;
 
-	return false;
+	free_cells = q->manager->free_cell_count;
+	if (free_cells <= reserve)
+		return 0;
+
+	return min_t(u32, num_frames, free_cells - reserve);
 }
 
 static int pktproc_clean_rx_ring(struct pktproc_queue *q, int budget, int *work_done)
@@ -717,7 +743,8 @@ static int pktproc_clean_rx_ring(struct pktproc_queue *q, int budget, int *work_
 	if (!num_frames)
 		return 0;
 
-	q->use_memcpy = pktproc_check_memcpy_mode(q, budget);
+	q->zerocopy_quota = pktproc_get_zerocopy_quota(q, num_frames, budget);
+	q->use_memcpy = (q->zerocopy_quota < num_frames);
 
 	pp_debug("Q%d num_frames:%d memcpy:%d %d/%d/%d\n",
 			q->q_idx, num_frames, q->use_memcpy,
@@ -899,6 +926,24 @@ static int pktproc_perftest_thread(void *arg)
 	return 0;
 }
 
+static void pktproc_perftest_get_stat(struct pktproc_adaptor *ppa,
+		u64 *pass_cnt, u64 *zerocopy_cnt, u64 *memcpy_cnt)
+{
+	int i;
+
+	*pass_cnt = 0;
+	*zerocopy_cnt = 0;
+	*memcpy_cnt = 0;
+
+	for (i = 0; i < ppa->num_queue; i++) {
+		struct pktproc_queue *q = ppa->q[i];
+
+		*pass_cnt += q->stat.pass_cnt;
+		*zerocopy_cnt += q->stat.zerocopy_cnt;
+		*memcpy_cnt += q->stat.use_memcpy_cnt;
+	}
+}
+
 static ssize_t perftest_store(struct device *dev,
 		struct device_attribute *attr,
 		const char *buf, size_t count)
@@ -938,6 +983,8 @@ static ssize_t perftest_store(struct device *dev,
 		perf->seq_counter[1] = 0;
 		perf->seq_counter[2] = 0;
 		perf->seq_counter[3] = 0;
+		if (perf->test_run)
+			perf->stop_time = ktime_get();
 		perf->test_run = false;
 		break;
 	case PERFTEST_MODE_IPV4:
@@ -946,6 +993,10 @@ static ssize_t perftest_store(struct device *dev,
 		if (perf->test_run)
 			kthread_stop(worker_task);
 
+		pktproc_perftest_get_stat(ppa, &perf->start_pass_cnt,
+			&perf->start_zerocopy_cnt, &perf->start_memcpy_cnt);
+		perf->start_time = ktime_get();
+		perf->packet_len = perftest_data[perf->mode].packet_len;
 		perf->test_run = true;
 		worker_task = kthread_create_on_node(pktproc_perftest_thread,
 			mld, cpu_to_node(cpu), "perftest", cpu);
@@ -985,9 +1036,61 @@ static ssize_t perftest_show(struct device *dev, struct device_attribute *attr,
 			perf->clat_ipv6[3], perf->clat_ipv6[4], perf->clat_ipv6[5],
 			perf->clat_ipv6[6], perf->clat_ipv6[7]);
 
+	count += scnprintf(&buf[count], PAGE_SIZE - count, "copy mode:%d\n", perf->copy_mode);
+
+	if (perf->start_time) {
+		u64 pass_cnt, zerocopy_cnt, memcpy_cnt, bytes;
+		s64 elapsed_us;
+
+		pktproc_perftest_get_stat(ppa, &pass_cnt, &zerocopy_cnt, &memcpy_cnt);
+		pass_cnt -= perf->start_pass_cnt;
+		zerocopy_cnt -= perf->start_zerocopy_cnt;
+		memcpy_cnt -= perf->start_memcpy_cnt;
+		elapsed_us = ktime_us_delta(perf->test_run ? ktime_get() : perf->stop_time,
+					perf->start_time);
+		bytes = pass_cnt * perf->packet_len;
+
+		count += scnprintf(&buf[count], PAGE_SIZE - count,
+			"result: elapsed_us:%lld pass:%llu zerocopy:%llu memcpy:%llu mbps:%llu\n",
+			elapsed_us, pass_cnt, zerocopy_cnt, memcpy_cnt,
+			elapsed_us > 0 ? div64_u64(bytes * 8, elapsed_us) : 0);
+	}
+
 	return count;
 }
 
+static ssize_t perftest_copy_mode_store(struct device *dev,
+		struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct modem_ctl *mc = dev_get_drvdata(dev);
+	struct link_device *ld = get_current_link(mc->iod);
+	struct mem_link_device *mld = to_mem_link_device(ld);
+	struct pktproc_adaptor *ppa = &mld->pktproc;
+	unsigned int mode;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &mode);
+	if (ret || mode >= PERFTEST_COPY_MAX)
+		return -EINVAL;
+
+	ppa->perftest.copy_mode = mode;
+
+	return count;
+}
+
+static ssize_t perftest_copy_mode_show(struct device *dev, struct device_attribute *attr,
+		char *buf)
+{
+	struct modem_ctl *mc = dev_get_drvdata(dev);
+	struct link_device *ld = get_current_link(mc->iod);
+	struct mem_link_device *mld = to_mem_link_device(ld);
+	struct pktproc_adaptor *ppa = &mld->pktproc;
+
+	return scnprintf(buf, PAGE_SIZE, "copy mode:%d (0:auto 1:memcpy 2:zerocopy)\n",
+		ppa->perftest.copy_mode);
+}
+
 /*
  * NAPI
  */
@@ -1171,6 +1274,9 @@ static ssize_t status_show(struct device *dev, struct device_attribute *attr, ch
 			"Buffer manager total/use/free:%d/%d/%d\n",
 			ppa->manager->cell_count, ppa->manager->used_cell_count,
 			ppa->manager->free_cell_count);
+		count += scnprintf(&buf[count], PAGE_SIZE - count,
+			"Buffer manager recycle put/get:%llu/%llu\n",
+			ppa->manager->recycle_put, ppa->manager->recycle_get);
 		count += scnprintf(&buf[count], PAGE_SIZE - count, "\n");
 	}
 
@@ -1202,10 +1308,17 @@ static ssize_t status_show(struct device *dev, struct device_attribute *attr, ch
 				circ_get_usage(q->num_desc, *q->fore_ptr, *q->rear_ptr),
 				circ_get_usage(q->num_desc, *q->rear_ptr, q->done_ptr),
 				circ_get_usage(q->num_desc, *q->rear_ptr, *q->fore_ptr));
-			if (!dit_check_dir_use_queue(DIT_DIR_RX, q->q_idx))
+			if (!dit_check_dir_use_queue(DIT_DIR_RX, q->q_idx)) {
+				u64 total = q->stat.zerocopy_cnt + q->stat.use_memcpy_cnt;
+
 				count += scnprintf(&buf[count], PAGE_SIZE - count,
 					"  use memcpy:%d count:%lld\n",
 					q->use_memcpy, q->stat.use_memcpy_cnt);
+				count += scnprintf(&buf[count], PAGE_SIZE - count,
+					"  zerocopy count:%lld ratio:%llu%%\n",
+					q->stat.zerocopy_cnt,
+					total ? div64_u64(q->stat.zerocopy_cnt * 100, total) : 0);
+			}
 			break;
 		default:
 			break;
@@ -1229,12 +1342,14 @@ static ssize_t status_show(struct device *dev, struct device_attribute *attr, ch
 static DEVICE_ATTR_RO(region);
 static DEVICE_ATTR_RO(status);
 static DEVICE_ATTR_RW(perftest);
+static DEVICE_ATTR_RW(perftest_copy_mode);
 static DEVICE_ATTR_RW(pktgen_gro);
 
 static struct attribute *pktproc_attrs[] = {
 	&dev_attr_region.attr,
 	&dev_attr_status.attr,
 	&dev_attr_perftest.attr,
+	&dev_attr_perftest_copy_mode.attr,
 	&dev_attr_pktgen_gro.attr,
 	NULL,
 };
@@ -1351,6 +1466,10 @@ static int pktproc_create_buffer_manager(struct pktproc_adaptor *ppa, u32 buff_s
 		return -ENOMEM;
 	}
 
+	/* Cells released by the network stack are recycled for the next refill */
+	if (init_mif_buff_recycle(ppa->manager, ppa->manager->cell_count))
+		mif_err("init_mif_buff_recycle() error. Use bitmap allocation only\n");
+
 	return 0;
 }
 
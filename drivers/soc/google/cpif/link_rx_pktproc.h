@@ -100,6 +100,7 @@ struct pktproc_statistics {
 	u64 err_bm_nomem;
 	u64 err_csum;
 	u64 use_memcpy_cnt;
+	u64 zerocopy_cnt;
 	u64 err_enqueue_dit;
 };
 
@@ -155,6 +156,7 @@ struct pktproc_queue {
 	struct mif_buff_mng *manager;	/* Pointer to buffer manager */
 	dma_addr_t *dma_addr;
 	bool use_memcpy;	/* memcpy mode on sktbuf mode */
+	u32 zerocopy_quota;	/* Packets left to build without memcpy in this poll */
 
 	/* IRQ */
 	int irq;
@@ -210,8 +212,22 @@ enum pktproc_perftest_mode {
 	PERFTEST_MODE_MAX
 };
 
+enum pktproc_perftest_copy_mode {
+	PERFTEST_COPY_AUTO,
+	PERFTEST_COPY_MEMCPY,
+	PERFTEST_COPY_ZEROCOPY,
+	PERFTEST_COPY_MAX
+};
+
 struct pktproc_perftest {
 	bool test_run;
+	enum pktproc_perftest_copy_mode copy_mode;
+	ktime_t start_time;
+	ktime_t stop_time;
+	u64 start_pass_cnt;
+	u64 start_zerocopy_cnt;
+	u64 start_memcpy_cnt;
+	u32 packet_len;
 	enum pktproc_perftest_mode mode;
 	int session;
 	u16 ch;
@@ -11,6 +11,60 @@
 #include "link_device_memory.h"
 #include "dit.h"
 
+/*
+ * Write a packet larger than max_packet_size over nr_desc consecutive
+ * descriptors. Every descriptor points to its own buffer slot and carries
+ * seg_on with its position in the chain, and total_pkt_size of the whole
+ * packet. done_ptr is moved only after the whole chain is written so that
+ * CP never sees a partial chain.
+ */
+static int pktproc_send_seg_pkt_to_cp(struct pktproc_queue_ul *q, struct sk_buff *skb,
+		u32 nr_desc)
+{
+	struct pktproc_desc_ul *desc;
+	u32 max_size = q->ppa_ul->max_packet_size;
+	u32 ptr = q->done_ptr;
+	u32 offset = 0;
+	u32 size;
+	u32 i;
+
+	for (i = 0; i < nr_desc; i++) {
+		size = min_t(u32, skb->len - offset, max_size);
+		if (skb_copy_bits(skb, offset, q->q_buff_vbase + (ptr * max_size), size))
+			return -EINVAL;
+
+		desc = &q->desc_ul[ptr];
+		desc->sktbuf_point = q->buff_addr_cp + (ptr * max_size);
+		desc->data_size = size;
+		desc->total_pkt_size = skb->len;
+		desc->last_desc = 0;
+		desc->seg_on = 1;
+		if (i == 0)
+			desc->segment = PKTPROC_UL_SEG_FIRST;
+		else if (i == nr_desc - 1)
+			desc->segment = PKTPROC_UL_SEG_LAST;
+		else
+			desc->segment = PKTPROC_UL_SEG_MIDDLE;
+		desc->hw_set = 0;
+		desc->lcid = skbpriv(skb)->sipc_ch;
+
+		offset += size;
+		ptr = circ_new_ptr(q->num_desc, ptr, 1);
+	}
+
+	barrier();
+
+	q->stat.seg_cnt++;
+	q->stat.tx_pkts++;
+	q->stat.tx_bytes += skb->len;
+	q->done_ptr = ptr;
+
+	/* ensure the done_ptr ordering */
+	smp_mb();
+
+	return skb->len;
+}
+
 static int pktproc_send_pkt_to_cp(struct pktproc_queue_ul *q, struct sk_buff *skb)
 {
 	struct pktproc_q_info_ul *q_info = q->q_info;
@@ -19,6 +73,7 @@ static int pktproc_send_pkt_to_cp(struct pktproc_queue_ul *q, struct sk_buff *sk
 	int len = skb->len;
 	int ret;
 	bool use_dit;
+	u32 nr_desc = 1;
 	u32 space;
 
 	q->stat.total_cnt++;
@@ -28,20 +83,26 @@ static int pktproc_send_pkt_to_cp(struct pktproc_queue_ul *q, struct sk_buff *sk
 		return -EACCES;
 	}
 
+	use_dit = dit_check_dir_use_queue(DIT_DIR_TX, q->q_idx);
+	if (!use_dit && q->ppa_ul->use_seg)
+		nr_desc = DIV_ROUND_UP(skb->len, q->ppa_ul->max_packet_size);
+
 	space = circ_get_space(q->num_desc, q->done_ptr, q_info->rear_ptr);
-	if (space < 1) {
+	if (space < nr_desc) {
 		mif_err_limited("NOSPC num_desc:%d fore:%d done:%d rear:%d\n",
 			q->num_desc, q_info->fore_ptr, q->done_ptr, q_info->rear_ptr);
 		q->stat.buff_full_cnt++;
 		return -ENOSPC;
 	}
 
-	use_dit = dit_check_dir_use_queue(DIT_DIR_TX, q->q_idx);
+	if (nr_desc > 1)
+		return pktproc_send_seg_pkt_to_cp(q, skb, nr_desc);
 
 	if (!use_dit) {
 		target_addr = (void *)(q->q_buff_vbase +
 			(q->done_ptr * q->ppa_ul->max_packet_size));
-		skb_copy_from_linear_data(skb, target_addr, skb->len);
+		if (skb_copy_bits(skb, 0, target_addr, skb->len))
+			return -EINVAL;
 	}
 
 	desc = &q->desc_ul[q->done_ptr];
@@ -53,6 +114,7 @@ static int pktproc_send_pkt_to_cp(struct pktproc_queue_ul *q, struct sk_buff *sk
 	desc->total_pkt_size = desc->data_size;
 	desc->last_desc = 0;
 	desc->seg_on = 0;
+	desc->segment = PKTPROC_UL_SEG_NONE;
 	desc->hw_set = 0;
 	desc->lcid = skbpriv(skb)->sipc_ch;
 
@@ -68,6 +130,8 @@ static int pktproc_send_pkt_to_cp(struct pktproc_queue_ul *q, struct sk_buff *sk
 		}
 	}
 
+	q->stat.tx_pkts++;
+	q->stat.tx_bytes += len;
 	q->done_ptr = circ_new_ptr(q->num_desc, q->done_ptr, 1);
 
 	/* ensure the done_ptr ordering */
@@ -77,11 +141,12 @@ static int pktproc_send_pkt_to_cp(struct pktproc_queue_ul *q, struct sk_buff *sk
 }
 
 static int pktproc_set_end(struct pktproc_queue_ul *q, unsigned int desc_index,
-		unsigned int prev_offset)
+		unsigned int prev_offset, unsigned int max_back)
 {
 	struct pktproc_q_info_ul *q_info = q->q_info;
 	struct pktproc_desc_ul *prev_desc;
 	unsigned int prev_index;
+	unsigned int i;
 
 	if (unlikely(desc_index >= q->num_desc))
 		return -EINVAL;
@@ -98,8 +163,17 @@ static int pktproc_set_end(struct pktproc_queue_ul *q, unsigned int desc_index,
 	}
 
 	prev_index = circ_prev_ptr(q->num_desc, desc_index, prev_offset);
-
 	prev_desc = &q->desc_ul[prev_index];
+
+	/* never split a seg_on chain with the end bit */
+	for (i = 0; i < max_back && prev_desc->seg_on &&
+			prev_desc->segment != PKTPROC_UL_SEG_LAST; i++) {
+		prev_index = circ_prev_ptr(q->num_desc, prev_index, 1);
+		prev_desc = &q->desc_ul[prev_index];
+	}
+	if (prev_desc->seg_on && prev_desc->segment != PKTPROC_UL_SEG_LAST)
+		return -EAGAIN;
+
 	prev_desc->last_desc = 1;
 
 	q->stat.pass_cnt++;
@@ -126,7 +200,9 @@ static int pktproc_ul_update_fore_ptr(struct pktproc_queue_ul *q, u32 count)
 
 	for (i = 0; i < count - offset; i += offset) {
 		last_ptr = circ_new_ptr(q->num_desc, last_ptr, offset);
-		ret = pktproc_set_end(q, last_ptr, 1);
+		ret = pktproc_set_end(q, last_ptr, 1, offset - 1);
+		if (ret == -EAGAIN)
+			continue;
 		if (ret) {
 			mif_err_limited("set end failed. q_idx:%d, ret:%d\n", q->q_idx, ret);
 			goto error;
@@ -134,7 +210,7 @@ static int pktproc_ul_update_fore_ptr(struct pktproc_queue_ul *q, u32 count)
 	}
 
 set_last:
-	ret = pktproc_set_end(q, fore_ptr, 1);
+	ret = pktproc_set_end(q, fore_ptr, 1, 0);
 	if (ret) {
 		mif_err_limited("set end failed. q_idx:%d, ret:%d\n", q->q_idx, ret);
 		goto error;
@@ -150,6 +226,27 @@ error:
 	return 0;
 }
 
+static u32 pktproc_ul_flush(struct pktproc_queue_ul *q)
+{
+	unsigned long flags;
+	u32 count;
+
+	spin_lock_irqsave(&q->fore_lock, flags);
+	count = circ_get_usage(q->num_desc, q->done_ptr, q->q_info->fore_ptr);
+	if (count) {
+		q->update_fore_ptr(q, count);
+
+		q->stat.doorbell_cnt++;
+		q->stat.doorbell_pkts += q->stat.tx_pkts - q->flushed_pkts;
+		q->stat.doorbell_bytes += q->stat.tx_bytes - q->flushed_bytes;
+		q->flushed_pkts = q->stat.tx_pkts;
+		q->flushed_bytes = q->stat.tx_bytes;
+	}
+	spin_unlock_irqrestore(&q->fore_lock, flags);
+
+	return count;
+}
+
 /*
  * Debug
  */
@@ -232,17 +329,61 @@ static ssize_t status_show(struct device *dev, struct device_attribute *attr,
 				q->stat.buff_full_cnt, q->stat.inactive_cnt);
 		count += scnprintf(&buf[count], PAGE_SIZE - count, "  total:%lld\n",
 				q->stat.total_cnt);
+		count += scnprintf(&buf[count], PAGE_SIZE - count,
+				"  tx: pkts:%lld bytes:%lld seg:%lld\n",
+				q->stat.tx_pkts, q->stat.tx_bytes, q->stat.seg_cnt);
+		count += scnprintf(&buf[count], PAGE_SIZE - count,
+				"  doorbell:%lld burst_flush:%lld pkts/db:%lld bytes/db:%lld\n",
+				q->stat.doorbell_cnt, q->stat.burst_flush_cnt,
+				q->stat.doorbell_cnt ?
+				div64_u64(q->stat.doorbell_pkts, q->stat.doorbell_cnt) : 0,
+				q->stat.doorbell_cnt ?
+				div64_u64(q->stat.doorbell_bytes, q->stat.doorbell_cnt) : 0);
 	}
 
 	return count;
 }
 
+static ssize_t burst_flush_store(struct device *dev,
+		struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct modem_ctl *mc = dev_get_drvdata(dev);
+	struct link_device *ld = get_current_link(mc->iod);
+	struct mem_link_device *mld = to_mem_link_device(ld);
+	struct pktproc_adaptor_ul *ppa_ul = &mld->pktproc_ul;
+	unsigned int flush;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &flush);
+	if (ret)
+		return -EINVAL;
+
+	ppa_ul->flush_on_burst_end = (flush > 0 ? true : false);
+
+	return count;
+}
+
+static ssize_t burst_flush_show(struct device *dev, struct device_attribute *attr,
+		char *buf)
+{
+	struct modem_ctl *mc = dev_get_drvdata(dev);
+	struct link_device *ld = get_current_link(mc->iod);
+	struct mem_link_device *mld = to_mem_link_device(ld);
+	struct pktproc_adaptor_ul *ppa_ul = &mld->pktproc_ul;
+
+	return scnprintf(buf, PAGE_SIZE, "burst_flush:%d use_seg:%d\n",
+			ppa_ul->flush_on_burst_end, ppa_ul->use_seg);
+}
+
 static DEVICE_ATTR_RO(region);
 static DEVICE_ATTR_RO(status);
+static DEVICE_ATTR_RW(burst_flush);
 
 static struct attribute *pktproc_ul_attrs[] = {
 	&dev_attr_region.attr,
 	&dev_attr_status.attr,
+	&dev_attr_burst_flush.attr,
 	NULL,
 };
 
@@ -296,6 +437,8 @@ int pktproc_init_ul(struct pktproc_adaptor_ul *ppa_ul)
 			dit_reset_dst_wp_rp(DIT_DIR_TX);
 
 		memset(&q->stat, 0, sizeof(struct pktproc_statistics_ul));
+		q->flushed_pkts = 0;
+		q->flushed_bytes = 0;
 
 		atomic_set(&q->active, 1);
 		atomic_set(&q->busy, 0);
@@ -323,10 +466,18 @@ static int pktproc_get_info_ul(struct pktproc_adaptor_ul *ppa_ul,
 	mif_dt_read_u32(np, "pktproc_ul_buff_rgn_cached", ppa_ul->buff_rgn_cached);
 	mif_dt_read_u32(np, "pktproc_ul_padding_required",
 			ppa_ul->padding_required);
+	mif_dt_read_u32_noerr(np, "pktproc_ul_use_seg", ppa_ul->use_seg);
+	if (ppa_ul->use_seg && ppa_ul->padding_required) {
+		mif_err("seg_on is not supported with padding\n");
+		ppa_ul->use_seg = false;
+	}
+	mif_dt_read_u32_noerr(np, "pktproc_ul_flush_on_burst_end", ppa_ul->flush_on_burst_end);
 	mif_info("cp_base:0x%08x num_queue:%d max_packet_size:%d iocc:%d\n",
 		ppa_ul->cp_base, ppa_ul->num_queue, ppa_ul->max_packet_size, ppa_ul->use_hw_iocc);
 	mif_info("info/desc rgn cache: %d buff rgn cache: %d padding_required:%d\n",
 		ppa_ul->info_desc_rgn_cached, ppa_ul->buff_rgn_cached, ppa_ul->padding_required);
+	mif_info("use_seg:%d flush_on_burst_end:%d\n",
+		ppa_ul->use_seg, ppa_ul->flush_on_burst_end);
 
 	mif_dt_read_u32(np, "pktproc_ul_info_rgn_offset",
 			ppa_ul->info_rgn_offset);
@@ -449,6 +600,7 @@ int pktproc_create_ul(struct platform_device *pdev, struct mem_link_device *mld,
 			(i * buff_size_by_q);
 		q->send_packet = pktproc_send_pkt_to_cp;
 		q->update_fore_ptr = pktproc_ul_update_fore_ptr;
+		q->flush = pktproc_ul_flush;
 
 		if ((q->cp_desc_pbase + q->desc_size) > q->cp_buff_pbase) {
 			mif_err("Descriptor overflow:0x%08x 0x%08x 0x%08x\n",
@@ -457,6 +609,7 @@ int pktproc_create_ul(struct platform_device *pdev, struct mem_link_device *mld,
 		}
 
 		spin_lock_init(&q->lock);
+		spin_lock_init(&q->fore_lock);
 
 		q->q_idx = i;
 		q->mld = mld;
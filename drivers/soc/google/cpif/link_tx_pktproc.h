@@ -28,6 +28,17 @@ enum pktproc_end_bit_owner {
 /* Padding required by CP */
 #define CP_PADDING		76
 
+/* Max descriptors chained for one packet when seg_on is used */
+#define PKTPROC_UL_MAX_SEGS	8
+
+/* Segment position of a chained descriptor when seg_on is set */
+enum pktproc_ul_segment {
+	PKTPROC_UL_SEG_NONE,
+	PKTPROC_UL_SEG_FIRST,
+	PKTPROC_UL_SEG_MIDDLE,
+	PKTPROC_UL_SEG_LAST
+};
+
 /* Q_info */
 struct pktproc_q_info_ul {
 	u32 cp_desc_pbase;
@@ -65,6 +76,17 @@ struct pktproc_statistics_ul {
 	u64 inactive_cnt;
 	/* number of times succeed to write a packet to pktproc UL */
 	u64 pass_cnt;
+	/* packets and bytes written by AP */
+	u64 tx_pkts;
+	u64 tx_bytes;
+	/* packets written as multi-descriptor chains */
+	u64 seg_cnt;
+	/* fore_ptr updates followed by a doorbell, and what they carried */
+	u64 doorbell_cnt;
+	u64 doorbell_pkts;
+	u64 doorbell_bytes;
+	/* flushes done at the end of an xmit_more burst */
+	u64 burst_flush_cnt;
 };
 
 /* Logical view for each queue */
@@ -80,6 +102,9 @@ struct pktproc_queue_ul {
 	u32 *fore_ptr; /* indicates the last last-bit raised desc pointer */
 	u32 done_ptr; /* indicates the last packet written by AP */
 	u32 *rear_ptr; /* indicates the last desc read by CP */
+	spinlock_t fore_lock; /* serializes fore_ptr updates from xmit and tx timer */
+	u64 flushed_pkts; /* tx_pkts at the last fore_ptr update */
+	u64 flushed_bytes; /* tx_bytes at the last fore_ptr update */
 
 	/* Store */
 	u32 cp_desc_pbase;
@@ -103,6 +128,7 @@ struct pktproc_queue_ul {
 	/* Func */
 	int (*send_packet)(struct pktproc_queue_ul *q, struct sk_buff *new_skb);
 	int (*update_fore_ptr)(struct pktproc_queue_ul *q, u32 count);
+	u32 (*flush)(struct pktproc_queue_ul *q);
 };
 
 /* PktProc adaptor for UL*/
@@ -124,6 +150,8 @@ struct pktproc_adaptor_ul {
 	bool info_desc_rgn_cached;
 	bool buff_rgn_cached;
 	bool padding_required;	/* requires extra length. (s5123 EVT1 only) */
+	bool use_seg;		/* CP accepts a packet chained over seg_on descriptors */
+	bool flush_on_burst_end;	/* update fore_ptr at the end of an xmit_more burst */
 
 	void __iomem *info_vbase;	/* I/O region for information */
 	void __iomem *desc_vbase;	/* I/O region for descriptor */
@@ -154,6 +182,14 @@ static inline bool pktproc_ul_q_empty(struct pktproc_q_info_ul *q_info)
 {
 	return (q_info->fore_ptr == q_info->rear_ptr);
 }
+
+static inline u32 pktproc_ul_max_len(struct pktproc_adaptor_ul *ppa_ul)
+{
+	if (ppa_ul->use_seg)
+		return ppa_ul->max_packet_size * PKTPROC_UL_MAX_SEGS;
+
+	return ppa_ul->max_packet_size;
+}
 #else
 static inline int pktproc_create_ul(struct platform_device *pdev,
 		struct mem_link_device *mld,
@@ -164,6 +200,7 @@ static inline int pktproc_check_support_ul(struct pktproc_adaptor_ul *ppa_ul)
 static inline int pktproc_check_ul_q_active(struct pktproc_adaptor_ul *ppa_ul,
 		u32 q_idx) { return 0; }
 static inline bool pktproc_ul_q_empty(struct pktproc_q_info_ul *q_info) { return 0; }
+static inline u32 pktproc_ul_max_len(struct pktproc_adaptor_ul *ppa_ul) { return 0; }
 #endif
 
 #endif /* __LINK_TX_PKTPROC_H__ */
@@ -45,6 +45,7 @@
 #include "modem_prj.h"
 #include "modem_variation.h"
 #include "modem_utils.h"
+#include "cpif_tp_monitor.h"
 
 #if IS_ENABLED(CONFIG_MODEM_IF_LEGACY_QOS)
 #include "cpif_qos_info.h"
@@ -830,6 +831,8 @@ free_chrdev:
 	unregister_chrdev_region(MAJOR(msd->cdev_major), pdata->num_iodevs);
 
 free_mc:
+	tpmon_destroy(pdev);
+
 	if (modemctl)
 		devm_kfree(dev, modemctl);
 
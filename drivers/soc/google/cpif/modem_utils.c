@@ -1283,11 +1283,87 @@ void exit_mif_buff_mng(struct mif_buff_mng *bm)
 		list_del(&bm->node);
 		spin_unlock_irqrestore(&bm->lock, flags);
 
+		if (bm->recycle_map) {
+			ptr_ring_cleanup(&bm->recycle, NULL);
+			bitmap_free(bm->recycle_map);
+		}
 		kfree(bm->buffer_map);
 		kfree(bm);
 	}
 }
 
+int init_mif_buff_recycle(struct mif_buff_mng *bm, unsigned int size)
+{
+	int ret;
+
+	if (bm == NULL || size == 0) {
+		mif_err("parameter ERR!\n");
+		return -EINVAL;
+	}
+
+	if (bm->recycle_map)
+		return 0;
+
+	bm->recycle_map = bitmap_zalloc(bm->cell_count, GFP_KERNEL);
+	if (!bm->recycle_map)
+		return -ENOMEM;
+
+	ret = ptr_ring_init(&bm->recycle, size, GFP_KERNEL);
+	if (ret) {
+		bitmap_free(bm->recycle_map);
+		bm->recycle_map = NULL;
+		return ret;
+	}
+
+	bm->recycle_put = 0;
+	bm->recycle_get = 0;
+
+	mif_info("recycle size:%u\n", size);
+
+	return 0;
+}
+
+static void *alloc_mif_buff_recycled(struct mif_buff_mng *bm)
+{
+	unsigned char *buff;
+	unsigned int location;
+	unsigned long flags;
+
+	buff = ptr_ring_consume_any(&bm->recycle);
+	if (!buff)
+		return NULL;
+
+	location = (unsigned int)(buff - bm->buffer_start) / bm->cell_size;
+	clear_bit(location, bm->recycle_map);
+
+	spin_lock_irqsave(&bm->lock, flags);
+	bm->free_cell_count--;
+	bm->used_cell_count++;
+	bm->recycle_get++;
+	spin_unlock_irqrestore(&bm->lock, flags);
+
+	return buff;
+}
+
+static bool free_mif_buff_recycled(struct mif_buff_mng *bm, unsigned int location)
+{
+	unsigned char *buff = bm->buffer_start + (location * bm->cell_size);
+	unsigned long flags;
+
+	if (ptr_ring_produce_any(&bm->recycle, buff)) {
+		clear_bit(location, bm->recycle_map);
+		return false;
+	}
+
+	spin_lock_irqsave(&bm->lock, flags);
+	bm->free_cell_count++;
+	bm->used_cell_count--;
+	bm->recycle_put++;
+	spin_unlock_irqrestore(&bm->lock, flags);
+
+	return true;
+}
+
 void *alloc_mif_buff(struct mif_buff_mng *bm)
 {
 	unsigned char *buff_allocated;
@@ -1308,6 +1384,12 @@ void *alloc_mif_buff(struct mif_buff_mng *bm)
 		return NULL;
 	}
 
+	if (bm->recycle_map) {
+		buff_allocated = alloc_mif_buff_recycled(bm);
+		if (buff_allocated)
+			return (void *)buff_allocated;
+	}
+
 	spin_lock_irqsave(&bm->lock, flags);
 
 	for (i = bm->current_map_index ; i < bm->buffer_map_size; i++) {
@@ -1424,6 +1506,16 @@ int free_mif_buff(struct mif_buff_mng *bm, void *buffer)
 		return -1;
 	}
 
+	if (bm->recycle_map) {
+		if (test_and_set_bit(location, bm->recycle_map)) {
+			mif_err_limited("ERR Buffer:%pK is allready recycled\n", uc_buffer);
+			return -1;
+		}
+
+		if (free_mif_buff_recycled(bm, location))
+			return 0;
+	}
+
 	spin_lock_irqsave(&bm->lock, flags);
 
 	bm->buffer_map[i] &= ~(MIF_64BIT_FIRST_BIT >> j);
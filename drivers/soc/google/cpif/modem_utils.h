@@ -8,6 +8,7 @@
 #define __MODEM_UTILS_H__
 
 #include <linux/rbtree.h>
+#include <linux/ptr_ring.h>
 #include "modem_prj.h"
 #include "link_device_memory.h"
 
@@ -588,11 +589,22 @@ struct mif_buff_mng {
 	struct list_head node;
 
 	bool enable_sw_zerocopy;
+
+	/*
+	 * Recycle cache. Cells freed by skb release are parked here instead of
+	 * going back to the bitmap, so the next refill takes them without a map
+	 * scan. A parked cell keeps its bit set in buffer_map.
+	 */
+	struct ptr_ring recycle;
+	unsigned long *recycle_map;	/* Cells parked in the recycle cache */
+	u64 recycle_put;
+	u64 recycle_get;
 };
 
 struct mif_buff_mng *init_mif_buff_mng(unsigned char *buffer_start,
 	unsigned int buffer_size, unsigned int cell_size);
 void exit_mif_buff_mng(struct mif_buff_mng *bm);
+int init_mif_buff_recycle(struct mif_buff_mng *bm, unsigned int size);
 void *alloc_mif_buff(struct mif_buff_mng *bm);
 int free_mif_buff(struct mif_buff_mng *bm, void *buffer);
 
@@ -12,6 +12,8 @@
 #include "eh_regs.h"
 #include <linux/spinlock_types.h>
 #include <linux/wait.h>
+#include <linux/hrtimer.h>
+#include <linux/completion.h>
 
 struct eh_completion {
 	void *priv;
@@ -19,6 +21,26 @@ struct eh_completion {
 
 #define EH_MAX_DCMD 8
 
+/*
+ * Decompression latency histogram. Bucket 0 counts waits shorter than
+ * 2us, bucket i counts waits in [2^i, 2^(i+1)) us and the last bucket
+ * holds everything longer.
+ */
+#define EH_DCMD_HIST_BUCKETS 16
+
+struct eh_dcmd_hist {
+	u64 spin[EH_DCMD_HIST_BUCKETS];
+	u64 sleep[EH_DCMD_HIST_BUCKETS];
+};
+
+/* sleeping waiter for a decompression command set */
+struct eh_dcmd_waiter {
+	struct eh_device *eh_dev;
+	unsigned int index;
+	struct hrtimer timer;
+	struct completion done;
+};
+
 #define EH_QUIRK_IGNORE_GCTRL_RESET BIT(0)
 
 struct eh_device {
@@ -48,7 +70,15 @@ struct eh_device {
 	/* 64B aligned compression command fifo of either type 0 or type 1 */
 	void *fifo;
 
-	spinlock_t fifo_prod_lock;
+	/*
+	 * Next descriptor to be handed out to a producer. Producers reserve
+	 * runs of descriptors with cmpxchg on this, fill them in parallel and
+	 * then publish them to write_index in reservation order.
+	 */
+	atomic_t reserve_index;
+
+	/* producers waiting for fifo room, woken as descriptors retire */
+	wait_queue_head_t fifo_wq;
 
 	/* Array of completions to keep track of each ongoing compression */
 	struct eh_completion *completions;
@@ -62,6 +92,15 @@ struct eh_device {
 	/* Array of pre-allocated bounce buffers for decompression */
 	unsigned long __percpu *bounce_buffer;
 
+	/* bitmap of decompression command sets in use */
+	unsigned long dcmd_busy;
+	/* sets held by callers that may sleep, capped below decompr_cmd_count */
+	atomic_t dcmd_sleepers;
+	/* sleepable callers waiting for a set */
+	wait_queue_head_t dcmd_wq;
+	struct eh_dcmd_waiter dcmd_waiters[EH_MAX_DCMD];
+	struct eh_dcmd_hist __percpu *dcmd_hist;
+
 	/* parent device */
 	struct device *dev;
 
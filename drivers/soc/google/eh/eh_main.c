@@ -107,9 +107,21 @@ enum eh_cdesc_status {
 static LIST_HEAD(eh_dev_list);
 static DEFINE_SPINLOCK(eh_dev_list_lock);
 
-static DECLARE_WAIT_QUEUE_HEAD(eh_compress_wait);
 static unsigned int eh_default_fifo_size = 256;
 
+/*
+ * Hybrid completion for decompression: busy-poll the DCMD status for up to
+ * eh_dcmd_spin_us, then, if the caller is allowed to sleep, sleep and let a
+ * hrtimer re-poll the status every eh_dcmd_repoll_us.
+ */
+static unsigned int eh_dcmd_spin_us = 30;
+module_param(eh_dcmd_spin_us, uint, 0644);
+MODULE_PARM_DESC(eh_dcmd_spin_us, "Busy-poll time before sleeping on decompression");
+
+static unsigned int eh_dcmd_repoll_us = 10;
+module_param(eh_dcmd_repoll_us, uint, 0644);
+MODULE_PARM_DESC(eh_dcmd_repoll_us, "Status re-poll period while sleeping on decompression");
+
 /*
  * - Primitive functions for Emerald Hill HW
  */
@@ -159,25 +171,11 @@ static void eh_dump_regs(struct eh_device *eh_dev)
 	pr_err("pending_compression %lu\n", atomic_read(&eh_dev->nr_request));
 }
 
-static inline unsigned int fifo_write_index(struct eh_device *eh_dev)
-{
-	return eh_dev->write_index & eh_dev->fifo_index_mask;
-}
-
 static inline unsigned int fifo_complete_index(struct eh_device *eh_dev)
 {
 	return eh_dev->complete_index & eh_dev->fifo_index_mask;
 }
 
-static inline void update_fifo_write_index(struct eh_device *eh_dev)
-{
-	unsigned int next_write_idx = (eh_dev->write_index + 1) &
-				       eh_dev->fifo_color_mask;
-
-	eh_dev->write_index = next_write_idx;
-	eh_write_register(eh_dev, EH_REG_CDESC_WRIDX, next_write_idx);
-}
-
 static inline void update_fifo_complete_index(struct eh_device *eh_dev)
 {
 	smp_store_release(&eh_dev->complete_index,
@@ -185,14 +183,13 @@ static inline void update_fifo_complete_index(struct eh_device *eh_dev)
 			  eh_dev->fifo_color_mask);
 }
 
-static bool fifo_full(struct eh_device *eh_dev)
+/* number of descriptors a producer could still reserve */
+static unsigned int fifo_room(struct eh_device *eh_dev, unsigned int reserve)
 {
-	unsigned int write_idx = fifo_write_index(eh_dev);
-	unsigned int complete_idx = fifo_complete_index(eh_dev);
+	unsigned int complete = smp_load_acquire(&eh_dev->complete_index);
 
-	if (write_idx != complete_idx)
-		return false;
-	return  eh_dev->write_index != eh_dev->complete_index;
+	return eh_dev->fifo_size -
+		((reserve - complete) & eh_dev->fifo_color_mask);
 }
 
 /* index of the next descriptor to be completed by hardware */
@@ -272,6 +269,7 @@ static void eh_compr_fifo_init(struct eh_device *eh_dev)
 	/* reset software copies of index registers */
 	eh_dev->write_index = 0;
 	eh_dev->complete_index = 0;
+	atomic_set(&eh_dev->reserve_index, 0);
 
 	/* program FIFO memory location and size */
 	data = (unsigned long)virt_to_phys(eh_dev->fifo) | __ffs(eh_dev->fifo_size);
@@ -315,23 +313,10 @@ static void init_compression_descriptor(struct eh_device *eh_dev)
 /*
  * - Primitive functions for Emerald Hill SW
  */
-static long eh_congestion_wait(long timeout)
+static void clear_eh_congested(struct eh_device *eh_dev)
 {
-	long ret;
-	DEFINE_WAIT(wait);
-	wait_queue_head_t *wqh = &eh_compress_wait;
-
-	prepare_to_wait(wqh, &wait, TASK_UNINTERRUPTIBLE);
-	ret = io_schedule_timeout(timeout);
-	finish_wait(wqh, &wait);
-
-	return ret;
-}
-
-static void clear_eh_congested(void)
-{
-	if (waitqueue_active(&eh_compress_wait))
-		wake_up(&eh_compress_wait);
+	if (wq_has_sleeper(&eh_dev->fifo_wq))
+		wake_up(&eh_dev->fifo_wq);
 }
 
 static irqreturn_t eh_error_irq(int irq, void *data)
@@ -446,9 +431,9 @@ static int eh_process_completed_descriptor(struct eh_device *eh_dev,
 	/* set the descriptor back to IDLE */
 	desc->status = EH_CDESC_IDLE;
 	atomic_dec(&eh_dev->nr_request);
-	clear_eh_congested();
 
 	update_fifo_complete_index(eh_dev);
+	clear_eh_congested(eh_dev);
 	return ret;
 }
 
@@ -588,12 +573,13 @@ static int eh_init_compression(struct eh_device *eh_dev, unsigned short fifo_siz
 	int i, ret = 0;
 	unsigned int desc_size = EH_COMPRESS_DESC_SIZE;
 
-	spin_lock_init(&eh_dev->fifo_prod_lock);
+	init_waitqueue_head(&eh_dev->fifo_wq);
 
 	eh_dev->fifo_size = fifo_size;
 	eh_dev->fifo_index_mask = fifo_size - 1;
 	eh_dev->fifo_color_mask = (fifo_size << 1) - 1;
 	eh_dev->write_index = eh_dev->complete_index = 0;
+	atomic_set(&eh_dev->reserve_index, 0);
 
 	eh_dev->completions = kzalloc(fifo_size * sizeof(struct eh_completion),
 				      GFP_KERNEL);
@@ -635,10 +621,29 @@ out_cleanup:
 	return ret;
 }
 
+static enum hrtimer_restart eh_dcmd_repoll(struct hrtimer *timer)
+{
+	struct eh_dcmd_waiter *waiter = container_of(timer,
+					struct eh_dcmd_waiter, timer);
+
+	if (eh_read_dcmd_status(waiter->eh_dev, waiter->index) ==
+	    EH_DCMD_PENDING) {
+		hrtimer_forward_now(timer, us_to_ktime(eh_dcmd_repoll_us));
+		return HRTIMER_RESTART;
+	}
+
+	complete(&waiter->done);
+	return HRTIMER_NORESTART;
+}
+
 static void eh_deinit_decompression(struct eh_device *eh_dev)
 {
 	int cpu;
 	unsigned long buf;
+
+	free_percpu(eh_dev->dcmd_hist);
+	eh_dev->dcmd_hist = NULL;
+
 	for_each_possible_cpu(cpu) {
 		buf = *per_cpu_ptr(eh_dev->bounce_buffer, cpu);
 		if (buf) {
@@ -658,6 +663,25 @@ static int eh_init_decompression(struct eh_device *eh_dev)
 	if (!eh_dev->bounce_buffer)
 		return -ENOMEM;
 
+	eh_dev->dcmd_hist = alloc_percpu(struct eh_dcmd_hist);
+	if (!eh_dev->dcmd_hist) {
+		ret = -ENOMEM;
+		goto out_cleanup;
+	}
+
+	eh_dev->dcmd_busy = 0;
+	atomic_set(&eh_dev->dcmd_sleepers, 0);
+	init_waitqueue_head(&eh_dev->dcmd_wq);
+	for (cpu = 0; cpu < EH_MAX_DCMD; cpu++) {
+		struct eh_dcmd_waiter *waiter = &eh_dev->dcmd_waiters[cpu];
+
+		waiter->eh_dev = eh_dev;
+		waiter->index = cpu;
+		init_completion(&waiter->done);
+		hrtimer_init(&waiter->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		waiter->timer.function = eh_dcmd_repoll;
+	}
+
 	for_each_possible_cpu(cpu) {
 		unsigned long buf = __get_free_pages(GFP_KERNEL, 0);
 		if (!buf) {
@@ -851,54 +875,206 @@ static void eh_setup_dcmd(struct eh_device *eh_dev, unsigned int index,
 	eh_write_register(eh_dev, EH_REG_DCMD_DEST(index), dst_data);
 }
 
-int eh_compress_page(struct eh_device *eh_dev, struct page *page, void *priv)
+/*
+ * Reserve up to @want descriptors without taking any lock. Returns the
+ * number of descriptors reserved, starting at *@start, or 0 if the fifo
+ * is full.
+ */
+static unsigned int eh_reserve_descriptors(struct eh_device *eh_dev,
+					   unsigned int want,
+					   unsigned int *start)
 {
-	unsigned int write_idx;
-	struct eh_completion *compl;
+	int old = atomic_read(&eh_dev->reserve_index);
+	unsigned int room, n;
 
-try_again:
-	spin_lock(&eh_dev->fifo_prod_lock);
+	do {
+		room = fifo_room(eh_dev, old);
+		if (!room)
+			return 0;
+		n = min(want, room);
+	} while (!atomic_try_cmpxchg(&eh_dev->reserve_index, &old,
+				     (old + n) & eh_dev->fifo_color_mask));
 
-	if (fifo_full(eh_dev)) {
-		spin_unlock(&eh_dev->fifo_prod_lock);
-		cond_resched();
-		eh_congestion_wait(HZ/10);
-		goto try_again;
-	}
+	*start = old;
+	return n;
+}
 
-	write_idx = fifo_write_index(eh_dev);
+/*
+ * Hand descriptors [@start, @end) over to HW. Reservations are published
+ * strictly in order so a producer waits here for the ones reserved before
+ * it, which is short since they are only filling descriptors.
+ */
+static void eh_publish_descriptors(struct eh_device *eh_dev,
+				   unsigned int start, unsigned int end,
+				   unsigned int n)
+{
+	while (smp_load_acquire(&eh_dev->write_index) != start)
+		cpu_relax();
 
-	eh_setup_descriptor(eh_dev, page, write_idx);
+	atomic_add(n, &eh_dev->nr_request);
 
-	compl = &eh_dev->completions[write_idx];
-	compl->priv = priv;
+	/* write barrier to force writes to be visible everywhere */
+	wmb();
+	eh_write_register(eh_dev, EH_REG_CDESC_WRIDX, end);
+	smp_store_release(&eh_dev->write_index, end);
 
-	atomic_inc(&eh_dev->nr_request);
 	wake_up(&eh_dev->comp_wq);
+}
 
-	/* write barrier to force writes to be visible everywhere */
-	wmb();
-	update_fifo_write_index(eh_dev);
-	spin_unlock(&eh_dev->fifo_prod_lock);
+/*
+ * eh_compress_pages
+ *
+ * Queue @nr pages for compression. Descriptors are reserved in runs so
+ * concurrent producers fill them in parallel, and each run is published
+ * to HW with a single write index update. If the fifo is full, the caller
+ * sleeps until eh_comp_thread retires descriptors.
+ */
+int eh_compress_pages(struct eh_device *eh_dev, struct page **pages,
+		      void **privs, unsigned int nr)
+{
+	unsigned int i = 0;
+
+	while (i < nr) {
+		unsigned int start, n, j;
+
+		/* keep the reserve-to-publish window short for other producers */
+		preempt_disable();
+		n = eh_reserve_descriptors(eh_dev, nr - i, &start);
+		if (!n) {
+			preempt_enable();
+			wait_event_timeout(eh_dev->fifo_wq,
+				fifo_room(eh_dev,
+					  atomic_read(&eh_dev->reserve_index)),
+				HZ/10);
+			continue;
+		}
+
+		for (j = 0; j < n; j++, i++) {
+			unsigned int write_idx = (start + j) &
+						 eh_dev->fifo_index_mask;
+
+			eh_setup_descriptor(eh_dev, pages[i], write_idx);
+			eh_dev->completions[write_idx].priv = privs[i];
+		}
+
+		eh_publish_descriptors(eh_dev, start,
+				       (start + n) & eh_dev->fifo_color_mask, n);
+		preempt_enable();
+	}
 
 	return 0;
 }
+EXPORT_SYMBOL(eh_compress_pages);
+
+int eh_compress_page(struct eh_device *eh_dev, struct page *page, void *priv)
+{
+	return eh_compress_pages(eh_dev, &page, &priv, 1);
+}
 EXPORT_SYMBOL(eh_compress_page);
 
+static inline unsigned int eh_dcmd_hist_bucket(s64 ns)
+{
+	unsigned long us = ns > 0 ? ns / NSEC_PER_USEC : 0;
+
+	if (!us)
+		return 0;
+	return min_t(unsigned int, __fls(us), EH_DCMD_HIST_BUCKETS - 1);
+}
+
+/*
+ * Try to claim a decompression command set, preferring the one of the
+ * current CPU. Callers that may sleep can hold a set for a long time, so
+ * they are never allowed to own all of them: an atomic caller spins with
+ * preemption disabled and must always find a set whose owner is spinning
+ * too.
+ */
+static bool eh_try_get_dcmd(struct eh_device *eh_dev, bool can_sleep,
+			    unsigned int *index)
+{
+	unsigned int count = eh_dev->decompr_cmd_count;
+	unsigned int i = raw_smp_processor_id() % count;
+
+	if (can_sleep &&
+	    !atomic_add_unless(&eh_dev->dcmd_sleepers, 1, count - 1))
+		return false;
+
+	if (test_and_set_bit_lock(i, &eh_dev->dcmd_busy)) {
+		i = find_first_zero_bit(&eh_dev->dcmd_busy, count);
+		if (i >= count || test_and_set_bit_lock(i, &eh_dev->dcmd_busy)) {
+			if (can_sleep)
+				atomic_dec(&eh_dev->dcmd_sleepers);
+			return false;
+		}
+	}
+
+	*index = i;
+	return true;
+}
+
+static unsigned int eh_get_dcmd(struct eh_device *eh_dev, bool can_sleep)
+{
+	unsigned int index;
+
+	if (can_sleep) {
+		wait_event(eh_dev->dcmd_wq,
+			   eh_try_get_dcmd(eh_dev, true, &index));
+	} else {
+		while (!eh_try_get_dcmd(eh_dev, false, &index))
+			cpu_relax();
+	}
+
+	return index;
+}
+
+static void eh_put_dcmd(struct eh_device *eh_dev, unsigned int index,
+			bool can_sleep)
+{
+	clear_bit_unlock(index, &eh_dev->dcmd_busy);
+	if (can_sleep)
+		atomic_dec(&eh_dev->dcmd_sleepers);
+	if (wq_has_sleeper(&eh_dev->dcmd_wq))
+		wake_up(&eh_dev->dcmd_wq);
+}
+
+/* Sleep until the hrtimer re-poll sees the decompression complete. */
+static unsigned long eh_dcmd_sleep(struct eh_device *eh_dev,
+				   unsigned int index, unsigned long timeout)
+{
+	struct eh_dcmd_waiter *waiter = &eh_dev->dcmd_waiters[index];
+	long remain = (long)(timeout - jiffies);
+	ktime_t start;
+
+	reinit_completion(&waiter->done);
+
+	start = ktime_get();
+	hrtimer_start(&waiter->timer, us_to_ktime(eh_dcmd_repoll_us),
+		      HRTIMER_MODE_REL);
+	if (remain > 0)
+		wait_for_completion_timeout(&waiter->done, remain);
+	hrtimer_cancel(&waiter->timer);
+
+	this_cpu_inc(eh_dev->dcmd_hist->sleep[eh_dcmd_hist_bucket(
+			ktime_to_ns(ktime_sub(ktime_get(), start)))]);
+
+	return eh_read_dcmd_status(eh_dev, index);
+}
+
 /*
  * eh_decompress_page
  *
- * Decompress a page synchronously. Uses polling for completion.
- *
- * Holds a spinlock for the entire operation, so that nothing can interrupt it.
+ * Decompress a page synchronously. Uses polling for completion for up to
+ * eh_dcmd_spin_us; after that, callers which pass @can_sleep wait for a
+ * hrtimer re-poll instead of keeping the CPU busy. Atomic callers must
+ * pass false and spin with preemption disabled.
  */
 int eh_decompress_page(struct eh_device *eh_dev, void *src,
-		       unsigned int slen, struct page *page)
+		       unsigned int slen, struct page *page, bool can_sleep)
 {
 	int ret = 0;
-	int index;
+	unsigned int index;
 	unsigned long timeout;
 	unsigned long status;
+	ktime_t start, spin_end;
 
 	/*
 	 * Since it uses per-cpu bounce buffer, it doesn't allow to be called
@@ -906,12 +1082,23 @@ int eh_decompress_page(struct eh_device *eh_dev, void *src,
 	 */
 	WARN_ON(in_interrupt());
 
-	index = get_cpu();
-	pr_devel("[%s]: submit: cpu %u slen %u\n", current->comm, index, slen);
+	/* with a single set a sleeper would starve atomic callers */
+	if (eh_dev->decompr_cmd_count < 2)
+		can_sleep = false;
+
+	if (can_sleep)
+		might_sleep();
+	else
+		preempt_disable();
+
+	index = eh_get_dcmd(eh_dev, can_sleep);
+	pr_devel("[%s]: submit: dcmd %u slen %u\n", current->comm, index, slen);
 
 	/* program decompress register (no IRQ) */
 	eh_setup_dcmd(eh_dev, index, src, slen, page);
 
+	start = ktime_get();
+	spin_end = ktime_add_us(start, eh_dcmd_spin_us);
 	timeout = jiffies + msecs_to_jiffies(EH_POLL_DELAY_MS);
 	do {
 		cpu_relax();
@@ -922,8 +1109,26 @@ int eh_decompress_page(struct eh_device *eh_dev, void *src,
 			goto out;
 		}
 		status = eh_read_dcmd_status(eh_dev, index);
-	} while (status == EH_DCMD_PENDING);
+		if (status != EH_DCMD_PENDING)
+			break;
 
+		if (can_sleep && ktime_after(ktime_get(), spin_end)) {
+			this_cpu_inc(eh_dev->dcmd_hist->spin[eh_dcmd_hist_bucket(
+				ktime_to_ns(ktime_sub(ktime_get(), start)))]);
+			status = eh_dcmd_sleep(eh_dev, index, timeout);
+			if (status == EH_DCMD_PENDING) {
+				pr_err("sleep timeout on decompression\n");
+				eh_dump_regs(eh_dev);
+				ret = -ETIME;
+				goto out;
+			}
+			goto done;
+		}
+	} while (1);
+
+	this_cpu_inc(eh_dev->dcmd_hist->spin[eh_dcmd_hist_bucket(
+			ktime_to_ns(ktime_sub(ktime_get(), start)))]);
+done:
 	pr_devel("dcmd [%u] status = %u\n", index, status);
 
 	if (status != EH_DCMD_DECOMPRESSED) {
@@ -933,7 +1138,9 @@ int eh_decompress_page(struct eh_device *eh_dev, void *src,
 	}
 
 out:
-	put_cpu();
+	eh_put_dcmd(eh_dev, index, can_sleep);
+	if (!can_sleep)
+		preempt_enable();
 	return ret;
 }
 EXPORT_SYMBOL(eh_decompress_page);
@@ -1104,6 +1311,37 @@ static int eh_resume(struct device *dev)
 	return 0;
 }
 
+static ssize_t dcmd_latency_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct eh_device *eh_dev = dev_get_drvdata(dev);
+	ssize_t sz = 0;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct eh_dcmd_hist *hist = per_cpu_ptr(eh_dev->dcmd_hist, cpu);
+
+		sz += scnprintf(buf + sz, PAGE_SIZE - sz, "cpu%d spin:", cpu);
+		for (i = 0; i < EH_DCMD_HIST_BUCKETS; i++)
+			sz += scnprintf(buf + sz, PAGE_SIZE - sz, " %llu",
+					hist->spin[i]);
+		sz += scnprintf(buf + sz, PAGE_SIZE - sz, "\ncpu%d sleep:", cpu);
+		for (i = 0; i < EH_DCMD_HIST_BUCKETS; i++)
+			sz += scnprintf(buf + sz, PAGE_SIZE - sz, " %llu",
+					hist->sleep[i]);
+		sz += scnprintf(buf + sz, PAGE_SIZE - sz, "\n");
+	}
+
+	return sz;
+}
+static DEVICE_ATTR_RO(dcmd_latency);
+
+static struct attribute *eh_attrs[] = {
+	&dev_attr_dcmd_latency.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(eh);
+
 static const struct dev_pm_ops eh_pm_ops = {
 	.suspend = eh_suspend,
 	.resume = eh_resume,
@@ -1121,6 +1359,7 @@ static struct platform_driver eh_of_driver = {
 	.driver		= {
 		.name	= "eh",
 		.pm	= &eh_pm_ops,
+		.dev_groups = eh_groups,
 		.of_match_table = of_match_ptr(eh_of_match),
 	},
 };
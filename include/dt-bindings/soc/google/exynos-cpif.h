@@ -117,14 +117,16 @@
 #define TPMON_TARGET_CPU_CL0_MAX	14
 #define TPMON_TARGET_CPU_CL1_MAX	15
 #define TPMON_TARGET_CPU_CL2_MAX	16
-#define MAX_TPMON_TARGET	17
+#define TPMON_TARGET_IRQ_DIT_RING	17	/* extra_idx: DIT rx dst ring */
+#define MAX_TPMON_TARGET	18
 
 /* Protocol for TPMON */
 #define TPMON_PROTO_ALL	0
 #define TPMON_PROTO_TCP	1
 #define TPMON_PROTO_UDP	2
 #define TPMON_PROTO_OTHERS	3
-#define MAX_TPMON_PROTO	4
+#define TPMON_PROTO_FLOW	4	/* Largest single flow */
+#define MAX_TPMON_PROTO	5
 
 /* Link device attr */
 #define LINK_ATTR_SBD_IPC		(0x1 << 0) /* IPC over SBD (from MIPI-LLI) */
@@ -47,8 +47,12 @@ void eh_remove(struct eh_device *eh_dev);
  * the memory used to store the compressed data.
  */
 int eh_compress_page(struct eh_device *eh_dev, struct page *page, void *priv);
+/* start compression of @nr pages with a single doorbell write */
+int eh_compress_pages(struct eh_device *eh_dev, struct page **pages,
+		      void **privs, unsigned int nr);
+/* @can_sleep: the caller is in process context without locks held */
 int eh_decompress_page(struct eh_device *eh_dev, void *src,
-                       unsigned int slen, struct page *page);
+                       unsigned int slen, struct page *page, bool can_sleep);
 
 /* create eh_device for user */
 struct eh_device *eh_create(eh_cb_fn comp);
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Samsung SysMMU driver interface for client drivers
+ *
+ * Copyright (c) 2020 Samsung Electronics Co., Ltd.
+ */
+
+#ifndef __LINUX_SAMSUNG_IOMMU_H
+#define __LINUX_SAMSUNG_IOMMU_H
+
+#include <linux/iommu.h>
+
+#if IS_ENABLED(CONFIG_SAMSUNG_IOMMU)
+int samsung_sysmmu_prefault(struct iommu_domain *dom, dma_addr_t iova, size_t size);
+#else
+static inline int samsung_sysmmu_prefault(struct iommu_domain *dom, dma_addr_t iova,
+					  size_t size)
+{
+	return 0;
+}
+#endif
+
+#endif /* __LINUX_SAMSUNG_IOMMU_H */
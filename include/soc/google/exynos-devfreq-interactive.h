@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * ALT-DVFS load tracking and frequency policy for the simpleinteractive
+ * devfreq governor.
+ *
+ * Copyright 2021 Google LLC
+ *
+ * Nothing in here depends on kernel services, so the same code can be
+ * built in userspace and fed with recorded devfreq status samples.
+ */
+
+#ifndef __EXYNOS_DEVFREQ_INTERACTIVE_H_
+#define __EXYNOS_DEVFREQ_INTERACTIVE_H_
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdbool.h>
+#endif
+
+#define ALTDVFS_NSEC_PER_MSEC		1000000ULL
+
+#define LOAD_BUFFER_MAX			10
+struct devfreq_alt_load {
+	unsigned long long	delta;
+	unsigned int		load;
+};
+
+struct devfreq_alt_track {
+	struct devfreq_alt_load	buffer[LOAD_BUFFER_MAX];
+	struct devfreq_alt_load	*front;
+	struct devfreq_alt_load	*rear;
+
+	unsigned long long	busy;
+	unsigned long long	total;
+	unsigned int		min_load;
+	unsigned int		max_load;
+	unsigned long long	max_spent;
+};
+
+struct mif_int_map {
+	unsigned int mif_freq;
+	unsigned int int_freq;
+};
+
+#define ALTDVFS_MIN_SAMPLE_TIME		15
+#define ALTDVFS_HOLD_SAMPLE_TIME	100
+#define ALTDVFS_TARGET_LOAD		75
+#define ALTDVFS_NUM_TARGET_LOAD		1
+#define ALTDVFS_HISPEED_LOAD		99
+#define ALTDVFS_HISPEED_FREQ		1000000
+#define ALTDVFS_TOLERANCE		1
+#define ALTDVFS_BOOSTPULSE_DURATION	80
+
+struct devfreq_alt_dvfs_data {
+	struct devfreq_alt_track	*track;
+	unsigned int			track_group;
+
+	/* ALT-DVFS parameter */
+	unsigned int		*target_load;
+	unsigned int		num_target_load;
+	unsigned int		min_sample_time;
+	unsigned int		hold_sample_time;
+	unsigned int		hispeed_load;
+	unsigned int		hispeed_freq;
+	unsigned int		tolerance;
+
+	/*
+	 * Frequency keyed lists in the "value freq:value ..." format of
+	 * delay_time. When freq_target_load is set it replaces the per
+	 * group target_load for every track.
+	 */
+	unsigned int		*freq_target_load;
+	int			nfreq_target_load;
+	unsigned int		*above_hispeed_delay;
+	int			nabove_hispeed_delay;
+
+	/* msec the slack timer waits above min freq, < 0 disables it */
+	int			timer_slack;
+
+	/* boost pulse floor and default length in msec */
+	unsigned int		boost_freq;
+	unsigned int		boostpulse_duration;
+
+	/* policy state, in nsec of the caller's clock */
+	unsigned long long	hispeed_validate_time;
+	unsigned long long	boostpulse_endtime;
+
+	/* MIF to INT mapping table */
+	struct mif_int_map	*mif_int_tbl;
+	unsigned int		map_row_cnt;
+};
+
+void devfreq_alt_init_track(struct devfreq_alt_track *track);
+unsigned int devfreq_alt_freq_param(const unsigned int *list, int nlist,
+				    unsigned long freq);
+unsigned int devfreq_alt_target_load(struct devfreq_alt_dvfs_data *alt_data,
+				     unsigned int group,
+				     unsigned long current_frequency);
+unsigned long devfreq_alt_calc_freq(struct devfreq_alt_dvfs_data *alt_data,
+				    struct devfreq_alt_track *track,
+				    unsigned long current_frequency,
+				    unsigned long prev_freq,
+				    unsigned long governor_freq,
+				    unsigned int targetload,
+				    unsigned long long delta_time,
+				    unsigned long long total_time,
+				    unsigned long long busy_time);
+unsigned long devfreq_alt_next_freq(struct devfreq_alt_dvfs_data *alt_data,
+				    unsigned long current_frequency,
+				    unsigned long prev_freq,
+				    unsigned long freq, unsigned int max_load,
+				    unsigned long long now);
+
+#endif	/* __EXYNOS_DEVFREQ_INTERACTIVE_H_ */
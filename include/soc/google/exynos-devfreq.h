@@ -27,54 +27,7 @@
 
 int devfreq_simple_interactive_init(void);
 #if IS_ENABLED(CONFIG_EXYNOS_ALT_DVFS)
-#define LOAD_BUFFER_MAX			10
-struct devfreq_alt_load {
-	unsigned long long	delta;
-	unsigned int		load;
-};
-
-struct devfreq_alt_track {
-	struct devfreq_alt_load	buffer[LOAD_BUFFER_MAX];
-	struct devfreq_alt_load	*front;
-	struct devfreq_alt_load	*rear;
-
-	unsigned long long	busy;
-	unsigned long long	total;
-	unsigned int		min_load;
-	unsigned int		max_load;
-	unsigned long long	max_spent;
-};
-
-struct mif_int_map {
-	unsigned int mif_freq;
-	unsigned int int_freq;
-};
-
-#define ALTDVFS_MIN_SAMPLE_TIME		15
-#define ALTDVFS_HOLD_SAMPLE_TIME	100
-#define ALTDVFS_TARGET_LOAD		75
-#define ALTDVFS_NUM_TARGET_LOAD		1
-#define ALTDVFS_HISPEED_LOAD		99
-#define ALTDVFS_HISPEED_FREQ		1000000
-#define ALTDVFS_TOLERANCE		1
-
-struct devfreq_alt_dvfs_data {
-	struct devfreq_alt_track	*track;
-	unsigned int			track_group;
-
-	/* ALT-DVFS parameter */
-	unsigned int		*target_load;
-	unsigned int		num_target_load;
-	unsigned int		min_sample_time;
-	unsigned int		hold_sample_time;
-	unsigned int		hispeed_load;
-	unsigned int		hispeed_freq;
-	unsigned int		tolerance;
-
-	/* MIF to INT mapping table */
-	struct mif_int_map	*mif_int_tbl;
-	unsigned int		map_row_cnt;
-};
+#include <soc/google/exynos-devfreq-interactive.h>
 #endif /* ALT_DVFS */
 
 #define DEFAULT_DELAY_TIME		10 /* msec */
@@ -107,6 +60,11 @@ struct devfreq_simple_interactive_data {
 #endif
 };
 
+#if IS_ENABLED(CONFIG_EXYNOS_ALT_DVFS)
+void devfreq_simple_interactive_boost_pulse(struct devfreq_simple_interactive_data *data,
+					    unsigned int duration);
+#endif
+
 struct exynos_devfreq_opp_table {
 	u32 idx;
 	u32 freq;
@@ -235,6 +193,7 @@ int exynos_devfreq_init_freq_table(struct exynos_devfreq_data *data);
 int exynos_devfreq_lock_freq(unsigned int devfreq_type, unsigned int qos_value);
 int exynos_devfreq_get_boundary(unsigned int devfreq_type,
 				unsigned int *max_freq, unsigned int *min_freq);
+int exynos_devfreq_boost_pulse(unsigned int devfreq_type, unsigned int duration);
 #else
 static inline unsigned long exynos_devfreq_get_domain_freq(unsigned int devfreq_type)
 {
@@ -255,6 +214,12 @@ static int exynos_devfreq_get_boundary(unsigned int devfreq_type,
 {
 	return 0;
 }
+
+static inline int exynos_devfreq_boost_pulse(unsigned int devfreq_type,
+					     unsigned int duration)
+{
+	return 0;
+}
 #endif
 
 #if IS_ENABLED(CONFIG_ECT)
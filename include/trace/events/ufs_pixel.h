@@ -14,10 +14,11 @@
 #include <linux/tracepoint.h>
 
 TRACE_EVENT(ufs_stats,
-	TP_PROTO(struct exynos_ufs *ufs, struct pixel_io_stats *prev_rstat,
+	TP_PROTO(struct pixel_stats_snap *snap,
+			struct pixel_io_stats *prev_rstat,
 			struct pixel_io_stats *prev_wstat, u64 *avg_time),
 
-	TP_ARGS(ufs, prev_rstat, prev_wstat, avg_time),
+	TP_ARGS(snap, prev_rstat, prev_wstat, avg_time),
 
 	TP_STRUCT__entry(
 		__field(u64,	peak_read)
@@ -42,35 +43,35 @@ TRACE_EVENT(ufs_stats,
 	),
 
 	TP_fast_assign(
-		__entry->peak_read	= ufs->peak_reqs[REQ_TYPE_READ];
-		__entry->peak_write	= ufs->peak_reqs[REQ_TYPE_WRITE];
-		__entry->peak_flush	= ufs->peak_reqs[REQ_TYPE_FLUSH];
-		__entry->peak_discard	= ufs->peak_reqs[REQ_TYPE_DISCARD];
-		__entry->peak_qdepth	= ufs->peak_queue_depth;
+		__entry->peak_read	= snap->peak_reqs[REQ_TYPE_READ];
+		__entry->peak_write	= snap->peak_reqs[REQ_TYPE_WRITE];
+		__entry->peak_flush	= snap->peak_reqs[REQ_TYPE_FLUSH];
+		__entry->peak_discard	= snap->peak_reqs[REQ_TYPE_DISCARD];
+		__entry->peak_qdepth	= snap->peak_queue_depth;
 		__entry->avg_read	= avg_time[REQ_TYPE_READ];
 		__entry->avg_write	= avg_time[REQ_TYPE_WRITE];
 		__entry->avg_flush	= avg_time[REQ_TYPE_FLUSH];
 		__entry->avg_discard	= avg_time[REQ_TYPE_DISCARD];
-		__entry->r_rc_s	= ufs->io_stats[IO_TYPE_READ].req_count_started
+		__entry->r_rc_s	= snap->io_stats[IO_TYPE_READ].req_count_started
 				- prev_rstat->req_count_started;
-		__entry->r_tb_s	= ufs->io_stats[IO_TYPE_READ].total_bytes_started
+		__entry->r_tb_s	= snap->io_stats[IO_TYPE_READ].total_bytes_started
 				- prev_rstat->total_bytes_started;
-		__entry->w_rc_s	= ufs->io_stats[IO_TYPE_WRITE].req_count_started
+		__entry->w_rc_s	= snap->io_stats[IO_TYPE_WRITE].req_count_started
 				- prev_wstat->req_count_started;
-		__entry->w_tb_s	= ufs->io_stats[IO_TYPE_WRITE].total_bytes_started
+		__entry->w_tb_s	= snap->io_stats[IO_TYPE_WRITE].total_bytes_started
 				- prev_wstat->total_bytes_started;
-		__entry->r_rc_c	= ufs->io_stats[IO_TYPE_READ].req_count_completed
+		__entry->r_rc_c	= snap->io_stats[IO_TYPE_READ].req_count_completed
 				- prev_rstat->req_count_completed;
-		__entry->r_tb_c	= ufs->io_stats[IO_TYPE_READ].total_bytes_completed
+		__entry->r_tb_c	= snap->io_stats[IO_TYPE_READ].total_bytes_completed
 				- prev_rstat->total_bytes_completed;
-		__entry->w_rc_c	= ufs->io_stats[IO_TYPE_WRITE].req_count_completed
+		__entry->w_rc_c	= snap->io_stats[IO_TYPE_WRITE].req_count_completed
 				- prev_wstat->req_count_completed;
-		__entry->w_tb_c	= ufs->io_stats[IO_TYPE_WRITE].total_bytes_completed
+		__entry->w_tb_c	= snap->io_stats[IO_TYPE_WRITE].total_bytes_completed
 				- prev_wstat->total_bytes_completed;
-		__entry->r_rem	= ufs->io_stats[IO_TYPE_READ].req_count_started
-				- ufs->io_stats[IO_TYPE_READ].req_count_completed;
-		__entry->w_rem	= ufs->io_stats[IO_TYPE_WRITE].req_count_started
-				- ufs->io_stats[IO_TYPE_WRITE].req_count_completed;
+		__entry->r_rem	= snap->io_stats[IO_TYPE_READ].req_count_started
+				- snap->io_stats[IO_TYPE_READ].req_count_completed;
+		__entry->w_rem	= snap->io_stats[IO_TYPE_WRITE].req_count_started
+				- snap->io_stats[IO_TYPE_WRITE].req_count_completed;
 	),
 
 	TP_printk(